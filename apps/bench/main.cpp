@@ -0,0 +1,749 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef GLMMD_USE_TBB
+#include <tbb/global_control.h>
+#include <tbb/task_arena.h>
+#endif
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include <glmmd/core/Model.h>
+#include <glmmd/core/ParallelForEach.h>
+#include <glmmd/core/PbdWorld.h>
+#include <glmmd/core/PhysicsWorld.h>
+#include <glmmd/core/ThreadPool.h>
+#include <glmmd/core/Trace.h>
+#include <glmmd/files/PhysicsCacheFile.h>
+#include <glmmd/files/PmxFileLoader.h>
+#include <glmmd/files/SyntheticData.h>
+#include <glmmd/files/VmdFileLoader.h>
+
+struct Options
+{
+    struct ModelFiles
+    {
+        std::filesystem::path              model;
+        std::string                        preset; // synthetic model
+        std::vector<std::filesystem::path> motions;
+    };
+    std::vector<ModelFiles> models;
+
+    uint32_t              frames         = 600;
+    uint32_t              warmupFrames   = 30;
+    uint32_t              threads        = 0;
+    uint32_t              instances      = 1;
+    uint32_t              seed           = 1;
+    float                 frameRate      = 30.f;
+    float                 physicsFPS     = 60.f;
+    int                   substeps       = 10;
+    bool                  physics        = true;
+    bool                  perModelWorlds = false;
+    bool                  physicsMt      = false;
+    bool                  physicsThread  = false;
+    uint32_t              physicsThreads = 0;
+    int                   solverIters    = 10;
+#ifndef GLMMD_DONT_USE_BULLET
+    std::string physicsBackend = "bullet";
+#else
+    std::string physicsBackend = "pbd";
+#endif
+    int                   pbdSubsteps    = 8;
+    bool                  adaptiveSteps  = false;
+    bool                  deactivation   = false;
+    bool                  loop           = true;
+    std::string           vertexLayout   = "interleaved";
+    std::filesystem::path output;
+    std::filesystem::path trace;
+    std::string           bakePrefix;
+    std::string           replayPrefix;
+    std::string           referencePrefix;
+};
+
+struct BenchModel
+{
+    std::unique_ptr<glmmd::Model>                        model;
+    glmmd::ModelRenderData                               renderData;
+    std::vector<std::shared_ptr<glmmd::FixedMotionClip>> clips;
+    glmmd::ModelPose                                     scratchPose;
+    std::string                                          path;
+    std::shared_ptr<glmmd::PhysicsCache>                 physicsCache;
+    std::shared_ptr<glmmd::PhysicsCache>                 referenceCache;
+    double                                               errorSum       = 0.0;
+    double                                               errorMax       = 0.0;
+    size_t                                               errorCount     = 0;
+    size_t                                               sleepingFrames = 0;
+};
+
+static void printUsage(const char *exe)
+{
+    std::cerr
+        << "Usage: " << exe
+        << " [options] (model.pmx | --synth PRESET) [motion.vmd ...] ...\n"
+        << "Each .pmx or --synth starts a new model, following .vmd files are "
+           "applied to it.\n"
+        << "Synthetic models get a synthetic motion unless motions are given.\n"
+           "\n"
+        << "Options:\n"
+        << "  --frames N        measured frames (default 600)\n"
+        << "  --warmup N        unmeasured warmup frames (default 30)\n"
+        << "  --threads N       worker threads, 0: all (default 0)\n"
+        << "  --instances N     instances of every model (default 1)\n"
+        << "  --synth PRESET    add a synthetic model, PRESET is tiny, small, "
+           "medium, large or extreme\n"
+        << "  --seed N          seed of synthetic models and motions (default "
+           "1)\n"
+        << "  --fps F           animation frame rate (default 30)\n"
+        << "  --physics-fps F   physics step rate (default 60)\n"
+        << "  --substeps N      max physics substeps (default 10)\n"
+        << "  --no-physics      disable physics\n"
+        << "  --physics-backend NAME\n"
+           "                    bullet or pbd, the built-in position based "
+           "dynamics (default bullet, pbd without Bullet)\n"
+        << "  --pbd-substeps N  solver substeps per physics step of pbd "
+           "(default 8)\n"
+        << "  --adaptive-steps  pick physics steps (bullet) or substeps (pbd) "
+           "per world or model\n"
+        << "  --deactivation    stop stepping physics of models at rest\n"
+        << "  --per-model-worlds\n"
+           "                    step every model in its own physics world, in "
+           "parallel with\n"
+           "                    -DGLMMD_BULLET_PARALLEL_WORLDS=ON\n"
+        << "  --physics-thread  step physics on its own fixed-rate thread\n"
+        << "  --physics-mt      use Bullet's multithreaded world (needs "
+           "-DGLMMD_BULLET_MULTITHREADED=ON)\n"
+        << "  --physics-threads N\n"
+           "                    solver pool size for --physics-mt, 0: all "
+           "(default 0)\n"
+        << "  --solver-iterations N\n"
+           "                    constraint solver iterations (default 10)\n"
+        << "  --vertex-layout NAME\n"
+           "                    interleaved, streams or compact, render data "
+           "vertex layout (default interleaved)\n"
+        << "  --no-loop         clamp motions instead of looping\n"
+        << "  --bake PREFIX     record physics of model i to PREFIX<i>.pcache\n"
+        << "  --replay PREFIX   play back physics from PREFIX<i>.pcache "
+           "instead of simulating\n"
+        << "  --reference PREFIX\n"
+           "                    report the distance of physics bones to the "
+           "ones baked to PREFIX<i>.pcache\n"
+        << "  --output FILE     write JSON to FILE instead of stdout\n"
+        << "  --trace FILE      write a Chrome trace of the measured frames "
+           "(needs -DGLMMD_ENABLE_TRACING=ON)\n";
+}
+
+static Options parseOptions(int argc, char **argv)
+{
+    Options options;
+
+    auto next = [&](int &i) -> std::string
+    {
+        if (i + 1 >= argc)
+            throw std::runtime_error(std::string("Missing value for ") +
+                                     argv[i] + ".");
+        return argv[++i];
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--frames")
+            options.frames = std::stoul(next(i));
+        else if (arg == "--warmup")
+            options.warmupFrames = std::stoul(next(i));
+        else if (arg == "--threads")
+            options.threads = std::stoul(next(i));
+        else if (arg == "--instances")
+            options.instances = std::max<uint32_t>(1, std::stoul(next(i)));
+        else if (arg == "--synth")
+            options.models.push_back({{}, next(i), {}});
+        else if (arg == "--seed")
+            options.seed = std::stoul(next(i));
+        else if (arg == "--fps")
+            options.frameRate = std::stof(next(i));
+        else if (arg == "--physics-fps")
+            options.physicsFPS = std::stof(next(i));
+        else if (arg == "--substeps")
+            options.substeps = std::stoi(next(i));
+        else if (arg == "--no-physics")
+            options.physics = false;
+        else if (arg == "--per-model-worlds")
+            options.perModelWorlds = true;
+        else if (arg == "--physics-thread")
+            options.physicsThread = true;
+        else if (arg == "--physics-mt")
+            options.physicsMt = true;
+        else if (arg == "--physics-threads")
+            options.physicsThreads = std::stoul(next(i));
+        else if (arg == "--solver-iterations")
+            options.solverIters = std::stoi(next(i));
+        else if (arg == "--physics-backend")
+        {
+            options.physicsBackend = next(i);
+            if (options.physicsBackend != "bullet" &&
+                options.physicsBackend != "pbd")
+                throw std::runtime_error("Unknown physics backend \"" +
+                                         options.physicsBackend + "\".");
+#ifdef GLMMD_DONT_USE_BULLET
+            if (options.physicsBackend == "bullet")
+                throw std::runtime_error(
+                    "Physics backend \"bullet\" is not available, glmmd was "
+                    "built without Bullet.");
+#endif
+        }
+        else if (arg == "--pbd-substeps")
+            options.pbdSubsteps = std::stoi(next(i));
+        else if (arg == "--adaptive-steps")
+            options.adaptiveSteps = true;
+        else if (arg == "--deactivation")
+            options.deactivation = true;
+        else if (arg == "--vertex-layout")
+        {
+            options.vertexLayout = next(i);
+            if (options.vertexLayout != "interleaved" &&
+                options.vertexLayout != "streams" &&
+                options.vertexLayout != "compact")
+                throw std::runtime_error("Unknown vertex layout \"" +
+                                         options.vertexLayout + "\".");
+        }
+        else if (arg == "--no-loop")
+            options.loop = false;
+        else if (arg == "--bake")
+            options.bakePrefix = next(i);
+        else if (arg == "--replay")
+            options.replayPrefix = next(i);
+        else if (arg == "--reference")
+            options.referencePrefix = next(i);
+        else if (arg == "--output")
+            options.output = next(i);
+        else if (arg == "--trace")
+        {
+            options.trace = next(i);
+#ifndef GLMMD_ENABLE_TRACING
+            throw std::runtime_error("glmmd was built without tracing.");
+#endif
+        }
+        else if (arg.starts_with("--"))
+            throw std::runtime_error("Unknown option \"" + arg + "\".");
+        else
+        {
+            std::filesystem::path path(arg);
+            if (path.extension() == ".pmx")
+                options.models.push_back({path, {}, {}});
+            else if (path.extension() == ".vmd")
+            {
+                if (options.models.empty())
+                    throw std::runtime_error("Motion \"" + arg +
+                                             "\" given before any model.");
+                options.models.back().motions.push_back(path);
+            }
+            else
+                throw std::runtime_error("Unsupported file \"" + arg + "\".");
+        }
+    }
+
+    if (options.models.empty())
+        throw std::runtime_error("No model given.");
+
+    return options;
+}
+
+class StageTimer
+{
+public:
+    void add(const std::string &stage, double ms)
+    {
+        m_samples[stage].push_back(ms);
+    }
+
+    // `stage` must be a string literal, it is also used as trace zone name
+    template <typename Func>
+    void measure(const char *stage, bool record, Func &&func)
+    {
+        GLMMD_TRACE_SCOPE(stage);
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto end = std::chrono::steady_clock::now();
+        if (record)
+            add(stage,
+                std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    const auto &samples() const { return m_samples; }
+
+private:
+    std::map<std::string, std::vector<double>> m_samples;
+};
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    auto rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+// Resident set size of the process, 0 where unknown
+static double residentMiB()
+{
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t        pages = 0, resident = 0;
+    if (statm >> pages >> resident)
+        return resident * static_cast<double>(sysconf(_SC_PAGESIZE)) /
+               (1024.0 * 1024.0);
+#endif
+    return 0.0;
+}
+
+static std::string jsonString(const std::string &str)
+{
+    std::string out = "\"";
+    for (char c : str)
+    {
+        switch (c)
+        {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        default:
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static void writeReport(std::ostream &out, const Options &options,
+                        const std::vector<BenchModel> &models,
+                        uint32_t threads, bool physics, double physicsSetupMs,
+                        double physicsSetupMiB, const StageTimer &timer)
+{
+    out << "{\n";
+    out << "  \"frames\": " << options.frames << ",\n";
+    out << "  \"threads\": " << threads << ",\n";
+    out << "  \"physics\": " << (physics ? "true" : "false") << ",\n";
+    out << "  \"physicsBackend\": " << jsonString(options.physicsBackend)
+        << ",\n";
+    out << "  \"vertexLayout\": " << jsonString(options.vertexLayout)
+        << ",\n";
+    out << "  \"physicsSetupMs\": " << physicsSetupMs << ",\n";
+    out << "  \"physicsSetupMiB\": " << physicsSetupMiB << ",\n";
+    out << "  \"perModelWorlds\": "
+        << (options.perModelWorlds ? "true" : "false") << ",\n";
+    out << "  \"physicsThread\": "
+        << (options.physicsThread ? "true" : "false") << ",\n";
+    out << "  \"physicsMt\": " << (options.physicsMt ? "true" : "false")
+        << ",\n";
+    out << "  \"solverIterations\": " << options.solverIters << ",\n";
+#ifdef GLMMD_USE_TBB
+    out << "  \"backend\": \"tbb\",\n";
+#elif defined(GLMMD_DONT_PARALLELIZE)
+    out << "  \"backend\": \"serial\",\n";
+#else
+    out << "  \"backend\": \"glmmd\",\n";
+#endif
+
+    out << "  \"models\": [\n";
+    for (size_t i = 0; i < models.size(); ++i)
+    {
+        const auto &data = models[i].model->data();
+        out << "    {\"path\": " << jsonString(models[i].path)
+            << ", \"vertices\": " << data.vertices.size()
+            << ", \"bones\": " << data.bones.size()
+            << ", \"morphs\": " << data.morphs.size()
+            << ", \"rigidBodies\": " << data.rigidBodies.size()
+            << ", \"joints\": " << data.joints.size() << "}"
+            << (i + 1 < models.size() ? ",\n" : "\n");
+    }
+    out << "  ],\n";
+
+    if (!options.referencePrefix.empty())
+    {
+        double sum   = 0.0;
+        double max   = 0.0;
+        size_t count = 0;
+        for (const auto &m : models)
+        {
+            sum += m.errorSum;
+            max = std::max(max, m.errorMax);
+            count += m.errorCount;
+        }
+        out << "  \"physicsError\": {\"mean\": "
+            << sum / std::max<size_t>(1, count) << ", \"max\": " << max
+            << "},\n";
+    }
+
+    if (physics && options.deactivation)
+    {
+        size_t sleeping = 0;
+        for (const auto &m : models)
+            sleeping += m.sleepingFrames;
+        out << "  \"physicsSleeping\": "
+            << static_cast<double>(sleeping) /
+                   std::max<size_t>(1, models.size() * options.frames)
+            << ",\n";
+    }
+
+    out << "  \"stages\": {\n";
+    size_t k = 0;
+    for (const auto &[stage, samples] : timer.samples())
+    {
+        auto sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (auto s : sorted)
+            sum += s;
+
+        out << "    " << jsonString(stage) << ": {\"unit\": \"ms\""
+            << ", \"mean\": " << sum / std::max<size_t>(1, sorted.size())
+            << ", \"p50\": " << percentile(sorted, 50.0)
+            << ", \"p95\": " << percentile(sorted, 95.0)
+            << ", \"p99\": " << percentile(sorted, 99.0)
+            << ", \"max\": " << (sorted.empty() ? 0.0 : sorted.back()) << "}"
+            << (++k < timer.samples().size() ? ",\n" : "\n");
+    }
+    out << "  }\n";
+    out << "}\n";
+}
+
+static std::filesystem::path physicsCachePath(const std::string &prefix,
+                                              size_t             modelIndex)
+{
+    return prefix + std::to_string(modelIndex) + ".pcache";
+}
+
+static int run(const Options &options)
+{
+#ifdef GLMMD_USE_TBB
+    std::unique_ptr<tbb::global_control> tbbControl;
+    if (options.threads != 0)
+        tbbControl = std::make_unique<tbb::global_control>(
+            tbb::global_control::max_allowed_parallelism, options.threads);
+#else
+    glmmd::ThreadPoolConfig poolConfig;
+    poolConfig.threadCount = options.threads;
+    glmmd::ThreadPool::configureGlobal(poolConfig);
+#endif
+
+    auto vertexLayout = options.vertexLayout == "streams"
+                            ? glmmd::VertexLayout::Streams
+                        : options.vertexLayout == "compact"
+                            ? glmmd::VertexLayout::CompactStreams
+                            : glmmd::VertexLayout::Interleaved;
+
+    std::vector<BenchModel> models;
+    for (const auto &files : options.models)
+    {
+        std::shared_ptr<glmmd::ModelData> data;
+        std::string                       name;
+        if (files.preset.empty())
+        {
+            data = glmmd::loadPmxFile(files.model);
+            name = files.model.string();
+        }
+        else
+        {
+            auto config = glmmd::syntheticModelPreset(files.preset);
+            config.seed = options.seed;
+            data        = std::make_shared<glmmd::ModelData>(
+                glmmd::generateSyntheticModel(config));
+            name = "synth:" + files.preset;
+        }
+
+        std::vector<std::shared_ptr<glmmd::FixedMotionClip>> clips;
+        for (const auto &motionPath : files.motions)
+        {
+            auto vmd = glmmd::loadVmdFile(motionPath);
+            clips.push_back(std::make_shared<glmmd::FixedMotionClip>(
+                vmd->toFixedMotionClip(*data, options.loop)));
+        }
+        if (!files.preset.empty() && clips.empty())
+        {
+            glmmd::SyntheticMotionConfig config;
+            config.seed = options.seed;
+            clips.push_back(std::make_shared<glmmd::FixedMotionClip>(
+                glmmd::generateSyntheticMotion(*data, config)
+                    .toFixedMotionClip(*data, options.loop)));
+        }
+
+        for (uint32_t i = 0; i < options.instances; ++i)
+        {
+            auto &m       = models.emplace_back();
+            m.model       = std::make_unique<glmmd::Model>(data);
+            m.renderData  = glmmd::ModelRenderData(data, vertexLayout);
+            m.clips       = clips;
+            m.scratchPose = glmmd::ModelPose(data);
+            m.path        = name;
+        }
+    }
+
+    auto loadCache = [&](const std::string &prefix, size_t i)
+    {
+        auto cache =
+            glmmd::loadPhysicsCacheFile(physicsCachePath(prefix, i));
+        if (!cache->matches(models[i].model->data()))
+            throw std::runtime_error("Physics cache does not match model " +
+                                     models[i].path + ".");
+        return cache;
+    };
+    for (size_t i = 0; i < models.size(); ++i)
+    {
+        if (!options.replayPrefix.empty())
+            models[i].physicsCache = loadCache(options.replayPrefix, i);
+        if (!options.referencePrefix.empty())
+            models[i].referenceCache = loadCache(options.referencePrefix, i);
+    }
+
+    bool physics = options.physics && options.replayPrefix.empty();
+    bool pbd     = options.physicsBackend == "pbd";
+
+    double setupStartMiB = residentMiB();
+    auto   setupStart    = std::chrono::steady_clock::now();
+
+    glmmd::PbdWorld pbdWorld;
+    pbdWorld.setSubsteps(options.pbdSubsteps);
+    pbdWorld.setAdaptiveSubsteps(options.adaptiveSteps);
+    pbdWorld.setDeactivation(options.deactivation);
+    if (physics && pbd)
+        for (auto &m : models)
+            pbdWorld.setupModelPhysics(*m.model, true);
+
+#ifndef GLMMD_DONT_USE_BULLET
+    glmmd::PhysicsWorld physicsWorld;
+    physicsWorld.setPerModelWorlds(options.perModelWorlds);
+    physicsWorld.setThreadCount(options.physicsThreads);
+    physicsWorld.setMultithreaded(options.physicsMt);
+    physicsWorld.setSolverIterations(options.solverIters);
+    physicsWorld.setAdaptiveStepping(options.adaptiveSteps);
+    physicsWorld.setDeactivation(options.deactivation);
+    if (physics && !pbd)
+        for (auto &m : models)
+            physicsWorld.setupModelPhysics(*m.model, true);
+    if (physics && !pbd && options.physicsThread)
+        physicsWorld.startThread(1.f / options.physicsFPS, options.substeps);
+#endif
+
+    double physicsSetupMs = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - setupStart)
+                                .count();
+    double physicsSetupMiB = residentMiB() - setupStartMiB;
+
+    if (!options.bakePrefix.empty())
+    {
+        if (!physics)
+            throw std::runtime_error("Baking requires physics.");
+        for (auto &m : models)
+            m.physicsCache = std::make_shared<glmmd::PhysicsCache>(
+                m.model->data(), options.frameRate);
+    }
+
+    StageTimer timer;
+
+    const uint32_t totalFrames = options.warmupFrames + options.frames;
+    const float    deltaTime   = 1.f / options.frameRate;
+
+    for (uint32_t frame = 0; frame < totalFrames; ++frame)
+    {
+        const bool  record = frame >= options.warmupFrames;
+        const float time   = frame * deltaTime;
+
+#ifdef GLMMD_ENABLE_TRACING
+        if (frame == options.warmupFrames && !options.trace.empty())
+            glmmd::trace::setEnabled(true);
+#endif
+
+        auto frameStart = std::chrono::steady_clock::now();
+
+        timer.measure("motion", record,
+                      [&]
+                      {
+                          glmmd::parallelForEach(
+                              models.begin(), models.end(),
+                              [&](BenchModel &m)
+                              {
+                                  auto &pose = m.model->pose();
+                                  pose.resetLocal();
+                                  for (const auto &clip : m.clips)
+                                  {
+                                      m.scratchPose.resetLocal();
+                                      clip->getLocalPose(time, m.scratchPose);
+                                      pose += m.scratchPose;
+                                  }
+                              });
+                      });
+
+        timer.measure("solve", record,
+                      [&]
+                      {
+                          glmmd::parallelForEach(
+                              models.begin(), models.end(), [](BenchModel &m)
+                              { m.model->solvePoseBeforePhysics(); });
+                      });
+
+        if (physics)
+            timer.measure("physics", record,
+                          [&]
+                          {
+                              if (pbd)
+                                  pbdWorld.update(deltaTime, options.substeps,
+                                                  1.f / options.physicsFPS);
+#ifndef GLMMD_DONT_USE_BULLET
+                              else
+                                  physicsWorld.update(deltaTime,
+                                                      options.substeps,
+                                                      1.f / options.physicsFPS);
+#endif
+                          });
+
+        if (physics && record && options.deactivation)
+            for (auto &m : models)
+            {
+#ifndef GLMMD_DONT_USE_BULLET
+                if (!pbd)
+                {
+                    m.sleepingFrames += physicsWorld.isSleeping(*m.model);
+                    continue;
+                }
+#endif
+                m.sleepingFrames += pbdWorld.isSleeping(*m.model);
+            }
+
+        timer.measure("sync", record,
+                      [&]
+                      {
+                          glmmd::parallelForEach(
+                              models.begin(), models.end(),
+                              [&](BenchModel &m)
+                              {
+                                  if (!options.replayPrefix.empty())
+                                      m.model->syncPoseWithPhysicsCache(
+                                          *m.physicsCache, time);
+                                  else
+                                      m.model->syncPoseWithPhysics();
+                                  if (!options.bakePrefix.empty())
+                                      m.physicsCache->record(m.model->pose());
+                                  m.model->solvePoseAfterPhysics();
+                              });
+                      });
+
+        if (record && !options.referencePrefix.empty())
+            glmmd::parallelForEach(
+                models.begin(), models.end(),
+                [&](BenchModel &m)
+                {
+                    m.referenceCache->apply(time, m.scratchPose);
+                    for (uint32_t bone : m.referenceCache->bones())
+                    {
+                        double error = glm::distance(
+                            m.scratchPose.getGlobalBoneTransform(bone)
+                                .translation,
+                            m.model->pose()
+                                .getGlobalBoneTransform(bone)
+                                .translation);
+                        m.errorSum += error;
+                        m.errorMax = std::max(m.errorMax, error);
+                        ++m.errorCount;
+                    }
+                });
+
+        timer.measure("morph", record,
+                      [&]
+                      {
+                          glmmd::parallelForEach(
+                              models.begin(), models.end(),
+                              [](BenchModel &m)
+                              {
+                                  m.renderData.init();
+                                  m.model->pose().applyMorphsToRenderData(
+                                      m.renderData);
+                              });
+                      });
+
+        timer.measure("skinning", record,
+                      [&]
+                      {
+                          glmmd::parallelForEach(
+                              models.begin(), models.end(),
+                              [](BenchModel &m)
+                              {
+                                  m.model->pose()
+                                      .applyBoneTransformsToRenderData(
+                                          m.renderData);
+                              });
+                      });
+
+        auto frameEnd = std::chrono::steady_clock::now();
+        if (record)
+            timer.add("frame", std::chrono::duration<double, std::milli>(
+                                   frameEnd - frameStart)
+                                   .count());
+    }
+
+    if (!options.bakePrefix.empty())
+        for (size_t i = 0; i < models.size(); ++i)
+        {
+            models[i].physicsCache->finish();
+            glmmd::dumpPhysicsCacheFile(physicsCachePath(options.bakePrefix, i),
+                                        *models[i].physicsCache);
+        }
+
+#ifdef GLMMD_ENABLE_TRACING
+    if (!options.trace.empty())
+    {
+        glmmd::trace::setEnabled(false);
+        glmmd::trace::dumpChromeTrace(options.trace);
+    }
+#endif
+
+#ifdef GLMMD_USE_TBB
+    auto threads =
+        static_cast<uint32_t>(tbb::this_task_arena::max_concurrency());
+#else
+    uint32_t threads = glmmd::ThreadPool::global().threadCount();
+#endif
+
+    if (options.output.empty())
+        writeReport(std::cout, options, models, threads, physics,
+                    physicsSetupMs, physicsSetupMiB, timer);
+    else
+    {
+        std::ofstream fout(options.output);
+        if (!fout)
+            throw std::runtime_error("Failed to open file \"" +
+                                     options.output.string() + "\".");
+        writeReport(fout, options, models, threads, physics, physicsSetupMs,
+                    physicsSetupMiB, timer);
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        return run(parseOptions(argc, argv));
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        printUsage(argv[0]);
+        return 1;
+    }
+}
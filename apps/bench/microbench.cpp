@@ -0,0 +1,569 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef GLMMD_USE_TBB
+#include <tbb/global_control.h>
+#endif
+
+#include <glmmd/core/InterpolationCurve.h>
+#include <glmmd/core/Model.h>
+#include <glmmd/core/ThreadPool.h>
+#include <glmmd/core/Transform.h>
+#include <glmmd/files/CodeConverter.h>
+#include <glmmd/files/SyntheticData.h>
+
+// Keeps the compiler from optimizing away results
+template <typename T>
+inline void doNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void *sink;
+    sink = &value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+struct Benchmark
+{
+    std::string name;
+
+    // Work done by one operation, for throughput
+    double items = 1.0;
+    double bytes = 0.0;
+
+    // Prepares data and returns the kernel, which runs `n` operations
+    std::function<std::function<void(size_t n)>()> setup;
+};
+
+struct Result
+{
+    std::string name;
+    size_t      iterations;
+    size_t      samples;
+    double      median; // ns/op
+    double      min;
+    double      mean;
+    double      stddev;
+    double      itemsPerSecond;
+    double      bytesPerSecond;
+};
+
+struct Options
+{
+    std::string           filter;
+    std::filesystem::path output;
+    std::filesystem::path compare[2];
+    int64_t               cpu           = -1;
+    size_t                samples       = 15;
+    double                minSampleTime = 0.02; // s
+    double                warmupTime    = 0.1;  // s
+    double                threshold     = 0.05;
+};
+
+static constexpr size_t   arraySize        = 1024;
+static constexpr uint32_t skinningVertices = 20000;
+static constexpr size_t   textLength       = 4096;
+
+static std::vector<Benchmark> registerBenchmarks()
+{
+    std::vector<Benchmark> benchmarks;
+
+    // Control points of the curves used by most motions
+    const std::pair<const char *, glmmd::InterpolationCurvePoints> curves[]{
+        {"linear", {20.f / 127.f, 20.f / 127.f, 107.f / 127.f, 107.f / 127.f}},
+        {"ease", {0.4f, 0.f, 0.6f, 1.f}},
+        {"steep", {0.9f, 0.f, 0.1f, 1.f}},
+    };
+    for (const auto &[curveName, points] : curves)
+    {
+        benchmarks.push_back(
+            {std::string("evalCurve/") + curveName, 1.0, 0.0,
+             [points]
+             {
+                 auto xs = std::make_shared<std::vector<float>>(arraySize);
+                 for (size_t i = 0; i < arraySize; ++i)
+                     (*xs)[i] = (i + 0.5f) / arraySize;
+                 return [points, xs](size_t n)
+                 {
+                     for (size_t i = 0; i < n; ++i)
+                         doNotOptimize(
+                             glmmd::evalCurve(points, (*xs)[i % arraySize]));
+                 };
+             }});
+    }
+
+    auto randomTransforms = []
+    {
+        std::vector<glmmd::Transform> transforms(arraySize);
+        for (size_t i = 0; i < arraySize; ++i)
+        {
+            float a                   = 0.01f * i;
+            transforms[i].translation = glm::vec3(std::sin(a), std::cos(a), a);
+            transforms[i].rotation    = glm::normalize(
+                glm::quat(glm::vec3(std::sin(3.f * a), a, std::cos(a))));
+        }
+        return transforms;
+    };
+
+    benchmarks.push_back(
+        {"Transform::operator*(Transform)", 1.0, 0.0,
+         [randomTransforms]
+         {
+             auto a = std::make_shared<std::vector<glmmd::Transform>>(
+                 randomTransforms());
+             return [a](size_t n)
+             {
+                 const auto &t = *a;
+                 for (size_t i = 0; i < n; ++i)
+                     doNotOptimize(t[i % arraySize] *
+                                   t[(i + 1) % arraySize]);
+             };
+         }});
+
+    benchmarks.push_back(
+        {"Transform::operator*(float)", 1.0, 0.0,
+         [randomTransforms]
+         {
+             auto a = std::make_shared<std::vector<glmmd::Transform>>(
+                 randomTransforms());
+             return [a](size_t n)
+             {
+                 const auto &t = *a;
+                 for (size_t i = 0; i < n; ++i)
+                     doNotOptimize(t[i % arraySize] *
+                                   ((i % 97) * (1.f / 97.f)));
+             };
+         }});
+
+    // applyBoneTransformsToRenderData on a single skinning type. Positions are
+    // transformed in place, so they drift between calls, which does not
+    // change the cost.
+    const std::pair<const char *, int> skinningTypes[]{
+        {"BDEF1", 0}, {"BDEF2", 1}, {"BDEF4", 2}, {"SDEF", 3}, {"QDEF", 4}};
+    for (const auto &[typeName, type] : skinningTypes)
+    {
+        benchmarks.push_back(
+            {std::string("skinning/") + typeName +
+                 "/vertices=" + std::to_string(skinningVertices),
+             static_cast<double>(skinningVertices), 0.0,
+             [type]
+             {
+                 auto config        = glmmd::syntheticModelPreset("small");
+                 config.vertexCount = skinningVertices;
+                 float *weights[]{&config.bdef1Weight, &config.bdef2Weight,
+                                  &config.bdef4Weight, &config.sdefWeight,
+                                  &config.qdefWeight};
+                 for (int i = 0; i < 5; ++i)
+                     *weights[i] = i == type ? 1.f : 0.f;
+
+                 auto data = std::make_shared<glmmd::ModelData>(
+                     glmmd::generateSyntheticModel(config));
+                 auto model = std::make_shared<glmmd::Model>(data);
+                 for (uint32_t i = 0; i < data->bones.size(); ++i)
+                     model->pose().setLocalBoneRotation(
+                         i, glm::quat(glm::vec3(0.01f * (i % 7), 0.f, 0.f)));
+                 model->solvePose();
+
+                 auto renderData =
+                     std::make_shared<glmmd::ModelRenderData>(data);
+                 return [model, renderData](size_t n)
+                 {
+                     for (size_t i = 0; i < n; ++i)
+                         model->pose().applyBoneTransformsToRenderData(
+                             *renderData);
+                 };
+             }});
+    }
+
+    // Mixed ASCII / hiragana / kanji text
+    auto utf8Text = std::make_shared<std::string>();
+    for (size_t i = 0; i < textLength; ++i)
+    {
+        uint32_t u = i % 3 == 0   ? 0x61 + i % 26
+                     : i % 3 == 1 ? 0x3042 + i % 80
+                                  : 0x4E00 + i % 1000;
+        glmmd::UTF8::encode(u, *utf8Text);
+    }
+    auto utf16Text = std::make_shared<std::string>(
+        glmmd::codeCvt<glmmd::UTF8, glmmd::UTF16_LE>(*utf8Text));
+
+    // Shift-JIS, ASCII and hiragana
+    auto sjisText = std::make_shared<std::string>();
+    for (size_t i = 0; i < textLength; ++i)
+    {
+        if (i % 3 == 1)
+        {
+            sjisText->push_back(static_cast<char>(0x82));
+            sjisText->push_back(static_cast<char>(0xA0 + i % 80));
+        }
+        else
+            sjisText->push_back(static_cast<char>(0x61 + i % 26));
+    }
+
+    benchmarks.push_back(
+        {"codeCvt/UTF8->UTF16_LE/chars=" + std::to_string(textLength),
+         static_cast<double>(textLength), static_cast<double>(utf8Text->size()),
+         [utf8Text]
+         {
+             return [utf8Text](size_t n)
+             {
+                 for (size_t i = 0; i < n; ++i)
+                     doNotOptimize(
+                         glmmd::codeCvt<glmmd::UTF8, glmmd::UTF16_LE>(
+                             *utf8Text));
+             };
+         }});
+
+    benchmarks.push_back(
+        {"codeCvt/UTF16_LE->UTF8/chars=" + std::to_string(textLength),
+         static_cast<double>(textLength),
+         static_cast<double>(utf16Text->size()),
+         [utf16Text]
+         {
+             return [utf16Text](size_t n)
+             {
+                 for (size_t i = 0; i < n; ++i)
+                     doNotOptimize(
+                         glmmd::codeCvt<glmmd::UTF16_LE, glmmd::UTF8>(
+                             *utf16Text));
+             };
+         }});
+
+    benchmarks.push_back(
+        {"codeCvt/ShiftJIS->UTF8/chars=" + std::to_string(textLength),
+         static_cast<double>(textLength), static_cast<double>(sjisText->size()),
+         [sjisText]
+         {
+             return [sjisText](size_t n)
+             {
+                 for (size_t i = 0; i < n; ++i)
+                     doNotOptimize(glmmd::codeCvt<glmmd::ShiftJIS, glmmd::UTF8>(
+                         *sjisText));
+             };
+         }});
+
+    for (const char *preset : {"small", "large"})
+    {
+        auto config = glmmd::syntheticModelPreset(preset);
+        benchmarks.push_back(
+            {std::string("FixedMotionClip::getLocalPose/") + preset,
+             static_cast<double>(config.boneCount), 0.0,
+             [config]
+             {
+                 auto data = std::make_shared<glmmd::ModelData>(
+                     glmmd::generateSyntheticModel(config));
+                 auto clip = std::make_shared<glmmd::FixedMotionClip>(
+                     glmmd::generateSyntheticMotion(*data, {})
+                         .toFixedMotionClip(*data, true));
+                 auto pose = std::make_shared<glmmd::ModelPose>(data);
+                 return [clip, pose](size_t n)
+                 {
+                     for (size_t i = 0; i < n; ++i)
+                     {
+                         clip->getLocalPose((i % 600) * (1.f / 60.f), *pose);
+                         doNotOptimize(pose->getLocalBoneRotation(0));
+                     }
+                 };
+             }});
+    }
+
+    return benchmarks;
+}
+
+static Result runBenchmark(const Benchmark &benchmark, const Options &options)
+{
+    using Clock = std::chrono::steady_clock;
+
+    auto kernel = benchmark.setup();
+
+    auto timed = [&](size_t n)
+    {
+        auto start = Clock::now();
+        kernel(n);
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    // Warm up while finding an iteration count that fills a sample
+    size_t iterations = 1;
+    double elapsed    = 0.0;
+    for (;;)
+    {
+        double t = timed(iterations);
+        elapsed += t;
+        if (t >= options.minSampleTime && elapsed >= options.warmupTime)
+            break;
+        if (t < options.minSampleTime)
+        {
+            double scale = std::min(
+                10.0, 1.2 * options.minSampleTime / std::max(t, 1e-9));
+            iterations = std::max(iterations + 1,
+                                  static_cast<size_t>(iterations * scale));
+        }
+    }
+
+    std::vector<double> samples(options.samples);
+    for (auto &s : samples)
+        s = timed(iterations) * 1e9 / iterations;
+
+    Result result;
+    result.name       = benchmark.name;
+    result.iterations = iterations;
+    result.samples    = samples.size();
+
+    double sum = 0.0;
+    for (auto s : samples)
+        sum += s;
+    result.mean = sum / samples.size();
+
+    double var = 0.0;
+    for (auto s : samples)
+        var += (s - result.mean) * (s - result.mean);
+    result.stddev = std::sqrt(var / samples.size());
+
+    std::sort(samples.begin(), samples.end());
+    result.min    = samples.front();
+    result.median = samples[samples.size() / 2];
+
+    result.itemsPerSecond = benchmark.items * 1e9 / result.median;
+    result.bytesPerSecond = benchmark.bytes * 1e9 / result.median;
+
+    return result;
+}
+
+// One benchmark per line, so that saved files can be read back without a
+// JSON parser.
+static void writeResults(std::ostream &out, const std::vector<Result> &results,
+                         const Options &options)
+{
+    out << "{\n";
+    out << "  \"cpu\": " << options.cpu << ",\n";
+    out << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const auto &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\""
+            << ", \"ns_per_op\": " << r.median << ", \"min\": " << r.min
+            << ", \"mean\": " << r.mean << ", \"stddev\": " << r.stddev
+            << ", \"items_per_second\": " << r.itemsPerSecond
+            << ", \"bytes_per_second\": " << r.bytesPerSecond
+            << ", \"iterations\": " << r.iterations
+            << ", \"samples\": " << r.samples << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+static std::map<std::string, std::pair<double, double>>
+readResults(const std::filesystem::path &path)
+{
+    std::ifstream fin(path);
+    if (!fin)
+        throw std::runtime_error("Failed to open file \"" + path.string() +
+                                 "\".");
+
+    auto field = [](const std::string &line, const std::string &key)
+    {
+        auto pos = line.find("\"" + key + "\": ");
+        if (pos == std::string::npos)
+            throw std::runtime_error("Missing \"" + key + "\".");
+        return pos + key.size() + 4;
+    };
+
+    std::map<std::string, std::pair<double, double>> results;
+
+    std::string line;
+    while (std::getline(fin, line))
+    {
+        if (line.find("\"ns_per_op\"") == std::string::npos)
+            continue;
+
+        auto nameBegin = field(line, "name") + 1;
+        auto name      = line.substr(nameBegin, line.find('"', nameBegin) -
+                                                    nameBegin);
+
+        results[name] = {std::stod(line.substr(field(line, "ns_per_op"))),
+                         std::stod(line.substr(field(line, "stddev")))};
+    }
+    return results;
+}
+
+static int compareResults(const Options &options)
+{
+    auto base    = readResults(options.compare[0]);
+    auto current = readResults(options.compare[1]);
+
+    std::cout << std::left << std::setw(48) << "benchmark" << std::right
+              << std::setw(14) << "base ns/op" << std::setw(14) << "ns/op"
+              << std::setw(10) << "change" << '\n';
+
+    std::cout << std::fixed;
+    for (const auto &[name, cur] : current)
+    {
+        auto it = base.find(name);
+        if (it == base.end())
+            continue;
+
+        const auto [baseTime, baseDev] = it->second;
+        const auto [time, dev]         = cur;
+
+        double change = time / baseTime - 1.0;
+
+        // Only report changes above the threshold and the noise of both runs
+        bool significant = std::abs(change) > options.threshold &&
+                           std::abs(time - baseTime) > 2.0 * (baseDev + dev);
+
+        std::cout << std::left << std::setw(48) << name << std::right
+                  << std::setprecision(2) << std::setw(14) << baseTime
+                  << std::setw(14) << time << std::setprecision(1)
+                  << std::setw(9) << std::showpos << change * 100.0
+                  << std::noshowpos << '%'
+                  << (significant ? (change < 0 ? "  faster" : "  SLOWER")
+                                  : "")
+                  << '\n';
+    }
+
+    return 0;
+}
+
+static void printUsage(const char *exe)
+{
+    std::cerr
+        << "Usage: " << exe << " [options]\n"
+        << "       " << exe << " --compare base.json new.json\n"
+        << "\nOptions:\n"
+        << "  --filter STR      only run benchmarks whose name contains STR\n"
+        << "  --list            list benchmarks\n"
+        << "  --pin CPU         pin the benchmark thread to CPU\n"
+        << "  --samples N       samples per benchmark (default 15)\n"
+        << "  --min-time S      minimum time of a sample in s (default 0.02)\n"
+        << "  --warmup S        warmup time in s (default 0.1)\n"
+        << "  --output FILE     save results as JSON\n"
+        << "  --threshold F     relative change reported by --compare "
+           "(default 0.05)\n";
+}
+
+static int run(int argc, char **argv)
+{
+    Options options;
+    bool    list = false;
+
+    auto next = [&](int &i) -> std::string
+    {
+        if (i + 1 >= argc)
+            throw std::runtime_error(std::string("Missing value for ") +
+                                     argv[i] + ".");
+        return argv[++i];
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--filter")
+            options.filter = next(i);
+        else if (arg == "--list")
+            list = true;
+        else if (arg == "--pin")
+            options.cpu = std::stol(next(i));
+        else if (arg == "--samples")
+            options.samples = std::max<size_t>(1, std::stoul(next(i)));
+        else if (arg == "--min-time")
+            options.minSampleTime = std::stod(next(i));
+        else if (arg == "--warmup")
+            options.warmupTime = std::stod(next(i));
+        else if (arg == "--output")
+            options.output = next(i);
+        else if (arg == "--threshold")
+            options.threshold = std::stod(next(i));
+        else if (arg == "--compare")
+        {
+            options.compare[0] = next(i);
+            options.compare[1] = next(i);
+        }
+        else
+            throw std::runtime_error("Unknown option \"" + arg + "\".");
+    }
+
+    if (!options.compare[0].empty())
+        return compareResults(options);
+
+    // Kernels are measured on a single thread
+#ifdef GLMMD_USE_TBB
+    tbb::global_control tbbControl(tbb::global_control::max_allowed_parallelism,
+                                   1);
+#else
+    glmmd::ThreadPoolConfig poolConfig;
+    poolConfig.threadCount = 1;
+    glmmd::ThreadPool::configureGlobal(poolConfig);
+#endif
+
+    if (options.cpu >= 0 &&
+        !glmmd::setCurrentThreadAffinity(static_cast<uint32_t>(options.cpu)))
+        std::cerr << "Failed to pin to CPU " << options.cpu << '\n';
+
+    std::vector<Result> results;
+    for (const auto &benchmark : registerBenchmarks())
+    {
+        if (benchmark.name.find(options.filter) == std::string::npos)
+            continue;
+
+        if (list)
+        {
+            std::cout << benchmark.name << '\n';
+            continue;
+        }
+
+        auto r = runBenchmark(benchmark, options);
+
+        std::cout << std::left << std::setw(48) << r.name << std::right
+                  << std::fixed << std::setprecision(2) << std::setw(12)
+                  << r.median << " ns/op" << std::setprecision(1)
+                  << std::setw(8) << 100.0 * r.stddev / r.mean << "% dev"
+                  << std::setprecision(2) << std::setw(12)
+                  << r.itemsPerSecond * 1e-6 << " M items/s";
+        if (r.bytesPerSecond > 0.0)
+            std::cout << std::setw(10) << r.bytesPerSecond / (1 << 20)
+                      << " MiB/s";
+        std::cout << std::endl;
+
+        results.push_back(r);
+    }
+
+    if (!options.output.empty())
+    {
+        std::ofstream fout(options.output);
+        if (!fout)
+            throw std::runtime_error("Failed to open file \"" +
+                                     options.output.string() + "\".");
+        writeResults(fout, results, options);
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        return run(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        printUsage(argv[0]);
+        return 1;
+    }
+}
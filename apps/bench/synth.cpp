@@ -0,0 +1,155 @@
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <glmmd/files/PmxFileDumper.h>
+#include <glmmd/files/SyntheticData.h>
+#include <glmmd/files/VmdFileDumper.h>
+
+static void printUsage(const char *exe)
+{
+    std::cerr
+        << "Usage: " << exe << " [options] -o model.pmx [--motion motion.vmd]\n"
+        << "\nModel options:\n"
+        << "  --preset NAME         tiny, small, medium, large or extreme\n"
+        << "  --seed N              random seed (default 1)\n"
+        << "  --vertices N\n"
+        << "  --materials N\n"
+        << "  --additional-uvs N\n"
+        << "  --bones N             including root and IK bones\n"
+        << "  --chain-length N\n"
+        << "  --ik-chains N\n"
+        << "  --ik-length N\n"
+        << "  --vertex-morphs N\n"
+        << "  --morph-size N        vertices per vertex / UV morph\n"
+        << "  --uv-morphs N\n"
+        << "  --bone-morphs N\n"
+        << "  --material-morphs N\n"
+        << "  --group-morphs N\n"
+        << "  --rigid-bodies N\n"
+        << "  --joints N\n"
+        << "  --skinning B1,B2,B4,SDEF,QDEF   relative skinning type weights\n"
+        << "\nMotion options:\n"
+        << "  --frames N            motion length (default 300)\n"
+        << "  --key-interval N      frames between key frames (default 10)\n"
+        << "  --bone-ratio F        fraction of animated bones (default 1)\n"
+        << "  --morph-ratio F       fraction of animated morphs (default 1)\n";
+}
+
+static int run(int argc, char **argv)
+{
+    glmmd::SyntheticModelConfig  model;
+    glmmd::SyntheticMotionConfig motion;
+
+    std::filesystem::path modelPath, motionPath;
+
+    // Presets are applied first, so that other options override them
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == "--preset")
+            model = glmmd::syntheticModelPreset(argv[i + 1]);
+
+    auto next = [&](int &i) -> std::string
+    {
+        if (i + 1 >= argc)
+            throw std::runtime_error(std::string("Missing value for ") +
+                                     argv[i] + ".");
+        return argv[++i];
+    };
+    auto nextUInt = [&](int &i)
+    { return static_cast<uint32_t>(std::stoul(next(i))); };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--preset")
+            ++i;
+        else if (arg == "--seed")
+            model.seed = motion.seed = nextUInt(i);
+        else if (arg == "--vertices")
+            model.vertexCount = nextUInt(i);
+        else if (arg == "--materials")
+            model.materialCount = nextUInt(i);
+        else if (arg == "--additional-uvs")
+            model.additionalUVNum = static_cast<uint8_t>(nextUInt(i));
+        else if (arg == "--bones")
+            model.boneCount = nextUInt(i);
+        else if (arg == "--chain-length")
+            model.chainLength = nextUInt(i);
+        else if (arg == "--ik-chains")
+            model.ikChainCount = nextUInt(i);
+        else if (arg == "--ik-length")
+            model.ikChainLength = nextUInt(i);
+        else if (arg == "--vertex-morphs")
+            model.vertexMorphCount = nextUInt(i);
+        else if (arg == "--morph-size")
+            model.vertexMorphSize = nextUInt(i);
+        else if (arg == "--uv-morphs")
+            model.uvMorphCount = nextUInt(i);
+        else if (arg == "--bone-morphs")
+            model.boneMorphCount = nextUInt(i);
+        else if (arg == "--material-morphs")
+            model.materialMorphCount = nextUInt(i);
+        else if (arg == "--group-morphs")
+            model.groupMorphCount = nextUInt(i);
+        else if (arg == "--rigid-bodies")
+            model.rigidBodyCount = nextUInt(i);
+        else if (arg == "--joints")
+            model.jointCount = nextUInt(i);
+        else if (arg == "--skinning")
+        {
+            std::istringstream ss(next(i));
+            float             *weights[]{&model.bdef1Weight, &model.bdef2Weight,
+                                         &model.bdef4Weight, &model.sdefWeight,
+                                         &model.qdefWeight};
+            std::string        token;
+            for (auto w : weights)
+                *w = std::getline(ss, token, ',') ? std::stof(token) : 0.f;
+        }
+        else if (arg == "--frames")
+            motion.frameCount = nextUInt(i);
+        else if (arg == "--key-interval")
+            motion.keyFrameInterval = nextUInt(i);
+        else if (arg == "--bone-ratio")
+            motion.boneRatio = std::stof(next(i));
+        else if (arg == "--morph-ratio")
+            motion.morphRatio = std::stof(next(i));
+        else if (arg == "-o" || arg == "--output")
+            modelPath = next(i);
+        else if (arg == "--motion")
+            motionPath = next(i);
+        else
+            throw std::runtime_error("Unknown option \"" + arg + "\".");
+    }
+
+    if (modelPath.empty())
+        throw std::runtime_error("No output file given.");
+
+    auto data = glmmd::generateSyntheticModel(model);
+    glmmd::dumpPmxFile(modelPath, data);
+
+    if (!motionPath.empty())
+        glmmd::dumpVmdFile(motionPath,
+                           glmmd::generateSyntheticMotion(data, motion));
+
+    std::cerr << modelPath.string() << ": " << data.vertices.size()
+              << " vertices, " << data.bones.size() << " bones, "
+              << data.morphs.size() << " morphs, " << data.rigidBodies.size()
+              << " rigid bodies, " << data.joints.size() << " joints\n";
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        return run(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        printUsage(argv[0]);
+        return 1;
+    }
+}
@@ -1,11 +1,14 @@
 #ifndef OPENGL_COMMON_H_
 #define OPENGL_COMMON_H_
 
+#include <opengl_framework/DrawIndirectBufferObject.h>
 #include <opengl_framework/FrameBufferObject.h>
 #include <opengl_framework/IndexBufferObject.h>
 #include <opengl_framework/RenderBufferObject.h>
+#include <opengl_framework/RingBufferObject.h>
 #include <opengl_framework/Shader.h>
 #include <opengl_framework/Texture2D.h>
+#include <opengl_framework/UniformBufferObject.h>
 #include <opengl_framework/VertexArrayObject.h>
 #include <opengl_framework/VertexBufferObject.h>
 
@@ -0,0 +1,40 @@
+#ifndef OPENGL_DRAW_INDIRECT_BUFFER_OBJECT_H_
+#define OPENGL_DRAW_INDIRECT_BUFFER_OBJECT_H_
+
+#include <glad/glad.h>
+
+#include <opengl_framework/APIConfig.h>
+
+namespace ogl
+{
+
+// Draw commands for glMultiDrawElementsIndirect, needs GL_ARB_draw_indirect
+class OPENGL_FRAMEWORK_API DrawIndirectBufferObject
+{
+public:
+    DrawIndirectBufferObject();
+    ~DrawIndirectBufferObject();
+
+    DrawIndirectBufferObject(const DrawIndirectBufferObject &) = delete;
+    DrawIndirectBufferObject &
+    operator=(const DrawIndirectBufferObject &) = delete;
+    DrawIndirectBufferObject(DrawIndirectBufferObject &&) noexcept;
+    DrawIndirectBufferObject &operator=(DrawIndirectBufferObject &&) noexcept;
+
+    void create(const void *data, unsigned int size,
+                GLenum drawType = GL_DYNAMIC_DRAW);
+    void destroy();
+
+    void bind() const;
+    void unbind() const;
+
+    void uploadSubData(const void *data, unsigned int offset,
+                       unsigned int size);
+
+private:
+    unsigned int m_id;
+};
+
+} // namespace ogl
+
+#endif
@@ -21,8 +21,12 @@ public:
 
     void                create(const unsigned int *data, unsigned int size,
                                GLenum drawType = GL_STATIC_DRAW);
+    void                create(const unsigned short *data, unsigned int size,
+                               GLenum drawType = GL_STATIC_DRAW);
     void                destroy();
     inline unsigned int getCount() const { return m_count; }
+    // GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
+    inline GLenum getIndexType() const { return m_indexType; }
 
     void bind() const;
     void unbind() const;
@@ -30,6 +34,7 @@ public:
 private:
     unsigned int m_id;
     unsigned int m_count;
+    GLenum       m_indexType;
 };
 
 } // namespace ogl
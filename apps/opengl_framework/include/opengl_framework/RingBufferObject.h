@@ -0,0 +1,58 @@
+#ifndef OPENGL_RING_BUFFER_OBJECT_H_
+#define OPENGL_RING_BUFFER_OBJECT_H_
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include <opengl_framework/APIConfig.h>
+#include <opengl_framework/VertexBufferObject.h>
+
+namespace ogl
+{
+
+// Vertex buffer rewritten every frame. With GL_ARB_buffer_storage it is
+// mapped persistently and coherently and split into regions written in
+// turn, each fenced until the GPU has read it, so the CPU writes straight
+// into the buffer without waiting for or reallocating it. Otherwise it is a
+// single region uploaded with glBufferSubData.
+class OPENGL_FRAMEWORK_API RingBufferObject
+{
+public:
+    RingBufferObject();
+    ~RingBufferObject();
+
+    RingBufferObject(const RingBufferObject &)            = delete;
+    RingBufferObject &operator=(const RingBufferObject &) = delete;
+    RingBufferObject(RingBufferObject &&) noexcept;
+    RingBufferObject &operator=(RingBufferObject &&) noexcept;
+
+    void create(unsigned int regionSize, unsigned int regionCount = 3);
+    void destroy();
+
+    bool isPersistent() const { return m_mapped != nullptr; }
+
+    // Fences the commands issued so far, which read the current region, and
+    // moves on to the next region once the GPU is done with it. Returns the
+    // mapped region, nullptr if not persistent.
+    void *nextRegion();
+
+    // Uploads the region if not persistent, nothing to do otherwise
+    void uploadRegion(const void *data);
+
+    // Where the current region starts in buffer()
+    unsigned int regionOffset() const { return m_region * m_regionSize; }
+
+    const VertexBufferObject &buffer() const { return m_buffer; }
+
+private:
+    VertexBufferObject  m_buffer;
+    std::vector<GLsync> m_fences; // per region, null if not in use
+    char               *m_mapped;
+    unsigned int        m_regionSize;
+    unsigned int        m_region;
+};
+
+} // namespace ogl
+
+#endif
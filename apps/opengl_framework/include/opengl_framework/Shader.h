@@ -31,6 +31,9 @@ public:
     void use() const;
     void destroy();
 
+    // Locations of the active uniforms are looked up once at link time
+    int getUniformLocation(const std::string &name) const;
+
     void setUniform1i(const std::string &name, int n) const;
     void setUniform2fv(const std::string &name, const float *v) const;
     void setUniform3fv(const std::string &name, const float *v) const;
@@ -40,8 +43,22 @@ public:
                              bool         transpose = false,
                              unsigned int count     = 1u) const;
 
+    // By location from getUniformLocation(), for uniforms set every frame
+    void setUniform1i(int location, int n) const;
+    void setUniform2fv(int location, const float *v) const;
+    void setUniform3fv(int location, const float *v) const;
+    void setUniform1f(int location, float f) const;
+    void setUniform4fv(int location, const float *v) const;
+    void setUniformMatrix4fv(int location, const float *ptr,
+                             bool         transpose = false,
+                             unsigned int count     = 1u) const;
+
+    // Does nothing if the program has no such block
+    void setUniformBlockBinding(const std::string &blockName,
+                                unsigned int       binding) const;
+
 private:
-    int getUniformLocation(const std::string &name) const;
+    void cacheUniformLocations();
 
 private:
     unsigned int m_id;
@@ -0,0 +1,40 @@
+#ifndef OPENGL_UNIFORM_BUFFER_OBJECT_H_
+#define OPENGL_UNIFORM_BUFFER_OBJECT_H_
+
+#include <glad/glad.h>
+
+#include <opengl_framework/APIConfig.h>
+
+namespace ogl
+{
+
+class OPENGL_FRAMEWORK_API UniformBufferObject
+{
+public:
+    UniformBufferObject();
+    ~UniformBufferObject();
+
+    UniformBufferObject(const UniformBufferObject &)            = delete;
+    UniformBufferObject &operator=(const UniformBufferObject &) = delete;
+    UniformBufferObject(UniformBufferObject &&) noexcept;
+    UniformBufferObject &operator=(UniformBufferObject &&) noexcept;
+
+    void create(const void *data, unsigned int size,
+                GLenum drawType = GL_DYNAMIC_DRAW);
+    void destroy();
+
+    void uploadSubData(const void *data, unsigned int offset,
+                       unsigned int size);
+
+    // Binds size bytes from offset, a multiple of
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, to the binding point
+    void bindRange(unsigned int binding, unsigned int offset,
+                   unsigned int size) const;
+
+private:
+    unsigned int m_id;
+};
+
+} // namespace ogl
+
+#endif
@@ -30,6 +30,10 @@ public:
         case GL_INT:
         case GL_UNSIGNED_INT:
             return 4;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+            return 2;
         case GL_UNSIGNED_BYTE:
             return 1;
         default:
@@ -59,10 +63,28 @@ public:
     unsigned int getType(size_t i) const { return m_elements[i].first; }
     unsigned int getCount(size_t i) const { return m_elements[i].second; }
     unsigned int getOffset(size_t i) const { return m_offsets[i]; }
+    bool         getNormalized(size_t i) const { return m_normalized[i]; }
+    bool         getInteger(size_t i) const { return m_integer[i]; }
 
-    void push(unsigned int ty, unsigned int count)
+    // Integer types are mapped to [-1, 1] or [0, 1] if normalized
+    void push(unsigned int ty, unsigned int count, bool normalized = false)
+    {
+        pushElement(ty, count, normalized, false);
+    }
+
+    // Integer types read as int/uint attributes in the shader
+    void pushInteger(unsigned int ty, unsigned int count)
+    {
+        pushElement(ty, count, false, true);
+    }
+
+private:
+    void pushElement(unsigned int ty, unsigned int count, bool normalized,
+                     bool integer)
     {
         m_elements.push_back({ty, count});
+        m_normalized.push_back(normalized);
+        m_integer.push_back(integer);
         if (m_type == SoA)
         {
             m_strides.push_back(getSize(ty) * count);
@@ -81,6 +103,8 @@ private:
                               m_elements; // {type, count}
     std::vector<unsigned int> m_strides;
     std::vector<unsigned int> m_offsets;
+    std::vector<bool>         m_normalized;
+    std::vector<bool>         m_integer;
     unsigned int              m_count;
     Layout                    m_type;
 };
@@ -98,8 +122,13 @@ public:
     VertexArrayObject &operator=(VertexArrayObject &&other) noexcept;
 
     void create();
+    // Attributes of the layout get locations firstAttrib, firstAttrib + 1, ...
+    // and read the buffer from byte baseOffset on. Adding the same buffer
+    // again with another baseOffset moves the attributes.
     void addBuffer(const VertexBufferObject &vbo,
-                   const VertexBufferLayout &layout);
+                   const VertexBufferLayout &layout,
+                   unsigned int              firstAttrib = 0,
+                   unsigned int              baseOffset  = 0);
     void destroy();
 
     void bind() const;
@@ -21,6 +21,9 @@ public:
 
     void create(const void *data, unsigned int size,
                 GLenum drawType = GL_STATIC_DRAW);
+    // Immutable storage, needs GL_ARB_buffer_storage
+    void createStorage(const void *data, unsigned int size,
+                       GLbitfield flags);
     void destroy();
 
     void bind() const;
@@ -29,6 +32,9 @@ public:
     void uploadSubData(const void *data, unsigned int offset,
                        unsigned int size);
 
+    void *mapRange(unsigned int offset, unsigned int size, GLbitfield access);
+    void  unmap();
+
 private:
     unsigned int m_id;
 };
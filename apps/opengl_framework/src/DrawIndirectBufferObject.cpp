@@ -0,0 +1,72 @@
+#include <glad/glad.h>
+
+#include <opengl_framework/DrawIndirectBufferObject.h>
+
+#include "GLCheck.h"
+
+namespace ogl
+{
+
+DrawIndirectBufferObject::DrawIndirectBufferObject()
+    : m_id(0)
+{
+}
+
+DrawIndirectBufferObject::~DrawIndirectBufferObject() { destroy(); }
+
+DrawIndirectBufferObject::DrawIndirectBufferObject(
+    DrawIndirectBufferObject &&other) noexcept
+    : m_id(other.m_id)
+{
+    other.m_id = 0;
+}
+
+DrawIndirectBufferObject &
+DrawIndirectBufferObject::operator=(DrawIndirectBufferObject &&other) noexcept
+{
+    if (this != &other)
+    {
+        destroy();
+        m_id       = other.m_id;
+        other.m_id = 0;
+    }
+    return *this;
+}
+
+void DrawIndirectBufferObject::create(const void *data, unsigned int size,
+                                      GLenum drawType)
+{
+    destroy();
+    GL_CHECK(glGenBuffers(1, &m_id));
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_id));
+    GL_CHECK(glBufferData(GL_DRAW_INDIRECT_BUFFER, size, data, drawType));
+}
+
+void DrawIndirectBufferObject::destroy()
+{
+    if (m_id != 0)
+    {
+        GL_CHECK(glDeleteBuffers(1, &m_id));
+        m_id = 0;
+    }
+}
+
+void DrawIndirectBufferObject::bind() const
+{
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_id));
+}
+
+void DrawIndirectBufferObject::unbind() const
+{
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+}
+
+void DrawIndirectBufferObject::uploadSubData(const void *data,
+                                             unsigned int offset,
+                                             unsigned int size)
+{
+    GL_CHECK(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_id));
+    GL_CHECK(glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offset, size, data));
+}
+
+} // namespace ogl
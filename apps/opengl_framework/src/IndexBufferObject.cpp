@@ -9,6 +9,8 @@ namespace ogl
 
 IndexBufferObject::IndexBufferObject()
     : m_id(0)
+    , m_count(0)
+    , m_indexType(GL_UNSIGNED_INT)
 {
 }
 IndexBufferObject::~IndexBufferObject() { destroy(); }
@@ -16,6 +18,7 @@ IndexBufferObject::~IndexBufferObject() { destroy(); }
 IndexBufferObject::IndexBufferObject(IndexBufferObject &&other) noexcept
     : m_id(other.m_id)
     , m_count(other.m_count)
+    , m_indexType(other.m_indexType)
 {
     other.m_id = other.m_count = 0;
 }
@@ -26,8 +29,9 @@ IndexBufferObject::operator=(IndexBufferObject &&other) noexcept
     if (this != &other)
     {
         destroy();
-        m_id       = other.m_id;
-        m_count    = other.m_count;
+        m_id        = other.m_id;
+        m_count     = other.m_count;
+        m_indexType = other.m_indexType;
         other.m_id = other.m_count = 0;
     }
     return *this;
@@ -40,7 +44,19 @@ void IndexBufferObject::create(const unsigned int *data, unsigned int size,
     GL_CHECK(glGenBuffers(1, &m_id));
     GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_id));
     GL_CHECK(glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, drawType));
-    m_count = size / sizeof(unsigned int);
+    m_count     = size / sizeof(unsigned int);
+    m_indexType = GL_UNSIGNED_INT;
+}
+
+void IndexBufferObject::create(const unsigned short *data, unsigned int size,
+                               GLenum drawType)
+{
+    destroy();
+    GL_CHECK(glGenBuffers(1, &m_id));
+    GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_id));
+    GL_CHECK(glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, drawType));
+    m_count     = size / sizeof(unsigned short);
+    m_indexType = GL_UNSIGNED_SHORT;
 }
 
 void IndexBufferObject::destroy()
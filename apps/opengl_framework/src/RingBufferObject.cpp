@@ -0,0 +1,115 @@
+#include <glad/glad.h>
+#include <opengl_framework/RingBufferObject.h>
+
+#include <utility>
+
+#include "GLCheck.h"
+namespace ogl
+{
+
+RingBufferObject::RingBufferObject()
+    : m_mapped(nullptr)
+    , m_regionSize(0)
+    , m_region(0)
+{
+}
+
+RingBufferObject::~RingBufferObject() { destroy(); }
+
+RingBufferObject::RingBufferObject(RingBufferObject &&other) noexcept
+    : m_buffer(std::move(other.m_buffer))
+    , m_fences(std::move(other.m_fences))
+    , m_mapped(other.m_mapped)
+    , m_regionSize(other.m_regionSize)
+    , m_region(other.m_region)
+{
+    other.m_fences.clear();
+    other.m_mapped = nullptr;
+}
+
+RingBufferObject &RingBufferObject::operator=(RingBufferObject &&other) noexcept
+{
+    if (this != &other)
+    {
+        destroy();
+        m_buffer     = std::move(other.m_buffer);
+        m_fences     = std::move(other.m_fences);
+        m_mapped     = other.m_mapped;
+        m_regionSize = other.m_regionSize;
+        m_region     = other.m_region;
+        other.m_fences.clear();
+        other.m_mapped = nullptr;
+    }
+    return *this;
+}
+
+void RingBufferObject::create(unsigned int regionSize, unsigned int regionCount)
+{
+    destroy();
+    m_regionSize = regionSize;
+    m_region     = 0;
+
+    if (!GLAD_GL_ARB_buffer_storage || regionCount < 2)
+    {
+        m_buffer.create(nullptr, regionSize, GL_STREAM_DRAW);
+        return;
+    }
+
+    GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    m_buffer.createStorage(nullptr, regionSize * regionCount, flags);
+    m_mapped = static_cast<char *>(
+        m_buffer.mapRange(0, regionSize * regionCount, flags));
+    m_fences.resize(regionCount, nullptr);
+}
+
+void RingBufferObject::destroy()
+{
+    for (auto fence : m_fences)
+        if (fence)
+            GL_CHECK(glDeleteSync(fence));
+    m_fences.clear();
+
+    if (m_mapped)
+    {
+        m_buffer.unmap();
+        m_mapped = nullptr;
+    }
+    m_buffer.destroy();
+}
+
+void *RingBufferObject::nextRegion()
+{
+    if (!m_mapped)
+        return nullptr;
+
+    auto &fence = m_fences[m_region];
+    if (fence)
+        GL_CHECK(glDeleteSync(fence));
+    GL_CHECK(fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+    m_region = (m_region + 1) % static_cast<unsigned int>(m_fences.size());
+
+    auto &next = m_fences[m_region];
+    if (next)
+    {
+        GLenum status;
+        do
+        {
+            GL_CHECK(status = glClientWaitSync(
+                         next, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000));
+        } while (status == GL_TIMEOUT_EXPIRED);
+        GL_CHECK(glDeleteSync(next));
+        next = nullptr;
+    }
+
+    return m_mapped + regionOffset();
+}
+
+void RingBufferObject::uploadRegion(const void *data)
+{
+    if (!m_mapped)
+        m_buffer.uploadSubData(data, 0, m_regionSize);
+}
+
+} // namespace ogl
@@ -3,6 +3,7 @@
 #include <string>
 #include <stdexcept>
 #include <fstream>
+#include <utility>
 
 #include <opengl_framework/Shader.h>
 
@@ -18,6 +19,7 @@ Shader::Shader()
 
 Shader::Shader(Shader &&other) noexcept
     : m_id(other.m_id)
+    , m_uniformLocationCache(std::move(other.m_uniformLocationCache))
 {
     other.m_id = 0;
 }
@@ -27,8 +29,9 @@ Shader &Shader::operator=(Shader &&other) noexcept
     if (this != &other)
     {
         destroy();
-        m_id       = other.m_id;
-        other.m_id = 0;
+        m_id                   = other.m_id;
+        m_uniformLocationCache = std::move(other.m_uniformLocationCache);
+        other.m_id             = 0;
     }
     return *this;
 }
@@ -91,6 +94,7 @@ void Shader::create(const char *vertSrc, const char *fragSrc,
         GL_CHECK(glGetProgramInfoLog(m_id, 512, NULL, infoLog));
         throw std::runtime_error(std::string("Shader link error: ") + infoLog);
     }
+    cacheUniformLocations();
 
     GL_CHECK(glDeleteShader(vert));
     GL_CHECK(glDeleteShader(frag));
@@ -98,6 +102,35 @@ void Shader::create(const char *vertSrc, const char *fragSrc,
         GL_CHECK(glDeleteShader(geometry));
 }
 
+void Shader::cacheUniformLocations()
+{
+    m_uniformLocationCache.clear();
+
+    int count, maxLength;
+    GL_CHECK(glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &count));
+    GL_CHECK(glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength));
+
+    std::string name(maxLength, '\0');
+    for (int i = 0; i < count; ++i)
+    {
+        int    length, size;
+        GLenum type;
+        GL_CHECK(glGetActiveUniform(m_id, i, maxLength, &length, &size, &type,
+                                    &name[0]));
+
+        int loc;
+        GL_CHECK(loc = glGetUniformLocation(m_id, name.c_str()));
+        if (loc < 0) // in a uniform block
+            continue;
+
+        std::string key(name.data(), length);
+        m_uniformLocationCache[key] = loc;
+        // Arrays are reported as "name[0]"
+        if (key.size() >= 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+            m_uniformLocationCache[key.substr(0, key.size() - 3)] = loc;
+    }
+}
+
 void Shader::createFromFile(const char *vertPath, const char *fragPath,
                             const char *geomPath)
 {
@@ -142,6 +175,7 @@ void         Shader::destroy()
         GL_CHECK(glDeleteProgram(m_id));
         m_id = 0;
     }
+    m_uniformLocationCache.clear();
 }
 Shader::~Shader() { destroy(); }
 
@@ -161,34 +195,73 @@ int Shader::getUniformLocation(const std::string &name) const
 
 void Shader::setUniform1i(const std::string &name, int n) const
 {
-    GL_CHECK(glUniform1i(getUniformLocation(name), n));
+    setUniform1i(getUniformLocation(name), n);
 }
 
 void Shader::setUniform2fv(const std::string &name, const float *v) const
 {
-    GL_CHECK(glUniform2fv(getUniformLocation(name), 1, v));
+    setUniform2fv(getUniformLocation(name), v);
 }
 
 void Shader::setUniform3fv(const std::string &name, const float *v) const
 {
-    GL_CHECK(glUniform3fv(getUniformLocation(name), 1, v));
+    setUniform3fv(getUniformLocation(name), v);
 }
 
 void Shader::setUniform1f(const std::string &name, float f) const
 {
-    GL_CHECK(glUniform1f(getUniformLocation(name), f));
+    setUniform1f(getUniformLocation(name), f);
 }
 
 void Shader::setUniform4fv(const std::string &name, const float *v) const
 {
-    GL_CHECK(glUniform4fv(getUniformLocation(name), 1, v));
+    setUniform4fv(getUniformLocation(name), v);
 }
 
 void Shader::setUniformMatrix4fv(const std::string &name, const float *ptr,
                                  bool transpose, unsigned int count) const
 {
-    GL_CHECK(
-        glUniformMatrix4fv(getUniformLocation(name), count, transpose, ptr));
+    setUniformMatrix4fv(getUniformLocation(name), ptr, transpose, count);
+}
+
+void Shader::setUniform1i(int location, int n) const
+{
+    GL_CHECK(glUniform1i(location, n));
+}
+
+void Shader::setUniform2fv(int location, const float *v) const
+{
+    GL_CHECK(glUniform2fv(location, 1, v));
+}
+
+void Shader::setUniform3fv(int location, const float *v) const
+{
+    GL_CHECK(glUniform3fv(location, 1, v));
+}
+
+void Shader::setUniform1f(int location, float f) const
+{
+    GL_CHECK(glUniform1f(location, f));
+}
+
+void Shader::setUniform4fv(int location, const float *v) const
+{
+    GL_CHECK(glUniform4fv(location, 1, v));
+}
+
+void Shader::setUniformMatrix4fv(int location, const float *ptr,
+                                 bool transpose, unsigned int count) const
+{
+    GL_CHECK(glUniformMatrix4fv(location, count, transpose, ptr));
+}
+
+void Shader::setUniformBlockBinding(const std::string &blockName,
+                                    unsigned int       binding) const
+{
+    unsigned int index;
+    GL_CHECK(index = glGetUniformBlockIndex(m_id, blockName.c_str()));
+    if (index != GL_INVALID_INDEX)
+        GL_CHECK(glUniformBlockBinding(m_id, index, binding));
 }
 
 } // namespace ogl
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include <glad/glad.h>
+
+#include <opengl_framework/UniformBufferObject.h>
+
+#include "GLCheck.h"
+
+namespace ogl
+{
+
+UniformBufferObject::UniformBufferObject()
+    : m_id(0)
+{
+}
+
+UniformBufferObject::~UniformBufferObject() { destroy(); }
+
+UniformBufferObject::UniformBufferObject(UniformBufferObject &&other) noexcept
+    : m_id(other.m_id)
+{
+    other.m_id = 0;
+}
+
+UniformBufferObject &
+UniformBufferObject::operator=(UniformBufferObject &&other) noexcept
+{
+    if (this != &other)
+    {
+        destroy();
+        m_id       = other.m_id;
+        other.m_id = 0;
+    }
+    return *this;
+}
+
+void UniformBufferObject::create(const void *data, unsigned int size,
+                                 GLenum drawType)
+{
+    destroy();
+    GL_CHECK(glGenBuffers(1, &m_id));
+    GL_CHECK(glBindBuffer(GL_UNIFORM_BUFFER, m_id));
+    GL_CHECK(glBufferData(GL_UNIFORM_BUFFER, size, data, drawType));
+}
+
+void UniformBufferObject::destroy()
+{
+    if (m_id != 0)
+    {
+        GL_CHECK(glDeleteBuffers(1, &m_id));
+        m_id = 0;
+    }
+}
+
+void UniformBufferObject::uploadSubData(const void *data, unsigned int offset,
+                                        unsigned int size)
+{
+    GL_CHECK(glBindBuffer(GL_UNIFORM_BUFFER, m_id));
+    GL_CHECK(glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data));
+}
+
+void UniformBufferObject::bindRange(unsigned int binding, unsigned int offset,
+                                    unsigned int size) const
+{
+    GL_CHECK(glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_id, offset, size));
+}
+
+} // namespace ogl
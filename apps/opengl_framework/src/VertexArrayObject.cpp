@@ -36,18 +36,28 @@ void VertexArrayObject::create()
 }
 
 void VertexArrayObject::addBuffer(const VertexBufferObject &vbo,
-                                  const VertexBufferLayout &layout)
+                                  const VertexBufferLayout &layout,
+                                  unsigned int              firstAttrib,
+                                  unsigned int              baseOffset)
 {
     bind();
     vbo.bind();
 
     for (unsigned int i = 0; i < layout.getElementCount(); ++i)
     {
-        GL_CHECK(glEnableVertexAttribArray(i));
-        GL_CHECK(glVertexAttribPointer(
-            i, layout.getCount(i), layout.getType(i), GL_FALSE,
-            layout.getStride(i),
-            (const void *)(uintptr_t)(layout.getOffset(i))));
+        auto offset =
+            (const void *)(uintptr_t)(baseOffset + layout.getOffset(i));
+        GL_CHECK(glEnableVertexAttribArray(firstAttrib + i));
+        if (layout.getInteger(i))
+            GL_CHECK(glVertexAttribIPointer(firstAttrib + i,
+                                            layout.getCount(i),
+                                            layout.getType(i),
+                                            layout.getStride(i), offset));
+        else
+            GL_CHECK(glVertexAttribPointer(
+                firstAttrib + i, layout.getCount(i), layout.getType(i),
+                layout.getNormalized(i) ? GL_TRUE : GL_FALSE,
+                layout.getStride(i), offset));
     }
 }
 
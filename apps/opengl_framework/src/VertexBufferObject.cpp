@@ -37,6 +37,15 @@ void VertexBufferObject::create(const void *data, unsigned int size,
     GL_CHECK(glBufferData(GL_ARRAY_BUFFER, size, data, drawType));
 }
 
+void VertexBufferObject::createStorage(const void *data, unsigned int size,
+                                       GLbitfield flags)
+{
+    destroy();
+    GL_CHECK(glGenBuffers(1, &m_id));
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, m_id));
+    GL_CHECK(glBufferStorage(GL_ARRAY_BUFFER, size, data, flags));
+}
+
 void VertexBufferObject::destroy()
 {
     if (m_id != 0)
@@ -63,4 +72,19 @@ void VertexBufferObject::uploadSubData(const void *data, unsigned int offset,
     GL_CHECK(glBufferSubData(GL_ARRAY_BUFFER, offset, size, data));
 }
 
+void *VertexBufferObject::mapRange(unsigned int offset, unsigned int size,
+                                   GLbitfield access)
+{
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, m_id));
+    void *ptr;
+    GL_CHECK(ptr = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, access));
+    return ptr;
+}
+
+void VertexBufferObject::unmap()
+{
+    GL_CHECK(glBindBuffer(GL_ARRAY_BUFFER, m_id));
+    GL_CHECK(glUnmapBuffer(GL_ARRAY_BUFFER));
+}
+
 } // namespace ogl
@@ -1,9 +1,22 @@
 const char *defaultVertShaderSrc = R"(
 #version 330 core
 layout(location = 0) in vec3 aPos;
+#ifdef OCT_NORMALS
+layout(location = 1) in vec2 aOctNormal;
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+#define aNormal octDecode(aOctNormal)
+#else
 layout(location = 1) in vec3 aNormal;
+#endif
 layout(location = 2) in vec2 aUV;
 ///ADDITIONAL_UV_LAYOUT///
+layout(location = 7) in int aMaterialIndex;
 uniform mat4 u_model;
 uniform mat4 u_MVP;
 uniform mat4 u_lightVP;
@@ -12,7 +25,9 @@ out vec2 uv;
 ///ADDITIONAL_UV_OUT///
 out vec3 fragPos;
 out vec4 fragPosLightSpace;
+flat out int materialIndex;
 void main() {
+    materialIndex = aMaterialIndex;
     normal = normalize(mat3(transpose(inverse(u_model))) * aNormal);
     uv = aUV;
     ///ADDITIONAL_UV_V2F///
@@ -29,32 +44,15 @@ in vec2 uv;
 ///ADDITIONAL_UV_IN///
 in vec3 fragPos;
 in vec4 fragPosLightSpace;
-struct Material {
-    vec4 diffuse;
-    vec3 specular;
-    float specularPower;
-    vec3 ambient;
-    vec4 edgeColor;
-    float edgeSize;
-    int hasTexture;
-    vec4 textureAdd;
-    vec4 textureMul;
-    sampler2D texture;
-    int sphereTextureMode;
-    vec4 sphereTextureAdd;
-    vec4 sphereTextureMul;
-    sampler2D sphereTexture;
-    int hasToonTexture;
-    vec4 toonTextureAdd;
-    vec4 toonTextureMul;
-    sampler2D toonTexture;
-};
-uniform Material u_mat;
+flat in int materialIndex;
+///MATERIALS///
+uniform sampler2D u_texture;
+uniform sampler2D u_sphereTexture;
+uniform sampler2D u_toonTexture;
 uniform vec3 u_viewDir;
 uniform vec3 u_lightDir;
 uniform vec3 u_lightColor;
 uniform vec3 u_ambientColor;
-uniform int u_receiveShadow;
 uniform int u_hasShadowMap;
 uniform sampler2D u_shadowMap;
 out vec4 FragColor;
@@ -112,7 +110,7 @@ void main() {
     phong = clamp(phong, 0.0, 1.0);
     vec4 color = vec4(phong, u_mat.diffuse.a);
     if (u_mat.hasTexture == 1) {
-        color *= texture(u_mat.texture, uv);
+        color *= texture(u_texture, uv);
         if (color.a == 0.0) discard;
         color = applyMul(color, u_mat.textureMul);
         color = applyAdd(color, u_mat.textureAdd);
@@ -122,7 +120,7 @@ void main() {
         vec3 b = cross(viewDir, t);
         vec2 spUV = vec2(dot(norm, t), -dot(norm, b));
         spUV = 0.5 + 0.5 * spUV;
-        vec4 spColor = texture(u_mat.sphereTexture, spUV);
+        vec4 spColor = texture(u_sphereTexture, spUV);
         spColor = applyMul(spColor, u_mat.sphereTextureMul);
         spColor = applyAdd(spColor, u_mat.sphereTextureAdd);
         if (u_mat.sphereTextureMode == 1)
@@ -136,18 +134,18 @@ void main() {
     #else
         vec2 spUV = uv;
     #endif
-        vec4 spColor = texture(u_mat.sphereTexture, spUV);
+        vec4 spColor = texture(u_sphereTexture, spUV);
         spColor = applyMul(spColor, u_mat.sphereTextureMul);
         spColor = applyAdd(spColor, u_mat.sphereTextureAdd);
         color *= spColor;
     }
 
     float visibility = 0.5 * dot(norm, lightDir) + 0.5;
-    if (u_hasShadowMap * u_receiveShadow > 0)
+    if (u_hasShadowMap * u_mat.receiveShadow > 0)
         visibility = min(visibility, 1.0 - shadow(fragPosLightSpace));
     if (u_mat.hasToonTexture == 1) {
         vec2 toonUV = vec2(0.5, clamp(1.0 - visibility, 0.0, 1.0));
-        vec4 toonColor = texture(u_mat.toonTexture, toonUV);
+        vec4 toonColor = texture(u_toonTexture, toonUV);
         toonColor = applyMul(toonColor, u_mat.toonTextureMul);
         toonColor = applyAdd(toonColor, u_mat.toonTextureAdd);
         color *= toonColor;
@@ -160,26 +158,42 @@ void main() {
 const char *defaultEdgeVertShaderSrc = R"(
 #version 330 core
 layout(location = 0) in vec3 aPos;
+#ifdef OCT_NORMALS
+layout(location = 1) in vec2 aOctNormal;
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+#define aNormal octDecode(aOctNormal)
+#else
 layout(location = 1) in vec3 aNormal;
+#endif
+layout(location = 7) in int aMaterialIndex;
 uniform mat4 u_MV;
 uniform mat4 u_MVP;
 uniform vec2 u_viewportSize;
-uniform float u_edgeSize;
+flat out int materialIndex;
+///MATERIALS///
 void main() {
+    materialIndex = aMaterialIndex;
     vec3 norm = normalize(transpose(inverse(mat3(u_MV))) * aNormal);
     vec4 pos = u_MVP * vec4(aPos, 1.0);
     vec2 screenNorm = normalize(norm.xy);
-    pos.xy += screenNorm * 2 / u_viewportSize * u_edgeSize * 2 * pos.w;
+    pos.xy += screenNorm * 2 / u_viewportSize * u_mat.edgeSize * 2 * pos.w;
     gl_Position = pos;
 }
 )";
 
 const char *defaultEdgeFragShaderSrc = R"(
 #version 330 core
-uniform vec4 u_edgeColor;
+flat in int materialIndex;
+///MATERIALS///
 out vec4 FragColor;
 void main() {
-    FragColor = u_edgeColor;
+    FragColor = u_mat.edgeColor;
 }
 )";
 
@@ -220,3 +234,31 @@ void main() {
     FragColor = vec4(0.1, 0.1, 0.1, 1.0);
 }
 )";
+
+// Replaces ///MATERIALS/// in the mesh and edge shaders, after
+// "#define MATERIAL_COUNT n", where materialIndex is declared. Mirrors
+// MaterialUniforms in ModelRenderer.h.
+const char *materialsShaderSrc = R"(
+struct Material {
+    vec4 diffuse;
+    vec3 specular;
+    float specularPower;
+    vec3 ambient;
+    float edgeSize;
+    vec4 edgeColor;
+    vec4 textureAdd;
+    vec4 textureMul;
+    vec4 sphereTextureAdd;
+    vec4 sphereTextureMul;
+    vec4 toonTextureAdd;
+    vec4 toonTextureMul;
+    int hasTexture;
+    int sphereTextureMode;
+    int hasToonTexture;
+    int receiveShadow;
+};
+layout(std140) uniform Materials {
+    Material u_materials[MATERIAL_COUNT];
+};
+#define u_mat u_materials[materialIndex]
+)";
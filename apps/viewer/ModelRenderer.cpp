@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <mutex>
+#include <numeric>
 
 #include <stb/stb_image.h>
 
@@ -11,6 +15,9 @@
 
 std::mutex sharedToonTexturesInitMutex;
 
+constexpr unsigned int MATERIALS_BINDING     = 0;
+constexpr unsigned int MATERIAL_INDEX_ATTRIB = 7;
+
 bool                           ModelRenderer::sharedToonTexturesLoaded = false;
 std::array<ogl::Texture2D, 10> ModelRenderer::sharedToonTextures;
 
@@ -26,9 +33,10 @@ void ModelRenderer::releaseSharedToonTextures()
 
 ModelRenderer::ModelRenderer(
     const std::shared_ptr<const glmmd::ModelData> &data,
-    const ModelRendererShaderSources              &shaderSources)
+    const ModelRendererShaderSources &shaderSources, bool compactVertices)
     : m_modelData(data)
-    , m_renderData(data)
+    , m_renderData(data, compactVertices ? glmmd::VertexLayout::CompactStreams
+                                         : glmmd::VertexLayout::Streams)
 {
     initBuffers();
     m_textures.resize(m_modelData->textures.size());
@@ -39,25 +47,95 @@ ModelRenderer::ModelRenderer(
 
 void ModelRenderer::initBuffers()
 {
-    m_VBO.create(nullptr,
-                 static_cast<unsigned int>(sizeof(GLfloat) *
-                                           m_renderData.vertexBuffer.size()),
-                 GL_DYNAMIC_DRAW);
-    m_VBO.bind();
-
-    ogl::VertexBufferLayout layout;
-    layout.push(GL_FLOAT, 3);
-    layout.push(GL_FLOAT, 3);
-    layout.push(GL_FLOAT, 2);
+    m_vertexRing.create(static_cast<unsigned int>(
+        sizeof(GLfloat) * m_renderData.vertexBuffer.size()));
+    m_uvVBO.create(m_renderData.uvBuffer.data(),
+                   static_cast<unsigned int>(sizeof(GLfloat) *
+                                             m_renderData.uvBuffer.size()),
+                   GL_DYNAMIC_DRAW);
+    m_uploadedUVVersion = m_renderData.uvVersion;
+
+    bool compact =
+        m_renderData.layout() == glmmd::VertexLayout::CompactStreams;
+
+    m_vertexLayout.push(GL_FLOAT, 3);
+    if (compact)
+        m_vertexLayout.push(GL_SHORT, 2, true); // octahedral normal
+    else
+        m_vertexLayout.push(GL_FLOAT, 3);
+
+    GLenum uvType = compact ? GL_HALF_FLOAT : GL_FLOAT;
+
+    ogl::VertexBufferLayout uvLayout;
+    uvLayout.push(uvType, 2);
     for (uint8_t i = 0; i < m_modelData->info.additionalUVNum; ++i)
-        layout.push(GL_FLOAT, 4);
+        uvLayout.push(uvType, 4);
 
     m_VAO.create();
     m_VAO.bind();
-    m_VAO.addBuffer(m_VBO, layout);
-    m_IBO.create(m_modelData->indices.data(),
-                 static_cast<unsigned int>(sizeof(GLuint) *
-                                           m_modelData->indices.size()));
+    m_VAO.addBuffer(m_vertexRing.buffer(), m_vertexLayout);
+    m_VAO.addBuffer(m_uvVBO, uvLayout, m_vertexLayout.getElementCount());
+    m_vertexOffset = 0;
+    if (compact && m_modelData->vertices.size() <= 0x10000)
+    {
+        std::vector<GLushort> indices(m_modelData->indices.begin(),
+                                      m_modelData->indices.end());
+        m_IBO.create(indices.data(), static_cast<unsigned int>(
+                                         sizeof(GLushort) * indices.size()));
+        m_indexSize = sizeof(GLushort);
+    }
+    else
+    {
+        m_IBO.create(m_modelData->indices.data(),
+                     static_cast<unsigned int>(sizeof(GLuint) *
+                                               m_modelData->indices.size()));
+        m_indexSize = sizeof(GLuint);
+    }
+
+    GLint maxBlockSize, offsetAlignment;
+    glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+
+    size_t materialSize  = sizeof(MaterialUniforms);
+    size_t materialCount = std::max<size_t>(m_modelData->materials.size(), 1);
+    m_materialsPerBlock  = std::min(materialCount, maxBlockSize / materialSize);
+    // Blocks after the first start at multiples of the offset alignment
+    if (m_materialsPerBlock < materialCount)
+        while (m_materialsPerBlock > 1 &&
+               m_materialsPerBlock * materialSize % offsetAlignment != 0)
+            --m_materialsPerBlock;
+
+    size_t blockCount =
+        (materialCount + m_materialsPerBlock - 1) / m_materialsPerBlock;
+    m_materialUniforms.resize(blockCount * m_materialsPerBlock);
+    m_materialUBO.create(nullptr,
+                         static_cast<unsigned int>(
+                             materialSize * m_materialUniforms.size()));
+    m_uploadedMaterialVersion = m_renderData.materialVersion - 1;
+
+    m_multiDrawIndirect =
+        GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance;
+    m_drawCommands.reserve(DrawPassCount * materialCount);
+    if (m_multiDrawIndirect)
+    {
+        // Instance i of a command with baseInstance b reads index b + i
+        std::vector<GLint> indices(m_materialsPerBlock);
+        std::iota(indices.begin(), indices.end(), 0);
+        m_materialIndexVBO.create(
+            indices.data(),
+            static_cast<unsigned int>(sizeof(GLint) * indices.size()),
+            GL_STATIC_DRAW);
+
+        ogl::VertexBufferLayout indexLayout;
+        indexLayout.pushInteger(GL_INT, 1);
+        m_VAO.addBuffer(m_materialIndexVBO, indexLayout,
+                        MATERIAL_INDEX_ATTRIB);
+        glVertexAttribDivisor(MATERIAL_INDEX_ATTRIB, 1);
+
+        m_drawCommandBuffer.create(
+            nullptr, static_cast<unsigned int>(sizeof(DrawCommand) *
+                                               m_drawCommands.capacity()));
+    }
 }
 
 void ModelRenderer::initTextures()
@@ -131,10 +209,41 @@ void ModelRenderer::initSharedToonTextures()
     }
 }
 
+// Inserts "#define name" after the #version line
+static void addShaderDefine(std::string &src, const char *name)
+{
+    size_t pos = src.find("#version");
+    pos        = pos == std::string::npos ? 0 : src.find('\n', pos) + 1;
+    src.insert(pos, std::string("#define ") + name + "\n");
+}
+
+// Replaces ///MATERIALS/// with the material block
+static void addMaterialsBlock(std::string &src, size_t materialCount)
+{
+    size_t pos = src.find("///MATERIALS///");
+    if (pos == std::string::npos)
+        return;
+    src.replace(pos, sizeof("///MATERIALS///") - 1,
+                "#define MATERIAL_COUNT " + std::to_string(materialCount) +
+                    "\n" + materialsShaderSrc);
+}
+
 void ModelRenderer::initShaders(const ModelRendererShaderSources &shaderSources)
 {
-    std::string vertShaderSrc = shaderSources.vertShaderSrc;
-    std::string fragShaderSrc = shaderSources.fragShaderSrc;
+    std::string vertShaderSrc     = shaderSources.vertShaderSrc;
+    std::string fragShaderSrc     = shaderSources.fragShaderSrc;
+    std::string edgeVertShaderSrc = shaderSources.edgeVertShaderSrc;
+    std::string edgeFragShaderSrc = shaderSources.edgeFragShaderSrc;
+
+    addMaterialsBlock(fragShaderSrc, m_materialsPerBlock);
+    addMaterialsBlock(edgeVertShaderSrc, m_materialsPerBlock);
+    addMaterialsBlock(edgeFragShaderSrc, m_materialsPerBlock);
+
+    if (m_renderData.layout() == glmmd::VertexLayout::CompactStreams)
+    {
+        addShaderDefine(vertShaderSrc, "OCT_NORMALS");
+        addShaderDefine(edgeVertShaderSrc, "OCT_NORMALS");
+    }
 
     if (m_modelData->info.additionalUVNum > 0)
     {
@@ -168,21 +277,273 @@ void ModelRenderer::initShaders(const ModelRendererShaderSources &shaderSources)
     }
 
     m_shader.create(vertShaderSrc.c_str(), fragShaderSrc.c_str());
-    m_edgeShader.create(shaderSources.edgeVertShaderSrc,
-                        shaderSources.edgeFragShaderSrc);
+    m_edgeShader.create(edgeVertShaderSrc.c_str(), edgeFragShaderSrc.c_str());
     m_shadowMapShader.create(shaderSources.shadowMapVertShaderSrc,
                              shaderSources.shadowMapFragShaderSrc);
     m_groundShadowShader.create(shaderSources.groundShadowVertShaderSrc,
                                 shaderSources.groundShadowFragShaderSrc);
+
+    m_shader.use();
+    m_shader.setUniform1i("u_texture", 0);
+    m_shader.setUniform1i("u_sphereTexture", 1);
+    m_shader.setUniform1i("u_toonTexture", 2);
+    m_shader.setUniform1i("u_shadowMap", 3);
+    m_shader.setUniformBlockBinding("Materials", MATERIALS_BINDING);
+
+    m_edgeShader.setUniformBlockBinding("Materials", MATERIALS_BINDING);
+
+    m_meshUniforms.model        = m_shader.getUniformLocation("u_model");
+    m_meshUniforms.MVP          = m_shader.getUniformLocation("u_MVP");
+    m_meshUniforms.viewDir      = m_shader.getUniformLocation("u_viewDir");
+    m_meshUniforms.lightDir     = m_shader.getUniformLocation("u_lightDir");
+    m_meshUniforms.lightColor   = m_shader.getUniformLocation("u_lightColor");
+    m_meshUniforms.ambientColor = m_shader.getUniformLocation("u_ambientColor");
+    m_meshUniforms.lightVP      = m_shader.getUniformLocation("u_lightVP");
+    m_meshUniforms.hasShadowMap = m_shader.getUniformLocation("u_hasShadowMap");
+
+    m_edgeUniforms.MV  = m_edgeShader.getUniformLocation("u_MV");
+    m_edgeUniforms.MVP = m_edgeShader.getUniformLocation("u_MVP");
+    m_edgeUniforms.viewportSize =
+        m_edgeShader.getUniformLocation("u_viewportSize");
+
+    m_groundShadowUniforms.MVP =
+        m_groundShadowShader.getUniformLocation("u_MVP");
+
+    m_shadowMapUniforms.lightVP =
+        m_shadowMapShader.getUniformLocation("u_lightVP");
+    m_shadowMapUniforms.model = m_shadowMapShader.getUniformLocation("u_model");
+}
+
+const ogl::Texture2D *ModelRenderer::materialTexture(size_t i) const
+{
+    int32_t index = m_modelData->materials[i].textureIndex;
+    if (index < 0 || m_textures[index].id() == 0)
+        return nullptr;
+    return &m_textures[index];
+}
+
+const ogl::Texture2D *ModelRenderer::materialSphereTexture(size_t i) const
+{
+    const auto &mat = m_modelData->materials[i];
+    if (mat.sphereTextureIndex < 0 || mat.sphereMode == 0 ||
+        m_textures[mat.sphereTextureIndex].id() == 0)
+        return nullptr;
+    return &m_textures[mat.sphereTextureIndex];
 }
 
-void ModelRenderer::fillBuffers() const
+const ogl::Texture2D *ModelRenderer::materialToonTexture(size_t i) const
+{
+    const auto &mat = m_modelData->materials[i];
+    if (mat.toonTextureIndex < 0)
+        return nullptr;
+    if (mat.sharedToonFlag)
+        return &sharedToonTextures[mat.toonTextureIndex];
+    if (m_textures[mat.toonTextureIndex].id() == 0)
+        return nullptr;
+    return &m_textures[mat.toonTextureIndex];
+}
+
+void ModelRenderer::packMaterials()
+{
+    for (size_t i = 0; i < m_modelData->materials.size(); ++i)
+    {
+        const auto &mat     = m_renderData.materials[i];
+        const auto &dataMat = m_modelData->materials[i];
+        auto       &u       = m_materialUniforms[i];
+
+        u.diffuse           = mat.diffuse;
+        u.specular          = mat.specular;
+        u.specularPower     = mat.specularPower;
+        u.ambient           = mat.ambient;
+        u.edgeSize          = mat.edgeSize;
+        u.edgeColor         = mat.edgeColor;
+        u.textureAdd        = mat.add.texture;
+        u.textureMul        = mat.mul.texture;
+        u.sphereTextureAdd  = mat.add.sphereTexture;
+        u.sphereTextureMul  = mat.mul.sphereTexture;
+        u.toonTextureAdd    = mat.add.toonTexture;
+        u.toonTextureMul    = mat.mul.toonTexture;
+        u.hasTexture        = materialTexture(i) != nullptr;
+        u.sphereTextureMode = materialSphereTexture(i) ? dataMat.sphereMode : 0;
+        u.hasToonTexture    = materialToonTexture(i) != nullptr;
+        u.receiveShadow     = dataMat.receiveShadow();
+    }
+}
+
+void ModelRenderer::buildDrawBatches()
+{
+    m_drawCommands.clear();
+
+    // Appends the command of material i to the last batch of the pass, or to
+    // a new one if their states differ. Only consecutive materials share a
+    // batch since blending depends on the order they are drawn in.
+    auto addCommand = [this](DrawPass pass, size_t i, size_t indexOffset,
+                             const DrawBatch &state)
+    {
+        auto &batches = m_drawBatches[pass];
+        bool  merge   = !batches.empty() &&
+                     batches.back().block == state.block &&
+                     batches.back().doubleSided == state.doubleSided;
+        for (size_t t = 0; merge && t < state.textures.size(); ++t)
+            merge = !batches.back().textures[t] || !state.textures[t] ||
+                    batches.back().textures[t] == state.textures[t];
+
+        if (!merge)
+        {
+            batches.push_back(state);
+            batches.back().firstCommand = m_drawCommands.size();
+            batches.back().commandCount = 0;
+        }
+        auto &batch = batches.back();
+        for (size_t t = 0; t < state.textures.size(); ++t)
+            if (!batch.textures[t])
+                batch.textures[t] = state.textures[t];
+        ++batch.commandCount;
+
+        m_drawCommands.push_back(
+            {static_cast<GLuint>(m_modelData->materials[i].indicesCount), 1,
+             static_cast<GLuint>(indexOffset), 0,
+             static_cast<GLuint>(i % m_materialsPerBlock)});
+    };
+
+    for (size_t pass = 0; pass < DrawPassCount; ++pass)
+    {
+        m_drawBatches[pass].clear();
+
+        // The shadow map is depth only, so it draws single sided materials
+        // before double sided ones
+        size_t sweepCount = pass == ShadowMapPass ? 2 : 1;
+        for (size_t sweep = 0; sweep < sweepCount; ++sweep)
+            for (size_t i = 0, indexOffset = 0;
+                 i < m_modelData->materials.size();
+                 indexOffset += m_modelData->materials[i++].indicesCount)
+            {
+                const auto &mat     = m_renderData.materials[i];
+                const auto &dataMat = m_modelData->materials[i];
+
+                DrawBatch state{0, 0, SIZE_MAX, false, {}};
+                bool      draw = mat.diffuse.a != 0.f;
+                switch (pass)
+                {
+                case MeshPass:
+                    state.block       = i / m_materialsPerBlock;
+                    state.doubleSided = dataMat.doubleSided();
+                    state.textures    = {materialTexture(i),
+                                         materialSphereTexture(i),
+                                         materialToonTexture(i)};
+                    break;
+                case EdgePass:
+                    state.block = i / m_materialsPerBlock;
+                    draw = dataMat.renderEdge() && mat.edgeSize != 0.f &&
+                           mat.edgeColor.a != 0.f;
+                    break;
+                case GroundShadowPass:
+                    draw = draw && dataMat.groundShadow();
+                    break;
+                case ShadowMapPass:
+                    state.doubleSided = dataMat.doubleSided();
+                    draw = draw && dataMat.castShadow() &&
+                           state.doubleSided == (sweep == 1);
+                    break;
+                }
+
+                if (draw)
+                    addCommand(static_cast<DrawPass>(pass), i, indexOffset,
+                               state);
+            }
+    }
+}
+
+void ModelRenderer::bindMaterialBlock(size_t block, size_t &boundBlock) const
+{
+    if (block == boundBlock)
+        return;
+    boundBlock = block;
+
+    size_t blockSize = sizeof(MaterialUniforms) * m_materialsPerBlock;
+    m_materialUBO.bindRange(MATERIALS_BINDING,
+                            static_cast<unsigned int>(block * blockSize),
+                            static_cast<unsigned int>(blockSize));
+}
+
+void ModelRenderer::drawBatch(const DrawBatch &batch) const
+{
+    if (m_multiDrawIndirect)
+    {
+        glMultiDrawElementsIndirect(
+            GL_TRIANGLES, m_IBO.getIndexType(),
+            (const void *)(uintptr_t)(sizeof(DrawCommand) *
+                                      batch.firstCommand),
+            static_cast<GLsizei>(batch.commandCount), sizeof(DrawCommand));
+        return;
+    }
+
+    // The material index attribute is disabled, so its current value is read
+    for (size_t i = 0; i < batch.commandCount; ++i)
+    {
+        const auto &command = m_drawCommands[batch.firstCommand + i];
+        glVertexAttribI1i(MATERIAL_INDEX_ATTRIB,
+                          static_cast<GLint>(command.baseInstance));
+        glDrawElements(
+            GL_TRIANGLES, static_cast<GLsizei>(command.count),
+            m_IBO.getIndexType(),
+            (const void *)(uintptr_t)(command.firstIndex * m_indexSize));
+    }
+}
+
+void ModelRenderer::beginFrame()
+{
+    m_renderData.setSkinningTarget(
+        static_cast<GLfloat *>(m_vertexRing.nextRegion()));
+}
+
+void ModelRenderer::fillBuffers()
 {
-    m_VBO.bind();
     m_VAO.bind();
-    glBufferData(GL_ARRAY_BUFFER,
-                 sizeof(GLfloat) * m_renderData.vertexBuffer.size(),
-                 m_renderData.vertexBuffer.data(), GL_DYNAMIC_DRAW);
+    if (!m_vertexRing.isPersistent())
+        m_vertexRing.uploadRegion(m_renderData.vertexBuffer.data());
+    else
+    {
+        // Skinned in vertexBuffer if beginFrame() was not called
+        if (m_renderData.skinningTarget() == m_renderData.vertexBuffer.data())
+            std::memcpy(m_vertexRing.nextRegion(),
+                        m_renderData.vertexBuffer.data(),
+                        sizeof(GLfloat) * m_renderData.vertexBuffer.size());
+        m_renderData.setSkinningTarget(nullptr);
+
+        if (m_vertexOffset != m_vertexRing.regionOffset())
+        {
+            m_vertexOffset = m_vertexRing.regionOffset();
+            m_VAO.addBuffer(m_vertexRing.buffer(), m_vertexLayout, 0,
+                            m_vertexOffset);
+        }
+    }
+
+    if (m_uploadedMaterialVersion != m_renderData.materialVersion)
+    {
+        packMaterials();
+        m_materialUBO.uploadSubData(
+            m_materialUniforms.data(), 0,
+            static_cast<unsigned int>(sizeof(MaterialUniforms) *
+                                      m_materialUniforms.size()));
+
+        buildDrawBatches();
+        if (m_multiDrawIndirect && !m_drawCommands.empty())
+            m_drawCommandBuffer.uploadSubData(
+                m_drawCommands.data(), 0,
+                static_cast<unsigned int>(sizeof(DrawCommand) *
+                                          m_drawCommands.size()));
+        m_uploadedMaterialVersion = m_renderData.materialVersion;
+    }
+
+    if (m_uploadedUVVersion != m_renderData.uvVersion)
+    {
+        m_uvVBO.uploadSubData(
+            m_renderData.uvBuffer.data(), 0,
+            static_cast<unsigned int>(sizeof(GLfloat) *
+                                      m_renderData.uvBuffer.size()));
+        m_uploadedUVVersion = m_renderData.uvVersion;
+    }
 }
 
 void ModelRenderer::render(const glmmd::Camera           &camera,
@@ -192,9 +553,11 @@ void ModelRenderer::render(const glmmd::Camera           &camera,
     if (m_renderFlag & MODEL_RENDER_FLAG_HIDE)
         return;
 
-    m_VBO.bind();
+    m_vertexRing.buffer().bind();
     m_VAO.bind();
     m_IBO.bind();
+    if (m_multiDrawIndirect)
+        m_drawCommandBuffer.bind();
 
     if (m_renderFlag & MODEL_RENDER_FLAG_MESH)
         renderMesh(camera, light, shadowMap);
@@ -227,107 +590,40 @@ void ModelRenderer::renderMesh(const glmmd::Camera           &camera,
     glm::vec3 dir = camera.front();
 
     m_shader.use();
-    m_shader.setUniformMatrix4fv("u_model", &model[0][0]);
-    m_shader.setUniformMatrix4fv("u_MVP", &MVP[0][0]);
+    m_shader.setUniformMatrix4fv(m_meshUniforms.model, &model[0][0]);
+    m_shader.setUniformMatrix4fv(m_meshUniforms.MVP, &MVP[0][0]);
 
-    m_shader.setUniform3fv("u_viewDir", &dir[0]);
-    m_shader.setUniform3fv("u_lightDir", &light.direction[0]);
-    m_shader.setUniform3fv("u_lightColor", &light.color[0]);
-    m_shader.setUniform3fv("u_ambientColor", &light.ambientColor[0]);
+    m_shader.setUniform3fv(m_meshUniforms.viewDir, &dir[0]);
+    m_shader.setUniform3fv(m_meshUniforms.lightDir, &light.direction[0]);
+    m_shader.setUniform3fv(m_meshUniforms.lightColor, &light.color[0]);
+    m_shader.setUniform3fv(m_meshUniforms.ambientColor,
+                           &light.ambientColor[0]);
 
-    m_shader.setUniformMatrix4fv("u_lightVP",
+    m_shader.setUniformMatrix4fv(m_meshUniforms.lightVP,
                                  &(light.proj() * light.view())[0][0]);
 
-    m_shader.setUniform1i("u_hasShadowMap", shadowMap != nullptr);
+    m_shader.setUniform1i(m_meshUniforms.hasShadowMap, shadowMap != nullptr);
     if (shadowMap != nullptr)
-    {
         shadowMap->bind(3);
-        m_shader.setUniform1i("u_shadowMap", 3);
-    }
 
-    for (size_t i = 0, indexOffset = 0; i < m_modelData->materials.size();
-         indexOffset += m_modelData->materials[i++].indicesCount)
+    size_t block = SIZE_MAX;
+    for (const auto &batch : m_drawBatches[MeshPass])
     {
-        const auto &mat    = m_renderData.materials[i];
-        const auto &matAdd = m_renderData.materials[i].add;
-        const auto &matMul = m_renderData.materials[i].mul;
-
-        if (mat.diffuse.a == 0.f)
-            continue;
+        batch.doubleSided ? glDisable(GL_CULL_FACE) : glEnable(GL_CULL_FACE);
 
-        m_modelData->materials[i].doubleSided() ? glDisable(GL_CULL_FACE)
-                                                : glEnable(GL_CULL_FACE);
-
-        m_shader.setUniform4fv("u_mat.diffuse", &mat.diffuse[0]);
-        m_shader.setUniform3fv("u_mat.specular", &mat.specular[0]);
-        m_shader.setUniform1f("u_mat.specularPower", mat.specularPower);
-        m_shader.setUniform3fv("u_mat.ambient", &mat.ambient[0]);
-
-        int32_t textureIndex = m_modelData->materials[i].textureIndex;
-        if (textureIndex >= 0 && m_textures[textureIndex].id() != 0)
-        {
-            m_textures[textureIndex].bind(0);
-            m_shader.setUniform1i("u_mat.hasTexture", 1);
-            m_shader.setUniform4fv("u_mat.textureAdd", &matAdd.texture[0]);
-            m_shader.setUniform4fv("u_mat.textureMul", &matMul.texture[0]);
-            m_shader.setUniform1i("u_mat.texture", 0);
-        }
-        else
+        if (auto *texture = batch.textures[0])
+            texture->bind(0);
+        if (auto *texture = batch.textures[1])
+            texture->bind(1);
+        if (auto *texture = batch.textures[2])
         {
-            m_shader.setUniform1i("u_mat.hasTexture", 0);
-        }
-
-        int32_t sphereTextureIndex =
-            m_modelData->materials[i].sphereTextureIndex;
-        if (sphereTextureIndex >= 0 &&
-            m_modelData->materials[i].sphereMode != 0 &&
-            m_textures[sphereTextureIndex].id() != 0)
-        {
-            m_textures[sphereTextureIndex].bind(1);
-            m_shader.setUniform1i("u_mat.sphereTextureMode",
-                                  m_modelData->materials[i].sphereMode);
-            m_shader.setUniform4fv("u_mat.sphereTextureAdd",
-                                   &matAdd.sphereTexture[0]);
-            m_shader.setUniform4fv("u_mat.sphereTextureMul",
-                                   &matMul.sphereTexture[0]);
-            m_shader.setUniform1i("u_mat.sphereTexture", 1);
-        }
-        else
-        {
-            m_shader.setUniform1i("u_mat.sphereTextureMode", 0);
-        }
-
-        int32_t toonTextureIndex = m_modelData->materials[i].toonTextureIndex;
-        if (toonTextureIndex >= 0 &&
-            (m_modelData->materials[i].sharedToonFlag ||
-             m_textures[toonTextureIndex].id() != 0))
-        {
-            (m_modelData->materials[i].sharedToonFlag
-                 ? sharedToonTextures[toonTextureIndex]
-                 : m_textures[toonTextureIndex])
-                .bind(2);
-
+            texture->bind(2);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-            m_shader.setUniform1i("u_mat.hasToonTexture", 1);
-            m_shader.setUniform4fv("u_mat.toonTextureAdd",
-                                   &matAdd.toonTexture[0]);
-            m_shader.setUniform4fv("u_mat.toonTextureMul",
-                                   &matMul.toonTexture[0]);
-            m_shader.setUniform1i("u_mat.toonTexture", 2);
-        }
-        else
-        {
-            m_shader.setUniform1i("u_mat.hasToonTexture", 0);
         }
 
-        m_shader.setUniform1i("u_receiveShadow",
-                              m_modelData->materials[i].receiveShadow());
-
-        glDrawElements(GL_TRIANGLES, m_modelData->materials[i].indicesCount,
-                       GL_UNSIGNED_INT,
-                       (const void *)(uintptr_t)(indexOffset * sizeof(GLuint)));
+        bindMaterialBlock(batch.block, block);
+        drawBatch(batch);
     }
 }
 
@@ -350,27 +646,17 @@ void ModelRenderer::renderEdge(const glmmd::Camera &camera) const
     glm::mat4 MVP   = proj * MV;
 
     m_edgeShader.use();
-    m_edgeShader.setUniformMatrix4fv("u_MV", &MV[0][0]);
-    m_edgeShader.setUniformMatrix4fv("u_MVP", &MVP[0][0]);
+    m_edgeShader.setUniformMatrix4fv(m_edgeUniforms.MV, &MV[0][0]);
+    m_edgeShader.setUniformMatrix4fv(m_edgeUniforms.MVP, &MVP[0][0]);
     m_edgeShader.setUniform2fv(
-        "u_viewportSize",
+        m_edgeUniforms.viewportSize,
         &glm::vec2(camera.viewportWidth, camera.viewportHeight)[0]);
 
-    for (size_t i = 0, indexOffset = 0; i < m_modelData->materials.size();
-         indexOffset += m_modelData->materials[i++].indicesCount)
+    size_t block = SIZE_MAX;
+    for (const auto &batch : m_drawBatches[EdgePass])
     {
-        const auto &mat = m_renderData.materials[i];
-
-        if (!m_modelData->materials[i].renderEdge() || mat.edgeSize == 0.f ||
-            mat.edgeColor.a == 0.f)
-            continue;
-
-        m_edgeShader.setUniform1f("u_edgeSize", mat.edgeSize);
-        m_edgeShader.setUniform4fv("u_edgeColor", &mat.edgeColor[0]);
-
-        glDrawElements(GL_TRIANGLES, m_modelData->materials[i].indicesCount,
-                       GL_UNSIGNED_INT,
-                       (const void *)(uintptr_t)(indexOffset * sizeof(GLuint)));
+        bindMaterialBlock(batch.block, block);
+        drawBatch(batch);
     }
 
     glPolygonOffset(0.f, 0.f);
@@ -402,19 +688,11 @@ void ModelRenderer::renderGroundShadow(
     glm::mat4 MVP = camera.proj() * camera.view() * model;
 
     m_groundShadowShader.use();
-    m_groundShadowShader.setUniformMatrix4fv("u_MVP", &MVP[0][0]);
+    m_groundShadowShader.setUniformMatrix4fv(m_groundShadowUniforms.MVP,
+                                             &MVP[0][0]);
 
-    for (size_t i = 0, indexOffset = 0; i < m_modelData->materials.size();
-         indexOffset += m_modelData->materials[i++].indicesCount)
-    {
-        if (!m_modelData->materials[i].groundShadow() ||
-            m_renderData.materials[i].diffuse.a == 0.f)
-            continue;
-
-        glDrawElements(GL_TRIANGLES, m_modelData->materials[i].indicesCount,
-                       GL_UNSIGNED_INT,
-                       (const void *)(uintptr_t)(indexOffset * sizeof(GLuint)));
-    }
+    for (const auto &batch : m_drawBatches[GroundShadowPass])
+        drawBatch(batch);
 }
 
 void ModelRenderer::renderShadowMap(const glmmd::DirectionalLight &light) const
@@ -422,36 +700,30 @@ void ModelRenderer::renderShadowMap(const glmmd::DirectionalLight &light) const
     if (m_renderFlag & MODEL_RENDER_FLAG_HIDE)
         return;
 
-    m_VBO.bind();
+    m_vertexRing.buffer().bind();
     m_VAO.bind();
     m_IBO.bind();
+    if (m_multiDrawIndirect)
+        m_drawCommandBuffer.bind();
 
     glEnable(GL_DEPTH_TEST);
 
     m_shadowMapShader.use();
-    m_shadowMapShader.setUniformMatrix4fv("u_lightVP",
-                                          &(light.proj() * light.view())[0][0]);
+    m_shadowMapShader.setUniformMatrix4fv(
+        m_shadowMapUniforms.lightVP, &(light.proj() * light.view())[0][0]);
     glm::mat4 model = glm::mat4(1.f);
-    m_shadowMapShader.setUniformMatrix4fv("u_model", &model[0][0]);
+    m_shadowMapShader.setUniformMatrix4fv(m_shadowMapUniforms.model,
+                                          &model[0][0]);
 
-    for (size_t i = 0, indexOffset = 0; i < m_modelData->materials.size();
-         indexOffset += m_modelData->materials[i++].indicesCount)
+    for (const auto &batch : m_drawBatches[ShadowMapPass])
     {
-        const auto &mat = m_modelData->materials[i];
-
-        if (m_renderData.materials[i].diffuse.a == 0.f || !mat.castShadow())
-            continue;
-
-        if (mat.doubleSided())
+        if (batch.doubleSided)
             glDisable(GL_CULL_FACE);
         else
         {
             glEnable(GL_CULL_FACE);
             glCullFace(GL_BACK);
         }
-
-        glDrawElements(GL_TRIANGLES, m_modelData->materials[i].indicesCount,
-                       GL_UNSIGNED_INT,
-                       (const void *)(uintptr_t)(indexOffset * sizeof(GLuint)));
+        drawBatch(batch);
     }
 }
@@ -19,6 +19,8 @@ extern const char *defaultShadowMapFragShaderSrc;
 extern const char *defaultGroundShadowVertShaderSrc;
 extern const char *defaultGroundShadowFragShaderSrc;
 
+// The mesh and edge shaders read their material from a uniform block,
+// declared in place of ///MATERIALS///, as u_mat.
 struct ModelRendererShaderSources
 {
     const char *vertShaderSrc             = defaultVertShaderSrc;
@@ -43,10 +45,17 @@ enum ModelRenderFlag : uint32_t
 class ModelRenderer
 {
 public:
+    // compactVertices uploads octahedral normals, half float UVs and, for
+    // up to 65536 vertices, 16-bit indices. The vertex shaders then get
+    // OCT_NORMALS defined and a 2-component normal attribute.
     ModelRenderer(const std::shared_ptr<const glmmd::ModelData> &data,
-                  const ModelRendererShaderSources &shaderSources = {});
+                  const ModelRendererShaderSources &shaderSources   = {},
+                  bool                              compactVertices = false);
 
-    void fillBuffers() const;
+    // Points skinning at the next region of the vertex ring if it is mapped
+    // persistently. Call on the GL thread before applying the pose.
+    void beginFrame();
+    void fillBuffers();
 
     void renderShadowMap(const glmmd::DirectionalLight &light) const;
     void render(const glmmd::Camera           &camera,
@@ -66,6 +75,12 @@ private:
     void initSharedToonTextures();
     void initShaders(const ModelRendererShaderSources &shaderSources);
 
+    const ogl::Texture2D *materialTexture(size_t i) const;
+    const ogl::Texture2D *materialSphereTexture(size_t i) const;
+    const ogl::Texture2D *materialToonTexture(size_t i) const;
+
+    void packMaterials();
+
     void renderMesh(const glmmd::Camera           &camera,
                     const glmmd::DirectionalLight &light,
                     const ogl::Texture2D          *shadowMap) const;
@@ -73,20 +88,137 @@ private:
     void renderGroundShadow(const glmmd::Camera           &camera,
                             const glmmd::DirectionalLight &light) const;
 
+private:
+    // std140 layout of Material in materialsShaderSrc
+    struct MaterialUniforms
+    {
+        glm::vec4 diffuse;
+        glm::vec3 specular;
+        float     specularPower;
+        glm::vec3 ambient;
+        float     edgeSize;
+        glm::vec4 edgeColor;
+        glm::vec4 textureAdd;
+        glm::vec4 textureMul;
+        glm::vec4 sphereTextureAdd;
+        glm::vec4 sphereTextureMul;
+        glm::vec4 toonTextureAdd;
+        glm::vec4 toonTextureMul;
+        int32_t   hasTexture;
+        int32_t   sphereTextureMode;
+        int32_t   hasToonTexture;
+        int32_t   receiveShadow;
+    };
+
+    enum DrawPass
+    {
+        MeshPass,
+        EdgePass,
+        GroundShadowPass,
+        ShadowMapPass,
+        DrawPassCount
+    };
+
+    // Layout of DrawElementsIndirectCommand. baseInstance is the index of
+    // the material in its block, read through the instanced attribute 7.
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint  baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Consecutive commands drawn with the same state. Null textures are
+    // left as they are bound, and block is SIZE_MAX if no block is needed.
+    struct DrawBatch
+    {
+        size_t                                firstCommand;
+        size_t                                commandCount;
+        size_t                                block;
+        bool                                  doubleSided;
+        std::array<const ogl::Texture2D *, 3> textures;
+    };
+
+    // Uniform locations, looked up once in initShaders()
+    struct MeshUniforms
+    {
+        int model        = -1;
+        int MVP          = -1;
+        int viewDir      = -1;
+        int lightDir     = -1;
+        int lightColor   = -1;
+        int ambientColor = -1;
+        int lightVP      = -1;
+        int hasShadowMap = -1;
+    };
+
+    struct EdgeUniforms
+    {
+        int MV           = -1;
+        int MVP          = -1;
+        int viewportSize = -1;
+    };
+
+    struct GroundShadowUniforms
+    {
+        int MVP = -1;
+    };
+
+    struct ShadowMapUniforms
+    {
+        int lightVP = -1;
+        int model   = -1;
+    };
+
+    void buildDrawBatches();
+    // Binds the material block unless it is boundBlock, the one bound last
+    void bindMaterialBlock(size_t block, size_t &boundBlock) const;
+    void drawBatch(const DrawBatch &batch) const;
+
 private:
     std::shared_ptr<const glmmd::ModelData> m_modelData;
 
     glmmd::ModelRenderData m_renderData;
 
-    ogl::VertexBufferObject m_VBO;
+    ogl::RingBufferObject   m_vertexRing; // positions and normals, per frame
+    ogl::VertexBufferObject m_uvVBO;      // UVs, when UV morphs change them
     ogl::VertexArrayObject  m_VAO;
     ogl::IndexBufferObject  m_IBO;
 
+    ogl::VertexBufferLayout m_vertexLayout;
+
+    size_t       m_indexSize         = sizeof(GLuint);
+    unsigned int m_vertexOffset      = 0; // of the region attributes read
+    uint32_t     m_uploadedUVVersion = 0;
+
+    // All materials, in blocks of m_materialsPerBlock that each fit a
+    // uniform block. Uploaded when materialVersion changes.
+    ogl::UniformBufferObject      m_materialUBO;
+    std::vector<MaterialUniforms> m_materialUniforms;
+    size_t                        m_materialsPerBlock       = 1;
+    uint32_t                      m_uploadedMaterialVersion = 0;
+
+    // Draw commands of the materials each pass draws, rebuilt with the
+    // materials. Submitted with glMultiDrawElementsIndirect if available.
+    ogl::VertexBufferObject       m_materialIndexVBO; // 0, 1, ..., per block
+    ogl::DrawIndirectBufferObject m_drawCommandBuffer;
+    std::vector<DrawCommand>      m_drawCommands;
+    bool                          m_multiDrawIndirect = false;
+
+    std::array<std::vector<DrawBatch>, DrawPassCount> m_drawBatches;
+
     ogl::Shader m_shader;
     ogl::Shader m_edgeShader;
     ogl::Shader m_shadowMapShader;
     ogl::Shader m_groundShadowShader;
 
+    MeshUniforms         m_meshUniforms;
+    EdgeUniforms         m_edgeUniforms;
+    GroundShadowUniforms m_groundShadowUniforms;
+    ShadowMapUniforms    m_shadowMapUniforms;
+
     std::vector<ogl::Texture2D> m_textures;
 
     static bool                           sharedToonTexturesLoaded;
@@ -59,11 +59,16 @@ template <size_t WindowSize = 64>
 class ProfilerSet
 {
 public:
-    void add(const std::string &name)
+    // Sections that run concurrently with another one are left out of
+    // totalTime() with countInTotal = false
+    void add(const std::string &name, bool countInTotal = true)
     {
         auto [_, inserted] = m_indices.emplace(name, m_profilers.size());
         if (inserted)
+        {
             m_profilers.emplace_back();
+            m_countInTotal.push_back(countInTotal);
+        }
     }
 
     void startFrame()
@@ -96,14 +101,16 @@ public:
     float totalTime() const
     {
         float total = 0.f;
-        for (const auto &profiler : m_profilers)
-            total += profiler.averageTime();
+        for (size_t i = 0; i < m_profilers.size(); ++i)
+            if (m_countInTotal[i])
+                total += m_profilers[i].averageTime();
         return total;
     }
 
 private:
     std::unordered_map<std::string, size_t> m_indices;
     std::vector<Profiler<WindowSize>>       m_profilers;
+    std::vector<bool>                       m_countInTotal;
 };
 
 #endif
@@ -9,7 +9,6 @@
 #include <ImGuiFileDialog.h>
 
 #include <glmmd/core/FixedPoseMotion.h>
-#include <glmmd/core/ParallelForEach.h>
 #include <glmmd/files/CodeConverter.h>
 #include <glmmd/files/PmxFileLoader.h>
 #include <glmmd/files/VmdFileLoader.h>
@@ -18,6 +17,14 @@
 #include "PathConv.h"
 #include "Viewer.h"
 
+static constexpr int PHYSICS_FPS[3]{60, 120, 240};
+
+enum PhysicsBackend
+{
+    PHYSICS_BACKEND_BULLET = 0,
+    PHYSICS_BACKEND_PBD    = 1,
+};
+
 void framebufferSizeCallback(GLFWwindow *, int width, int height)
 {
     glViewport(0, 0, width, height);
@@ -62,6 +69,7 @@ Viewer::Viewer(const std::filesystem::path &executableDir)
         m_initData = JsonNode{{"MSAA"_key, 4}};
     }
 
+    initThreadPool();
     initState();
 
     initWindow();
@@ -75,6 +83,22 @@ Viewer::Viewer(const std::filesystem::path &executableDir)
     initMainLight();
 }
 
+void Viewer::initThreadPool()
+{
+    glmmd::ThreadPoolConfig config;
+    config.threadCount = m_initData.get<uint32_t>("Threads", 0u);
+    if (m_initData.get<bool>("PinThreads", false))
+    {
+        uint32_t threadCount = config.threadCount != 0
+                                   ? config.threadCount
+                                   : std::thread::hardware_concurrency();
+        for (uint32_t i = 1; i < threadCount; ++i)
+            config.workerAffinity.push_back(i);
+        glmmd::setCurrentThreadAffinity(0);
+    }
+    glmmd::ThreadPool::configureGlobal(config);
+}
+
 void Viewer::initState()
 {
     m_state.showControlPanel = true;
@@ -88,6 +112,7 @@ void Viewer::initState()
     m_state.startTime = m_state.pauseTime = std::chrono::steady_clock::now();
 
     m_state.physicsEnabled      = false;
+    m_state.physicsBackend      = PHYSICS_BACKEND_BULLET;
     m_state.physicsFPSSelection = 1;
     m_state.physicsSubsteps     = 10;
 
@@ -307,7 +332,9 @@ bool Viewer::loadModel(const std::filesystem::path &path)
     std::cout << std::endl;
 
     auto &renderer = m_modelRenderers.emplace_back(
-        std::make_unique<ModelRenderer>(modelData));
+        std::make_unique<ModelRenderer>(
+            modelData, ModelRendererShaderSources{},
+            m_initData.get<bool>("CompactVertices", false)));
 
     uint32_t renderFlag = MODEL_RENDER_FLAG_MESH;
 
@@ -320,19 +347,23 @@ bool Viewer::loadModel(const std::filesystem::path &path)
     auto &model =
         m_models.emplace_back(std::make_unique<glmmd::Model>(modelData));
     m_motions.emplace_back(std::make_unique<BlendedMotion>(modelData));
+    m_physicsCaches.emplace_back();
 
     if (m_state.physicsEnabled)
-        m_physicsWorld.setupModelPhysics(*model);
+        setupModelPhysics(*model, false);
+    m_physicsCheckpoints.clear();
 
     return true;
 }
 
 void Viewer::removeModel(size_t i)
 {
-    m_physicsWorld.clearModelPhysics(*m_models[i]);
+    clearModelPhysics(*m_models[i]);
+    m_physicsCheckpoints.clear();
     m_motions.erase(m_motions.begin() + i);
     m_modelRenderers.erase(m_modelRenderers.begin() + i);
     m_models.erase(m_models.begin() + i);
+    m_physicsCaches.erase(m_physicsCaches.begin() + i);
 }
 
 void Viewer::loadMotion(const std::filesystem::path &path, size_t modelIndex,
@@ -376,6 +407,7 @@ void Viewer::loadMotion(const std::filesystem::path &path, size_t modelIndex,
 
         std::string label(filename.begin(), filename.end());
         m_motions[modelIndex]->addMotion(label, clip);
+        m_physicsCheckpoints.clear();
 
         std::cout << "Motion data loaded from: " << pathToU8string(path)
                   << '\n';
@@ -414,6 +446,7 @@ void Viewer::loadPose(const std::filesystem::path &path, size_t modelIndex)
     std::string label(filename.begin(), filename.end());
     m_motions[modelIndex]->addMotion(
         label, std::make_shared<glmmd::FixedPoseMotion>(std::move(pose)));
+    m_physicsCheckpoints.clear();
 
     std::cout << "Pose data loaded from: " << pathToU8string(path) << '\n';
     std::cout << "Created on: "
@@ -491,14 +524,6 @@ void Viewer::handleInput(float deltaTime)
     m_camera.target += translation;
 }
 
-void Viewer::updateModelPose(size_t i)
-{
-    auto &model = m_models[i];
-    model->resetLocalPose();
-    m_motions[i]->getLocalPose(m_state.progress, model->pose());
-    model->solvePose();
-}
-
 void Viewer::menuBar()
 {
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(6.f, 6.f));
@@ -656,17 +681,75 @@ void Viewer::loadPoseDialog()
     }
 }
 
-void Viewer::updateModels()
+void Viewer::updateModels(float deltaTime)
+{
+    // Per model: motion -> solve before physics -> sync -> solve after
+    // physics -> morph & skin. Physics stepping only has to finish before the
+    // sync stages, so it overlaps with motion evaluation of every model.
+
+    m_frameGraph.clear();
+    m_modelDeformTasks.clear();
+
+    auto physicsTask = m_frameGraph.addTask(
+        [this, deltaTime]
+        {
+            m_profiler.start("Physics");
+            updatePhysics(deltaTime, m_state.physicsSubsteps,
+                          1.f / PHYSICS_FPS[m_state.physicsFPSSelection]);
+            m_profiler.stop("Physics");
+        });
+
+    for (size_t i = 0; i < m_models.size(); ++i)
+    {
+        auto motionTask = m_frameGraph.addTask(
+            [this, i]
+            {
+                m_models[i]->resetLocalPose();
+                m_motions[i]->getLocalPose(m_state.progress,
+                                           m_models[i]->pose());
+            });
+        auto solveTask = m_frameGraph.addTask(
+            [this, i] { m_models[i]->solvePoseBeforePhysics(); });
+        auto syncTask = m_frameGraph.addTask(
+            [this, i]
+            {
+                if (m_physicsCaches[i])
+                    m_models[i]->syncPoseWithPhysicsCache(*m_physicsCaches[i],
+                                                          m_state.progress);
+                else
+                    m_models[i]->syncPoseWithPhysics();
+                m_models[i]->solvePoseAfterPhysics();
+            });
+        m_modelRenderers[i]->beginFrame();
+        auto deformTask = m_frameGraph.addTask(
+            [this, i]
+            {
+                m_modelRenderers[i]->renderData().init();
+                m_models[i]->pose().applyToRenderData(
+                    m_modelRenderers[i]->renderData());
+            });
+
+        m_frameGraph.precede(motionTask, solveTask);
+        m_frameGraph.precede(solveTask, syncTask);
+        m_frameGraph.precede(physicsTask, syncTask);
+        m_frameGraph.precede(syncTask, deformTask);
+
+        m_modelDeformTasks.push_back(deformTask);
+    }
+
+    m_frameGraph.start();
+}
+
+void Viewer::uploadModels()
 {
-    glmmd::parallelForEach(m_models.begin(), m_models.end(),
-                           [&](const auto &model)
-                           {
-                               auto i = &model - m_models.data();
-                               updateModelPose(i);
-                               m_modelRenderers[i]->renderData().init();
-                               m_models[i]->pose().applyToRenderData(
-                                   m_modelRenderers[i]->renderData());
-                           });
+    // Upload each model as soon as it is deformed, in a fixed order, while the
+    // remaining models are still being processed.
+    for (size_t i = 0; i < m_modelRenderers.size(); ++i)
+    {
+        m_frameGraph.wait(m_modelDeformTasks[i]);
+        m_modelRenderers[i]->fillBuffers();
+    }
+    m_frameGraph.wait();
 }
 
 void Viewer::updateCameraMotion()
@@ -698,10 +781,6 @@ void Viewer::updateViewportSize()
 
 void Viewer::render()
 {
-
-    for (const auto &renderer : m_modelRenderers)
-        renderer->fillBuffers();
-
     // Render shadow map
 
     if (m_state.renderShadow)
@@ -762,6 +841,8 @@ void Viewer::resetProgress()
     m_state.startTime = std::chrono::steady_clock::now();
     if (m_state.paused)
         m_state.pauseTime = m_state.startTime;
+
+    seekPhysics(0.f);
 }
 
 float Viewer::getProgress() const
@@ -788,6 +869,102 @@ void Viewer::setProgress(float progress)
         m_state.pauseTime = now;
 
     m_state.progress = progress;
+
+    seekPhysics(progress);
+}
+
+std::vector<glmmd::Model *> Viewer::modelPointers() const
+{
+    std::vector<glmmd::Model *> models;
+    models.reserve(m_models.size());
+    for (const auto &model : m_models)
+        models.push_back(model.get());
+    return models;
+}
+
+void Viewer::setupModelPhysics(glmmd::Model &model,
+                               bool          applyCurrentTransforms)
+{
+    if (m_state.physicsBackend == PHYSICS_BACKEND_PBD)
+        m_pbdWorld.setupModelPhysics(model, applyCurrentTransforms);
+    else
+        m_physicsWorld.setupModelPhysics(model, applyCurrentTransforms);
+}
+
+void Viewer::clearModelPhysics(glmmd::Model &model)
+{
+    if (m_state.physicsBackend == PHYSICS_BACKEND_PBD)
+        m_pbdWorld.clearModelPhysics(model);
+    else
+        m_physicsWorld.clearModelPhysics(model);
+}
+
+void Viewer::updatePhysics(float deltaTime, int maxSubSteps,
+                           float fixedDeltaTime)
+{
+    if (m_state.physicsBackend == PHYSICS_BACKEND_PBD)
+        m_pbdWorld.update(deltaTime, maxSubSteps, fixedDeltaTime);
+    else
+        m_physicsWorld.update(deltaTime, maxSubSteps, fixedDeltaTime);
+}
+
+void Viewer::setPhysicsBackend(int backend)
+{
+    m_physicsWorld.stopThread();
+    m_physicsCheckpoints.clear();
+
+    std::vector<bool> simulated(m_models.size());
+    for (size_t i = 0; i < m_models.size(); ++i)
+    {
+        simulated[i] = !m_models[i]->physics().rigidBodies.empty();
+        clearModelPhysics(*m_models[i]);
+    }
+
+    m_state.physicsBackend = backend;
+    for (size_t i = 0; i < m_models.size(); ++i)
+        if (simulated[i])
+            setupModelPhysics(*m_models[i], true);
+}
+
+void Viewer::recordPhysicsCheckpoint()
+{
+    // Checkpoints save and restore Bullet's state
+    if (!m_state.physicsEnabled || m_state.paused ||
+        m_state.physicsBackend != PHYSICS_BACKEND_BULLET ||
+        m_physicsWorld.threadRunning())
+        return;
+
+    m_physicsCheckpoints.record(m_physicsWorld, modelPointers(),
+                                m_state.progress);
+}
+
+void Viewer::seekPhysics(float progress)
+{
+    if (!m_state.physicsEnabled ||
+        m_state.physicsBackend != PHYSICS_BACKEND_BULLET ||
+        m_physicsWorld.threadRunning())
+        return;
+
+    auto models = modelPointers();
+
+    float time = m_physicsCheckpoints.restore(m_physicsWorld, models, progress);
+    if (time < 0.f)
+        return;
+
+    // Simulate forward from the checkpoint in fixed steps
+    float step = 1.f / PHYSICS_FPS[m_state.physicsFPSSelection];
+    for (; time + step <= progress; time += step)
+    {
+        for (size_t i = 0; i < m_models.size(); ++i)
+        {
+            m_models[i]->resetLocalPose();
+            m_motions[i]->getLocalPose(time, m_models[i]->pose());
+            m_models[i]->solvePoseBeforePhysics();
+            m_models[i]->syncPoseWithPhysics();
+        }
+        m_physicsWorld.update(step, 1, step);
+        m_physicsCheckpoints.record(m_physicsWorld, models, time + step);
+    }
 }
 
 void Viewer::progress()
@@ -823,6 +1000,76 @@ void Viewer::progress()
     ImGui::End();
 }
 
+void Viewer::bakePhysics()
+{
+    if (!m_state.physicsEnabled)
+        return;
+
+    constexpr float frameRate = 30.f;
+
+    float duration = 0.f;
+    for (const auto &motion : m_motions)
+        duration = std::max(duration, motion->duration());
+
+    m_physicsWorld.stopThread();
+
+    // Start from the pose at time 0
+    for (size_t i = 0; i < m_models.size(); ++i)
+    {
+        clearModelPhysics(*m_models[i]);
+        m_models[i]->resetLocalPose();
+        m_motions[i]->getLocalPose(0.f, m_models[i]->pose());
+        m_models[i]->solvePoseBeforePhysics();
+        m_models[i]->solvePoseAfterPhysics();
+        setupModelPhysics(*m_models[i], true);
+
+        m_physicsCaches[i] = std::make_shared<glmmd::PhysicsCache>(
+            m_models[i]->data(), frameRate);
+    }
+
+    float step = 1.f / PHYSICS_FPS[m_state.physicsFPSSelection];
+    auto  frameCount =
+        static_cast<uint32_t>(std::ceil(duration * frameRate)) + 1;
+    for (uint32_t f = 0; f < frameCount; ++f)
+    {
+        for (size_t i = 0; i < m_models.size(); ++i)
+        {
+            m_models[i]->resetLocalPose();
+            m_motions[i]->getLocalPose(f / frameRate, m_models[i]->pose());
+            m_models[i]->solvePoseBeforePhysics();
+        }
+
+        if (f > 0)
+            updatePhysics(1.f / frameRate, m_state.physicsSubsteps, step);
+
+        for (size_t i = 0; i < m_models.size(); ++i)
+        {
+            m_models[i]->syncPoseWithPhysics();
+            m_physicsCaches[i]->record(m_models[i]->pose());
+        }
+    }
+
+    for (size_t i = 0; i < m_models.size(); ++i)
+    {
+        m_physicsCaches[i]->finish();
+        clearModelPhysics(*m_models[i]);
+    }
+    m_physicsCheckpoints.clear();
+}
+
+void Viewer::clearBakedPhysics()
+{
+    for (size_t i = 0; i < m_models.size(); ++i)
+    {
+        if (!m_physicsCaches[i])
+            continue;
+        m_physicsCaches[i].reset();
+        if (m_state.physicsEnabled)
+            setupModelPhysics(*m_models[i], true);
+    }
+    m_physicsCheckpoints.clear();
+}
+
 void Viewer::modelList()
 {
     if (ImGui::BeginListBox("Models"))
@@ -861,6 +1108,9 @@ void Viewer::modelList()
                       m_modelRenderers[m_state.selectedModelIndex - 1]);
             std::swap(m_motions[m_state.selectedModelIndex],
                       m_motions[m_state.selectedModelIndex - 1]);
+            std::swap(m_physicsCaches[m_state.selectedModelIndex],
+                      m_physicsCaches[m_state.selectedModelIndex - 1]);
+            m_physicsCheckpoints.clear();
             --m_state.selectedModelIndex;
         }
         ImGui::SameLine();
@@ -874,6 +1124,9 @@ void Viewer::modelList()
                       m_modelRenderers[m_state.selectedModelIndex + 1]);
             std::swap(m_motions[m_state.selectedModelIndex],
                       m_motions[m_state.selectedModelIndex + 1]);
+            std::swap(m_physicsCaches[m_state.selectedModelIndex],
+                      m_physicsCaches[m_state.selectedModelIndex + 1]);
+            m_physicsCheckpoints.clear();
             ++m_state.selectedModelIndex;
         }
         ImGui::SameLine();
@@ -911,6 +1164,7 @@ void Viewer::modelList()
             {
                 motion->removeMotion(m_state.selectedMotionIndex);
                 m_state.selectedMotionIndex = -1;
+                m_physicsCheckpoints.clear();
             }
             ImGui::SameLine();
             if (ImGui::Button("Up##Motion"))
@@ -966,31 +1220,90 @@ void Viewer::controlPanel()
     {
         if (ImGui::Checkbox("Physics", &m_state.physicsEnabled))
         {
+            m_physicsCheckpoints.clear();
             if (m_state.physicsEnabled)
             {
-                for (auto &model : m_models)
-                    m_physicsWorld.setupModelPhysics(*model, true);
+                for (size_t i = 0; i < m_models.size(); ++i)
+                    if (!m_physicsCaches[i])
+                        setupModelPhysics(*m_models[i], true);
             }
             else
             {
                 for (auto &model : m_models)
-                    m_physicsWorld.clearModelPhysics(*model);
+                    clearModelPhysics(*model);
             }
         }
 
-        ImGui::Combo("Physics FPS", &m_state.physicsFPSSelection,
-                     "60\000120\000240\000");
+        int backend = m_state.physicsBackend;
+        if (ImGui::Combo("Backend", &backend, "Bullet\000PBD\000"))
+            setPhysicsBackend(backend);
+
+        if (m_state.physicsBackend == PHYSICS_BACKEND_PBD)
+        {
+            int substeps = m_pbdWorld.substeps();
+            if (ImGui::InputInt("Solver substeps", &substeps))
+                m_pbdWorld.setSubsteps(substeps);
+        }
+        else
+        {
+            bool perModelWorlds = m_physicsWorld.perModelWorlds();
+            if (ImGui::Checkbox("Per-model worlds", &perModelWorlds))
+                m_physicsWorld.setPerModelWorlds(perModelWorlds);
+
+#ifdef GLMMD_BULLET_MULTITHREADED
+            bool multithreaded = m_physicsWorld.multithreaded();
+            if (ImGui::Checkbox("Multithreaded solver", &multithreaded))
+                m_physicsWorld.setMultithreaded(multithreaded);
+#endif
+
+            int solverIterations = m_physicsWorld.solverIterations();
+            if (ImGui::InputInt("Solver iterations", &solverIterations))
+                m_physicsWorld.setSolverIterations(solverIterations);
+
+            bool physicsThread = m_physicsWorld.threadRunning();
+            if (ImGui::Checkbox("Physics thread", &physicsThread))
+            {
+                if (physicsThread)
+                    m_physicsWorld.startThread(
+                        1.f / PHYSICS_FPS[m_state.physicsFPSSelection],
+                        m_state.physicsSubsteps);
+                else
+                    m_physicsWorld.stopThread();
+            }
+        }
+
+        if (ImGui::Combo("Physics FPS", &m_state.physicsFPSSelection,
+                         "60\000120\000240\000"))
+        {
+            m_physicsCheckpoints.clear();
+            if (m_physicsWorld.threadRunning())
+                m_physicsWorld.startThread(
+                    1.f / PHYSICS_FPS[m_state.physicsFPSSelection],
+                    m_state.physicsSubsteps);
+        }
 
         if (ImGui::InputInt("Substeps", &m_state.physicsSubsteps))
             m_state.physicsSubsteps = std::max(1, m_state.physicsSubsteps);
 
         if (ImGui::SliderFloat3("Gravity", &m_state.gravity.x, -10.f, 10.f))
+        {
             m_physicsWorld.setGravity(m_state.gravity);
+            m_pbdWorld.setGravity(m_state.gravity);
+            m_physicsCheckpoints.clear();
+        }
+
+        if (ImGui::Button("Bake"))
+            bakePhysics();
+        ImGui::SameLine();
+        if (ImGui::Button("Clear baked"))
+            clearBakedPhysics();
 
         if (ImGui::Button("Reset"))
         {
             m_state.gravity = glm::vec3(0.f, -9.8f, 0.f);
             m_physicsWorld.setGravity(m_state.gravity);
+            m_pbdWorld.setGravity(m_state.gravity);
+            m_physicsCheckpoints.clear();
 
             m_state.physicsSubsteps = 10;
         }
@@ -1055,7 +1368,8 @@ void Viewer::profiler()
     ImGui::Begin("Profiler", nullptr, ImGuiWindowFlags_NoMove);
 
     ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
-    ImGui::Text("Physics: %.3f ms", m_profiler.averageTime("Physics"));
+    ImGui::Text("Physics (overlaps model update): %.3f ms",
+                m_profiler.averageTime("Physics"));
     ImGui::Text("Model update: %.3f ms",
                 m_profiler.averageTime("Model update"));
     ImGui::Text("Render: %.3f ms", m_profiler.averageTime("Render"));
@@ -1068,7 +1382,8 @@ void Viewer::run()
 {
     auto &io = ImGui::GetIO();
 
-    m_profiler.add("Physics");
+    // Physics is stepped on a task running during "Model update"
+    m_profiler.add("Physics", false);
     m_profiler.add("Model update");
     m_profiler.add("Render");
 
@@ -1094,18 +1409,11 @@ void Viewer::run()
 
         m_profiler.startFrame();
 
-        {
-            m_profiler.start("Physics");
-            const int physicsFPS[3]{60, 120, 240};
-            m_physicsWorld.update(deltaTime, m_state.physicsSubsteps,
-                                  1.f /
-                                      physicsFPS[m_state.physicsFPSSelection]);
-            m_profiler.stop("Physics");
-        }
-
         {
             m_profiler.start("Model update");
-            updateModels();
+            updateModels(deltaTime);
+            uploadModels();
+            recordPhysicsCheckpoint();
             m_profiler.stop("Model update");
         }
 
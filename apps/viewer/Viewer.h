@@ -11,7 +11,11 @@
 
 #include <glmmd/core/CameraMotion.h>
 #include <glmmd/core/Model.h>
+#include <glmmd/core/PbdWorld.h>
+#include <glmmd/core/PhysicsCheckpoints.h>
 #include <glmmd/core/PhysicsWorld.h>
+#include <glmmd/core/TaskGraph.h>
+#include <glmmd/core/ThreadPool.h>
 
 #include "BlendedMotion.h"
 #include "InfiniteGridRenderer.h"
@@ -30,6 +34,7 @@ public:
     void run();
 
 private:
+    void initThreadPool();
     void initWindow();
     void initImGui();
     void initFBO();
@@ -42,8 +47,6 @@ private:
                     const JsonNode &config = JsonObj_t{});
     void loadPose(const std::filesystem::path &path, size_t modelIndex);
 
-    void updateModelPose(size_t i);
-
     void handleInput(float deltaTime);
 
     void initState();
@@ -56,7 +59,8 @@ private:
     void loadModelDialog();
     void loadMotionDialog();
     void loadPoseDialog();
-    void updateModels();
+    void updateModels(float deltaTime);
+    void uploadModels();
     void updateCameraMotion();
     void updateViewportSize();
     void render();
@@ -72,6 +76,20 @@ private:
     float getProgress() const;
     void  setProgress(float progress);
 
+    std::vector<glmmd::Model *> modelPointers() const;
+
+    // Dispatch to the selected physics backend
+    void setupModelPhysics(glmmd::Model &model, bool applyCurrentTransforms);
+    void clearModelPhysics(glmmd::Model &model);
+    void updatePhysics(float deltaTime, int maxSubSteps, float fixedDeltaTime);
+    void setPhysicsBackend(int backend);
+
+    void recordPhysicsCheckpoint();
+    void seekPhysics(float progress);
+
+    void bakePhysics();
+    void clearBakedPhysics();
+
 private:
     std::filesystem::path m_executableDir;
     JsonNode              m_initData;
@@ -88,6 +106,9 @@ private:
     std::vector<std::unique_ptr<ModelRenderer>> m_modelRenderers;
     std::vector<std::unique_ptr<BlendedMotion>> m_motions;
 
+    // Baked physics per model, played back instead of simulating
+    std::vector<std::shared_ptr<glmmd::PhysicsCache>> m_physicsCaches;
+
     std::unique_ptr<glmmd::CameraMotion> m_cameraMotion;
 
     std::unique_ptr<InfiniteGridRenderer> m_gridRenderer;
@@ -95,7 +116,12 @@ private:
     glmmd::Camera           m_camera;
     glmmd::DirectionalLight m_mainDirectionalLight;
 
-    glmmd::PhysicsWorld m_physicsWorld;
+    glmmd::PhysicsWorld       m_physicsWorld;
+    glmmd::PbdWorld           m_pbdWorld;
+    glmmd::PhysicsCheckpoints m_physicsCheckpoints;
+
+    glmmd::TaskGraph                      m_frameGraph;
+    std::vector<glmmd::TaskGraph::TaskId> m_modelDeformTasks;
 
     ogl::FrameBufferObject m_FBO;
     ogl::FrameBufferObject m_intermediateFBO;
@@ -118,6 +144,7 @@ private:
         float                                              progress;
 
         bool physicsEnabled;
+        int  physicsBackend;
         int  physicsFPSSelection;
         int  physicsSubsteps;
 
@@ -7,6 +7,7 @@
 #include <glmmd/core/ModelPhysics.h>
 #include <glmmd/core/ModelPose.h>
 #include <glmmd/core/ModelPoseSolver.h>
+#include <glmmd/core/PhysicsCache.h>
 
 namespace glmmd
 {
@@ -46,10 +47,23 @@ public:
 
     void solvePose()
     {
-        m_poseSolver.solveBeforePhysics(m_pose);
+        solvePoseBeforePhysics();
+        syncPoseWithPhysics();
+        solvePoseAfterPhysics();
+    }
+
+    void solvePoseBeforePhysics() { m_poseSolver.solveBeforePhysics(m_pose); }
+    void syncPoseWithPhysics()
+    {
         m_poseSolver.syncWithPhysics(m_pose, m_physics);
-        m_poseSolver.solveAfterPhysics(m_pose);
     }
+    // Replaces syncPoseWithPhysics() when playing back baked physics
+    void syncPoseWithPhysicsCache(const PhysicsCache &cache, float time)
+    {
+        cache.apply(time, m_pose);
+        m_poseSolver.solveBonesBelowPhysics(m_pose);
+    }
+    void solvePoseAfterPhysics() { m_poseSolver.solveAfterPhysics(m_pose); }
 
 private:
     std::shared_ptr<ModelData> m_data;
@@ -4,12 +4,18 @@
 #include <array>
 #include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <span>
 #include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <glmmd/core/NameIndex.h>
+
 namespace glmmd
 {
 
@@ -63,6 +69,32 @@ struct Vertex
     float edgeScale;
 };
 
+// The vertex data skinning reads, split into one stream per field and packed:
+// 4 bone indices per vertex, 16 bit if all bones fit, and 4 unorm16 weights.
+// SDEF parameters are kept for SDEF vertices only.
+struct SkinningData
+{
+    struct Sdef
+    {
+        uint32_t  vertex;
+        glm::vec3 c;
+        glm::vec3 r; // (r0 - r1) / 2
+    };
+
+    // Positions are read from the render data, which morphs move
+    std::vector<glm::vec3> normals;
+
+    std::vector<VertexSkinningType> types;
+    std::vector<uint16_t>           boneIndices16; // either one is filled
+    std::vector<uint32_t>           boneIndices32;
+    std::vector<uint16_t>           boneWeights;
+    std::vector<Sdef>               sdef; // sorted by vertex
+
+    size_t vertexCount() const { return types.size(); }
+
+    static float unpackWeight(uint16_t w) { return w * (1.f / 65535.f); }
+};
+
 struct Texture
 {
     std::string           rawPath;
@@ -71,8 +103,8 @@ struct Texture
 
 struct Material
 {
-    std::string name;
-    std::string nameEN;
+    std::pmr::string name;
+    std::pmr::string nameEN;
 
     glm::vec4 diffuse;
     glm::vec3 specular;
@@ -101,8 +133,8 @@ struct Material
     uint8_t sharedToonFlag; // 0 do not use, 1: use shared toon
     int32_t toonTextureIndex;
 
-    std::string memo;
-    int32_t     indicesCount;
+    std::pmr::string memo;
+    int32_t          indicesCount;
 };
 
 struct IKLink
@@ -121,13 +153,13 @@ struct IKData
     int32_t loopCount;
     float   limitAngle; // rad
 
-    std::vector<IKLink> links;
+    std::pmr::vector<IKLink> links;
 };
 
 struct Bone
 {
-    std::string name;
-    std::string nameEN;
+    std::pmr::string name;
+    std::pmr::string nameEN;
 
     glm::vec3 position;
 
@@ -207,7 +239,7 @@ struct VertexMorph
 struct UVMorph
 {
     int32_t   index;
-    glm::vec4 offset[5];
+    glm::vec4 offset; // of the UV set given by the morph type
 };
 
 struct BoneMorph
@@ -234,97 +266,21 @@ struct MaterialMorph
 
 struct Morph
 {
-    std::string name;
-    std::string nameEN;
+    std::pmr::string name;
+    std::pmr::string nameEN;
 
     uint8_t   panel;
     MorphType type;
 
-    union
-    {
-        GroupMorph    *group;
-        VertexMorph   *vertex;
-        UVMorph       *uv;
-        BoneMorph     *bone;
-        MaterialMorph *material;
-    };
-    int32_t count;
-
-    void init()
-    {
-        constexpr size_t dataSize[]{
-            sizeof(GroupMorph), sizeof(VertexMorph), sizeof(BoneMorph),
-            sizeof(UVMorph),    sizeof(UVMorph),     sizeof(UVMorph),
-            sizeof(UVMorph),    sizeof(UVMorph),     sizeof(MaterialMorph)};
-        m_buffer.resize((dataSize[static_cast<uint8_t>(type)] * count +
-                         sizeof(AlignedStorageType) - 1) /
-                        sizeof(AlignedStorageType));
-        if (!m_buffer.empty())
-        {
-            switch (type)
-            {
-            case MorphType::Group:
-                group = std::launder(reinterpret_cast<GroupMorph *>(data()));
-                break;
-            case MorphType::Vertex:
-                vertex = std::launder(reinterpret_cast<VertexMorph *>(data()));
-                break;
-            case MorphType::Bone:
-                bone = std::launder(reinterpret_cast<BoneMorph *>(data()));
-                break;
-            case MorphType::UV:
-            case MorphType::UV1:
-            case MorphType::UV2:
-            case MorphType::UV3:
-            case MorphType::UV4:
-                uv = std::launder(reinterpret_cast<UVMorph *>(data()));
-                break;
-            case MorphType::Material:
-                material =
-                    std::launder(reinterpret_cast<MaterialMorph *>(data()));
-                break;
-            }
-        }
-    }
-
-private:
-    char *data() { return m_buffer.empty() ? nullptr : m_buffer[0].data; }
-
-private:
-    template <size_t... N>
-    struct Max;
-    template <size_t N>
-    struct Max<N>
-    {
-        static constexpr size_t value = N;
-    };
-    template <size_t N, size_t... Rest>
-    struct Max<N, Rest...>
-    {
-        static constexpr size_t value =
-            N > Max<Rest...>::value ? N : Max<Rest...>::value;
-    };
-    template <typename... Types>
-    struct AlignedStorage
-    {
-        static constexpr size_t value = Max<alignof(Types)...>::value;
-        struct type
-        {
-            alignas(value) char data[Max<sizeof(Types)...>::value];
-        };
-    };
-
-    using AlignedStorageType =
-        typename AlignedStorage<GroupMorph, VertexMorph, BoneMorph, UVMorph,
-                                MaterialMorph>::type;
-    std::vector<AlignedStorageType>
-        m_buffer; // aligned allocation guaranteed after C++17
+    // Elements are ModelData::morphPools.<kind>[offset, offset + count)
+    uint32_t offset;
+    int32_t  count;
 };
 
 struct DisplayFrame
 {
-    std::string name;
-    std::string nameEN;
+    std::pmr::string name;
+    std::pmr::string nameEN;
 
     uint8_t specialFlag;
 
@@ -333,7 +289,7 @@ struct DisplayFrame
         uint8_t type; // 0: bone, 1: morph
         int32_t index;
     };
-    std::vector<Element> elements;
+    std::pmr::vector<Element> elements;
 };
 
 enum class RigidBodyShape : uint8_t
@@ -352,8 +308,8 @@ enum class PhysicsCalcType : uint8_t
 
 struct RigidBody
 {
-    std::string name;
-    std::string nameEN;
+    std::pmr::string name;
+    std::pmr::string nameEN;
 
     int32_t boneIndex;
 
@@ -393,8 +349,8 @@ enum class JointType : uint8_t
 
 struct Joint
 {
-    std::string name;
-    std::string nameEN;
+    std::pmr::string name;
+    std::pmr::string nameEN;
 
     JointType type;
     int32_t   rigidBodyIndexA;
@@ -411,8 +367,47 @@ struct Joint
 
 using AdditionalUV = std::array<glm::vec4, 4>;
 
+// Elements of all morphs, one pool per kind in morph order. UV and
+// additional UV morphs share a pool.
+struct MorphPools
+{
+    std::vector<GroupMorph>    group;
+    std::vector<VertexMorph>   vertex;
+    std::vector<UVMorph>       uv;
+    std::vector<BoneMorph>     bone;
+    std::vector<MaterialMorph> material;
+};
+
 struct ModelData
 {
+    ModelData()             = default;
+    ModelData(ModelData &&) = default;
+
+    // Elements keep allocating from the arena of the model they were
+    // created in, so models can be moved but not assigned
+    ModelData &operator=(ModelData &&) = delete;
+
+    // Names, memos, IK links and display frame elements of the elements
+    // below allocate from here when created with it. Released at once with
+    // the model.
+    std::pmr::memory_resource *arena() const { return m_arena.get(); }
+
+private:
+    // Declared first to outlive everything allocated from it
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> m_arena =
+        std::make_unique<std::pmr::monotonic_buffer_resource>();
+
+    struct RestVertexCache
+    {
+        std::mutex                                mutex;
+        std::shared_ptr<const std::vector<float>> buffer;
+        std::shared_ptr<const std::vector<float>> positionNormals;
+        std::shared_ptr<const std::vector<float>> positionOctNormals;
+    };
+    std::unique_ptr<RestVertexCache> m_restVertices =
+        std::make_unique<RestVertexCache>();
+
+public:
     ModelInfo info;
 
     std::vector<Vertex>       vertices;
@@ -423,11 +418,82 @@ struct ModelData
     std::vector<IKData>       ikData;
     std::vector<Bone>         bones;
     std::vector<Morph>        morphs;
+    MorphPools                morphPools;
     std::vector<DisplayFrame> displayFrames;
     std::vector<RigidBody>    rigidBodies;
     std::vector<Joint>        joints;
 
+    // Built from vertices by updateSkinningData(), which loaders call.
+    // Call it again after editing vertices or bones.
+    SkinningData skinning;
+
+    // Built by updateNameIndices(), which loaders call. Callers must call it
+    // again after adding, removing, reordering or renaming bones, morphs or
+    // materials, the indices do not notice such edits.
+    NameIndex boneNames;
+    NameIndex morphNames;
+    NameIndex materialNames;
+
     void validateIndexByteSizes();
+    void updateSkinningData();
+    void updateNameIndices();
+
+    // NameIndex::NOT_FOUND if there is no such element. The results are
+    // only valid while the name indices are up to date.
+    uint32_t findBone(std::string_view name) const;
+    uint32_t findMorph(std::string_view name) const;
+    uint32_t findMaterial(std::string_view name) const;
+
+    // The rest mesh interleaved as position, normal, uv and additional uvs,
+    // which render data starts every frame from. Built once and shared by
+    // all users. updateSkinningData() drops it, so buffers handed out
+    // before keep the old vertices.
+    std::shared_ptr<const std::vector<float>> restVertexBuffer() const;
+    size_t restVertexStride() const { return 8 + 4 * info.additionalUVNum; }
+
+    // Only positions and normals of the rest mesh, 6 floats per vertex. With
+    // octNormals 4, the normal packed by packOctNormal() into the last one.
+    std::shared_ptr<const std::vector<float>>
+    restPositionNormalBuffer(bool octNormals = false) const;
+
+    // Append a default element whose names and lists allocate from arena()
+    Material     &addMaterial();
+    IKData       &addIKData();
+    Bone         &addBone();
+    Morph        &addMorph();
+    DisplayFrame &addDisplayFrame();
+    RigidBody    &addRigidBody();
+    Joint        &addJoint();
+
+    // Appends morph.count elements to the pool of morph.type and sets
+    // morph.offset to the first one
+    void allocateMorphElements(Morph &morph);
+
+    std::span<const GroupMorph> groupMorphs(const Morph &morph) const
+    {
+        return {morphPools.group.data() + morph.offset,
+                static_cast<size_t>(morph.count)};
+    }
+    std::span<const VertexMorph> vertexMorphs(const Morph &morph) const
+    {
+        return {morphPools.vertex.data() + morph.offset,
+                static_cast<size_t>(morph.count)};
+    }
+    std::span<const UVMorph> uvMorphs(const Morph &morph) const
+    {
+        return {morphPools.uv.data() + morph.offset,
+                static_cast<size_t>(morph.count)};
+    }
+    std::span<const BoneMorph> boneMorphs(const Morph &morph) const
+    {
+        return {morphPools.bone.data() + morph.offset,
+                static_cast<size_t>(morph.count)};
+    }
+    std::span<const MaterialMorph> materialMorphs(const Morph &morph) const
+    {
+        return {morphPools.material.data() + morph.offset,
+                static_cast<size_t>(morph.count)};
+    }
 };
 
 } // namespace glmmd
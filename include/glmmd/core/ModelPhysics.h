@@ -4,12 +4,11 @@
 #include <vector>
 
 #ifndef GLMMD_DONT_USE_BULLET
-#include <btBulletCollisionCommon.h>
-#include <btBulletDynamicsCommon.h>
 #include <memory>
 #endif
 
 #include <glmmd/core/ModelPose.h>
+#include <glmmd/core/PhysicsTemplate.h>
 #include <glmmd/core/Transform.h>
 
 namespace glmmd
@@ -20,24 +19,48 @@ struct RigidBodyData
     Transform offset;
 
 #ifndef GLMMD_DONT_USE_BULLET
-    std::unique_ptr<btCollisionShape>     shape;
-    std::unique_ptr<btDefaultMotionState> motionState;
-    std::unique_ptr<btRigidBody>          rigidBody;
+    // Owned by the physics template and ModelPhysics::instance
+    btCollisionShape     *shape       = nullptr;
+    btDefaultMotionState *motionState = nullptr;
+    btRigidBody          *rigidBody   = nullptr;
+
+    // Kinematic target of the last update the model was awake in
+    btTransform awakeTarget = btTransform::getIdentity();
 #endif
 };
 
 #ifndef GLMMD_DONT_USE_BULLET
-using JointData = std::unique_ptr<btGeneric6DofSpringConstraint>;
+using JointData = btGeneric6DofSpringConstraint *;
 #else
 struct JointData
 {
 };
 #endif
 
+struct RigidBodyState
+{
+    Transform transform;
+    glm::vec3 linearVelocity;
+    glm::vec3 angularVelocity;
+};
+
+// Simulation state of all rigid bodies of a model. Joints carry no state of
+// their own beyond the bodies they connect.
+using ModelPhysicsState = std::vector<RigidBodyState>;
+
 struct ModelPhysics
 {
     std::vector<RigidBodyData> rigidBodies;
     std::vector<JointData>     joints;
+
+    // World transforms of the rigid bodies. The pose solver writes the ones
+    // of static bodies as kinematic targets and reads the others, the
+    // physics world exchanges them with the simulation.
+    std::vector<Transform> bodyTransforms;
+
+#ifndef GLMMD_DONT_USE_BULLET
+    std::unique_ptr<PhysicsInstance> instance;
+#endif
 };
 
 }; // namespace glmmd
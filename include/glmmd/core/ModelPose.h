@@ -17,6 +17,7 @@ namespace glmmd
 class ModelPose
 {
     friend class ModelPoseSolver;
+    friend class PhysicsCache;
 
 public:
     ModelPose() = default;
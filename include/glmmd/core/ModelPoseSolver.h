@@ -25,30 +25,38 @@ public:
     void syncWithPhysics(ModelPose &pose, ModelPhysics &physics) const;
     void solveAfterPhysics(ModelPose &pose) const;
 
+    // Moves bones below dynamic and mixed rigid bodies along with them, as
+    // syncWithPhysics() does, after their bones were set otherwise
+    void solveBonesBelowPhysics(ModelPose &pose) const;
+
 private:
     void sortBoneDeformOrder();
+    void createPhysicsSync();
 
     void applyGroupMorphs(ModelPose &) const;
     void applyBoneMorphs(ModelPose &) const;
 
+    void solveGlobalBoneTransform(ModelPose &, uint32_t boneIndex) const;
     bool solveChildGlobalBoneTransforms(ModelPose &, uint32_t boneIndex,
                                         int32_t stop = -1) const;
     void solveGlobalBoneTransforms(ModelPose &, uint32_t, uint32_t) const;
     void solveIK(ModelPose &, uint32_t, uint32_t) const;
     void updateInheritedBoneTransforms(ModelPose &, uint32_t, uint32_t) const;
 
-    void syncStaticRigidBodyTransforms(const ModelPose     &pose,
-                                       const RigidBodyData &rb,
-                                       int32_t              bi) const;
-
-    void syncDynamicRigidBodyTransforms(ModelPose           &pose,
-                                        const RigidBodyData &rb,
-                                        int32_t              bi) const;
-
-    void syncMixedRigidBodyTransforms(ModelPose &pose, const RigidBodyData &rb,
-                                      int32_t bi) const;
-
 private:
+    static constexpr uint32_t NO_BODY = ~0u;
+
+    // Rigid body sync, precompiled per physics type. Static bodies are placed
+    // at offset * bone, dynamic bodies place their bone at offset * body.
+    // Mixed bodies turn their bone to body.rotation * offset.rotation and are
+    // moved to bone * offset.translation.
+    struct BodySync
+    {
+        uint32_t  body;
+        uint32_t  bone;
+        Transform offset;
+    };
+
     std::shared_ptr<const ModelData> m_modelData;
 
     std::vector<std::pair<uint32_t, uint32_t>> m_updateBeforePhysicsRanges;
@@ -56,6 +64,12 @@ private:
 
     std::vector<std::vector<uint32_t>> m_boneChildren;
     std::vector<uint32_t>              m_boneDeformOrder;
+
+    std::vector<BodySync> m_staticBodySync;
+    std::vector<BodySync> m_dynamicBodySync;
+    // Mixed bodies and the bones below dynamic or mixed bodies (body is
+    // NO_BODY), in deform order. Solved in one sweep after dynamic bodies.
+    std::vector<BodySync> m_physicsSweep;
 };
 
 } // namespace glmmd
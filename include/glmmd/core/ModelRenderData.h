@@ -38,16 +38,41 @@ struct MaterialRenderData
     float     edgeSize;
 };
 
+enum class VertexLayout : uint8_t
+{
+    Interleaved, // everything in vertexBuffer
+    Streams,     // position and normal in vertexBuffer, UVs in uvBuffer
+    // Streams with the normal packed by packOctNormal() and UVs as half
+    // floats (glm::packHalf2x16), stored bitwise in the float buffers.
+    // A vertex takes 4 floats of vertexBuffer and 1 + 2 * additionalUVNum
+    // floats of uvBuffer.
+    CompactStreams,
+};
+
 struct ModelRenderData
 {
     ModelRenderData() = default;
 
-    ModelRenderData(const std::shared_ptr<const ModelData> &data);
+    ModelRenderData(const std::shared_ptr<const ModelData> &data,
+                    VertexLayout layout = VertexLayout::Interleaved);
 
-    void create(const std::shared_ptr<const ModelData> &data);
+    void create(const std::shared_ptr<const ModelData> &data,
+                VertexLayout layout = VertexLayout::Interleaved);
 
+    // Resets vertexBuffer and the materials to the rest state. The UV stream
+    // is left alone, see beginUVMorphs().
     void init();
 
+    // Called before UV morphs are applied. The UV stream is reset, and
+    // uvVersion advanced, only if UV morphs are active now or were last time.
+    void beginUVMorphs(bool active);
+
+    // Called before material morphs are applied. Advances materialVersion
+    // if material morphs are active now or were last time.
+    void beginMaterialMorphs(bool active);
+
+    VertexLayout layout() const { return m_layout; }
+
     void applyMaterialFactors();
 
     glm::vec3 getVertexPosition(size_t index) const;
@@ -61,16 +86,56 @@ struct ModelRenderData
     void setVertexAdditionalUV(size_t index, size_t uvIndex,
                                const glm::vec4 &additionalUV);
 
+    // Skinning reads vertexBuffer and writes the skinned vertices to the
+    // skinning target, vertexBuffer unless set. Any other target, such as
+    // mapped GPU memory, takes vertexBuffer.size() floats and is only written
+    // to, vertexBuffer keeps the unskinned vertices. Stream layouts only.
+    void   setSkinningTarget(float *target);
+    float *skinningTarget();
+
+    // Vertex index of target, laid out as in vertexBuffer
+    void writeSkinnedVertex(float *target, size_t index,
+                            const glm::vec3 &position,
+                            const glm::vec3 &normal) const;
+
     size_t stride;
 
     std::vector<float> vertexBuffer;
 
+    // Stream layouts only: UV and additional UVs, uvStride floats per
+    // vertex. uvVersion changes whenever uvBuffer does.
+    size_t             uvStride;
+    std::vector<float> uvBuffer;
+    uint32_t           uvVersion = 0;
+
+    // Rest values and factors are reset by init(), the others only change
+    // when materialVersion does
     std::vector<MaterialRenderData> materials;
+    uint32_t                        materialVersion = 0;
+
+private:
+    float       *uvData();
+    const float *uvData() const;
+
+    void resetUVs(); // only the vertices UV morphs move
+    void resetVertexUVs(size_t index);
 
 private:
     std::shared_ptr<const ModelData> m_data;
 
-    std::vector<float> m_initialVertexBuffer;
+    VertexLayout m_layout           = VertexLayout::Interleaved;
+    bool         m_uvsMorphed       = false;
+    bool         m_materialsMorphed = false;
+    float       *m_skinningTarget   = nullptr;
+
+    // Shared by all render data of the model. With stream layouts
+    // vertexBuffer starts from m_initialPositionNormals, the UV stream from
+    // m_initialVertexBuffer.
+    std::shared_ptr<const std::vector<float>> m_initialVertexBuffer;
+    std::shared_ptr<const std::vector<float>> m_initialPositionNormals;
+
+    std::vector<uint32_t> m_uvMorphVertices; // sorted
+    std::vector<float>    m_uvMorphRestUVs;  // of those, as in uvBuffer
 };
 
 } // namespace glmmd
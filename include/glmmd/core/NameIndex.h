@@ -0,0 +1,55 @@
+#ifndef GLMMD_CORE_NAME_INDEX_H_
+#define GLMMD_CORE_NAME_INDEX_H_
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace glmmd
+{
+
+// Immutable name -> index map over a minimal perfect hash (hash and
+// displace). Keys are interned in one character buffer. A lookup hashes the
+// name once, reads one displacement and compares one key, and never
+// allocates.
+class NameIndex
+{
+public:
+    static constexpr uint32_t NOT_FOUND = ~0u;
+
+    NameIndex() = default;
+
+    // Element i is called names[i]. Of equal names the first one is found.
+    explicit NameIndex(std::span<const std::string_view> names);
+
+    uint32_t find(std::string_view name) const;
+
+    // Number of elements the index was built from
+    size_t elementCount() const { return m_elementCount; }
+
+private:
+    struct Key
+    {
+        uint32_t offset;
+        uint32_t length;
+        uint32_t index;
+    };
+
+    bool build(const std::vector<Key> &keys, uint64_t salt);
+
+    uint64_t hash(std::string_view name) const;
+
+private:
+    std::string           m_chars;
+    std::vector<uint32_t> m_displacements; // per bucket
+    std::vector<Key>      m_slots;
+
+    uint64_t m_salt         = 0;
+    size_t   m_elementCount = 0;
+};
+
+} // namespace glmmd
+
+#endif
@@ -1,33 +1,71 @@
 #ifndef GLMMD_PARALLEL_FOR_EACH_H_
 #define GLMMD_PARALLEL_FOR_EACH_H_
 
+#include <algorithm>
+#include <iterator>
+
 #ifndef GLMMD_DONT_PARALLELIZE
 #ifdef GLMMD_USE_TBB
-#include <tbb/parallel_for_each.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #else
-#include <algorithm>
-#include <execution>
+#include <glmmd/core/ThreadPool.h>
 #endif
 #endif
 
 namespace glmmd
 {
 
-template <typename Iter, typename Func>
-void parallelForEach(Iter first, Iter last, Func &&func)
+inline size_t parallelDefaultGrain(size_t count)
 {
+#if !defined(GLMMD_DONT_PARALLELIZE) && !defined(GLMMD_USE_TBB)
+    return ThreadPool::global().defaultGrain(count);
+#else
+    return std::max<size_t>(1, count / 64);
+#endif
+}
 
+// func(begin, end) on disjoint chunks of at most `grain` indices
+template <typename Func>
+void parallelForChunked(size_t first, size_t last, size_t grain, Func &&func)
+{
 #ifndef GLMMD_DONT_PARALLELIZE
 #ifdef GLMMD_USE_TBB
-    tbb::parallel_for_each(first, last, func);
+    tbb::parallel_for(tbb::blocked_range<size_t>(first, last,
+                                                 std::max<size_t>(grain, 1)),
+                      [&](const tbb::blocked_range<size_t> &range)
+                      { func(range.begin(), range.end()); });
 #else
-    std::for_each(std::execution::par, first, last, func);
+    ThreadPool::global().parallelForChunked(first, last, grain,
+                                            std::forward<Func>(func));
 #endif
 #else
-    std::for_each(first, last, func);
+    grain = std::max<size_t>(grain, 1);
+    for (; first < last; first += std::min(grain, last - first))
+        func(first, first + std::min(grain, last - first));
 #endif
 }
 
+// func(i) for each i in [first, last), scheduled in chunks of `grain`
+template <typename Func>
+void parallelFor(size_t first, size_t last, size_t grain, Func &&func)
+{
+    parallelForChunked(first, last, grain,
+                       [&func](size_t begin, size_t end)
+                       {
+                           for (; begin != end; ++begin)
+                               func(begin);
+                       });
+}
+
+template <typename Iter, typename Func>
+void parallelForEach(Iter first, Iter last, Func &&func)
+{
+    auto count = static_cast<size_t>(std::distance(first, last));
+    parallelFor(0, count, parallelDefaultGrain(count),
+                [&](size_t i) { func(first[i]); });
+}
+
 } // namespace glmmd
 
 #endif
@@ -0,0 +1,81 @@
+#ifndef GLMMD_CORE_PBD_WORLD_H_
+#define GLMMD_CORE_PBD_WORLD_H_
+
+#include <memory>
+#include <vector>
+
+#include <glmmd/core/Model.h>
+
+namespace glmmd
+{
+
+// Built-in physics backend for MMD spring chains, independent of Bullet.
+// Rigid bodies are simulated with position based dynamics (XPBD) and small
+// substeps, joints are solved as 6DOF springs with limits. Bodies of
+// different models never collide, models are stepped in parallel.
+//
+// Spheres and capsules collide exactly, boxes as the capsule along their
+// longest axis. Bodies connected by a joint do not collide with each other,
+// there is no friction or restitution.
+//
+// The joints of a model are colored so that joints of one color share no
+// dynamic body, and joints of one color are solved together in float lanes,
+// one component array per field. Contacts are solved one at a time.
+class PbdWorld
+{
+public:
+    PbdWorld();
+    ~PbdWorld();
+
+    PbdWorld(const PbdWorld &)            = delete;
+    PbdWorld &operator=(const PbdWorld &) = delete;
+
+    // Models must not be moved while their physics is set up, and must not
+    // be set up in a PhysicsWorld at the same time.
+    void setupModelPhysics(Model &model, bool applyCurrentTransforms = false);
+
+    void clearModelPhysics(Model &model);
+
+    // Exchanges ModelPhysics::bodyTransforms with the simulation, like
+    // PhysicsWorld::update().
+    void update(float deltaTime, int maxSubSteps = 10,
+                float fixedDeltaTime = 1.f / 60.f);
+
+    void setGravity(const glm::vec3 &gravity);
+
+    // Solver substeps per fixed step, each runs one constraint iteration
+    void setSubsteps(int substeps);
+    int  substeps() const { return m_substeps; }
+
+    // Picks the substeps of every model between 1 and substeps() from its
+    // joint separations and body velocities. Refines at once, coarsens one
+    // substep per update.
+    void setAdaptiveSubsteps(bool enabled);
+    bool adaptiveSubsteps() const { return m_adaptiveSubsteps; }
+
+    // Models whose bodies have been at rest for a while, with their
+    // kinematic bodies in place, are no longer stepped until a kinematic
+    // body moves.
+    void setDeactivation(bool enabled);
+    bool deactivation() const { return m_deactivation; }
+
+    bool isSleeping(const Model &model) const;
+
+    size_t modelCount() const { return m_models.size(); }
+
+private:
+    struct ModelState;
+
+private:
+    std::vector<std::unique_ptr<ModelState>> m_models;
+
+    glm::vec3 m_gravity;
+    int       m_substeps         = 8;
+    bool      m_adaptiveSubsteps = false;
+    bool      m_deactivation     = false;
+    float     m_timeAccum        = 0.f;
+};
+
+} // namespace glmmd
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef GLMMD_CORE_PHYSICS_CACHE_H_
+#define GLMMD_CORE_PHYSICS_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glmmd/core/ModelData.h>
+#include <glmmd/core/ModelPose.h>
+
+namespace glmmd
+{
+
+// Baked physics: global transforms of the bones driven by dynamic and mixed
+// rigid bodies, recorded after syncing with physics once per frame and
+// quantized to 12 bytes per bone and frame. Playback writes them into a pose
+// in place of syncing with a physics world, any frame can be sampled
+// independently.
+class PhysicsCache
+{
+public:
+    // Translation = origin + scale * quantized value
+    struct BoneRange
+    {
+        glm::vec3 origin;
+        glm::vec3 scale;
+    };
+
+    // Translation quantized to the bone's range. Rotation stored as the
+    // three smallest components with 15 bits each, the index of the largest
+    // one in the top bits of the first two.
+    struct Sample
+    {
+        uint16_t translation[3];
+        uint16_t rotation[3];
+    };
+
+    PhysicsCache() = default;
+    explicit PhysicsCache(const ModelData &modelData, float frameRate = 30.f);
+    PhysicsCache(float frameRate, std::vector<uint32_t> bones,
+                 std::vector<std::string> boneNames,
+                 std::vector<BoneRange> ranges, std::vector<Sample> samples);
+
+    // Appends a frame at full precision, call after syncing with physics.
+    void record(const ModelPose &pose);
+    // Quantizes the recorded frames, must be called before playback.
+    void finish();
+
+    // Sets the cached bones' global transforms at `time`, interpolating
+    // between frames. Call in place of syncing with physics. Throws if the
+    // cache does not match the pose's model.
+    void apply(float time, ModelPose &pose) const;
+
+    // Whether the cached bones have the same indices and names in modelData
+    bool matches(const ModelData &modelData) const;
+
+    float    frameRate() const { return m_frameRate; }
+    uint32_t frameCount() const { return m_frameCount; }
+    float    duration() const;
+
+    const std::vector<uint32_t>    &bones() const { return m_bones; }
+    const std::vector<std::string> &boneNames() const { return m_boneNames; }
+    const std::vector<BoneRange>   &ranges() const { return m_ranges; }
+    const std::vector<Sample>      &samples() const { return m_samples; }
+
+private:
+    Transform decode(uint32_t frame, size_t boneIndex) const;
+
+private:
+    float    m_frameRate  = 30.f;
+    uint32_t m_frameCount = 0;
+
+    std::vector<uint32_t>    m_bones;
+    std::vector<std::string> m_boneNames;
+    std::vector<BoneRange>   m_ranges;
+    std::vector<Sample>      m_samples; // frame major
+
+    std::vector<Transform> m_recorded;
+};
+
+} // namespace glmmd
+
+#endif
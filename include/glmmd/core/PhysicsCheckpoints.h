@@ -0,0 +1,62 @@
+#ifndef GLMMD_CORE_PHYSICS_CHECKPOINTS_H_
+#define GLMMD_CORE_PHYSICS_CHECKPOINTS_H_
+
+#ifndef GLMMD_DONT_USE_BULLET
+
+#include <span>
+#include <vector>
+
+#include <glmmd/core/PhysicsWorld.h>
+
+namespace glmmd
+{
+
+// Physics states of a fixed set of models recorded at regular playback times.
+// Seeking restores the latest checkpoint before the target, so only the rest
+// of one interval has to be simulated. When the memory limit is exceeded,
+// every other checkpoint is dropped and the interval doubles.
+class PhysicsCheckpoints
+{
+public:
+    explicit PhysicsCheckpoints(float  interval    = 1.f,
+                                size_t memoryLimit = 32u << 20);
+
+    // Stores a checkpoint unless one exists in the interval containing
+    // `time`. Call after stepping and syncing the frame at `time`.
+    void record(const PhysicsWorld &world, std::span<Model *const> models,
+                float time);
+
+    // Restores the latest checkpoint not after `time`, returns its time or
+    // a negative value if there is none.
+    float restore(PhysicsWorld &world, std::span<Model *const> models,
+                  float time) const;
+
+    void clear();
+
+    float  interval() const { return m_interval; }
+    size_t size() const { return m_checkpoints.size(); }
+    size_t memoryUsage() const { return m_memoryUsage; }
+
+private:
+    struct Checkpoint
+    {
+        float                          time;
+        std::vector<ModelPhysicsState> states;
+    };
+
+    void thinOut();
+
+private:
+    float  m_initialInterval;
+    float  m_interval;
+    size_t m_memoryLimit;
+    size_t m_memoryUsage = 0;
+
+    std::vector<Checkpoint> m_checkpoints; // sorted by time
+};
+
+} // namespace glmmd
+
+#endif
+
+#endif
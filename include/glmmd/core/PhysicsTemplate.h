@@ -0,0 +1,114 @@
+#ifndef GLMMD_CORE_PHYSICS_TEMPLATE_H_
+#define GLMMD_CORE_PHYSICS_TEMPLATE_H_
+
+#ifndef GLMMD_DONT_USE_BULLET
+
+#include <btBulletCollisionCommon.h>
+#include <btBulletDynamicsCommon.h>
+
+#include <memory>
+#include <vector>
+
+#include <glmmd/core/ModelData.h>
+#include <glmmd/core/Transform.h>
+
+namespace glmmd
+{
+
+// Everything about a model's rigid bodies and joints that does not change
+// between instances: collision shapes (identical ones shared), local
+// inertia, offsets and joint frames. Built once per ModelData.
+class PhysicsTemplate
+{
+public:
+    explicit PhysicsTemplate(const ModelData &modelData);
+
+    PhysicsTemplate(const PhysicsTemplate &)            = delete;
+    PhysicsTemplate &operator=(const PhysicsTemplate &) = delete;
+
+    struct Body
+    {
+        Transform         offset;
+        btTransform       offsetBt;
+        btCollisionShape *shape;
+        btScalar          radius;         // smallest half size
+        btScalar          boundingRadius;
+
+        btScalar  mass; // 0 for static bodies
+        btVector3 localInertia;
+        btScalar  linearDamping;
+        btScalar  angularDamping;
+        btScalar  restitution;
+        btScalar  friction;
+
+        int  group;
+        int  mask;
+        bool kinematic;
+    };
+
+    // Joints between two static bodies are left out
+    struct Joint
+    {
+        uint32_t    bodyA;
+        uint32_t    bodyB;
+        btTransform frameA;
+        btTransform frameB;
+        btVector3   linearLowerLimit;
+        btVector3   linearUpperLimit;
+        btVector3   angularLowerLimit;
+        btVector3   angularUpperLimit;
+        btScalar    stiffness[6];
+    };
+
+    const std::vector<Body>  &bodies() const { return m_bodies; }
+    const std::vector<Joint> &joints() const { return m_joints; }
+
+    size_t shapeCount() const { return m_shapes.size(); }
+
+private:
+    std::vector<std::unique_ptr<btCollisionShape>> m_shapes;
+
+    std::vector<Body>  m_bodies;
+    std::vector<Joint> m_joints;
+};
+
+// The Bullet objects of one model instance: motion states, rigid bodies and
+// constraints, constructed in a single allocation.
+class PhysicsInstance
+{
+public:
+    // Bodies start at `bodyTransforms`
+    PhysicsInstance(std::shared_ptr<const PhysicsTemplate> physicsTemplate,
+                    const std::vector<Transform>          &bodyTransforms);
+    ~PhysicsInstance();
+
+    PhysicsInstance(const PhysicsInstance &)            = delete;
+    PhysicsInstance &operator=(const PhysicsInstance &) = delete;
+
+    const PhysicsTemplate &physicsTemplate() const { return *m_template; }
+
+    size_t bodyCount() const { return m_bodyCount; }
+    size_t jointCount() const { return m_jointCount; }
+
+    btDefaultMotionState &motionState(size_t i) { return m_motionStates[i]; }
+    btRigidBody          &rigidBody(size_t i) { return m_rigidBodies[i]; }
+    btGeneric6DofSpringConstraint &joint(size_t i) { return m_joints[i]; }
+
+private:
+    std::shared_ptr<const PhysicsTemplate> m_template;
+
+    void *m_memory = nullptr;
+
+    btDefaultMotionState          *m_motionStates = nullptr;
+    btRigidBody                   *m_rigidBodies  = nullptr;
+    btGeneric6DofSpringConstraint *m_joints       = nullptr;
+
+    size_t m_bodyCount  = 0;
+    size_t m_jointCount = 0;
+};
+
+} // namespace glmmd
+
+#endif
+
+#endif
@@ -3,9 +3,17 @@
 
 #ifndef GLMMD_DONT_USE_BULLET
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <glmmd/core/Model.h>
+#include <glmmd/core/TripleBuffer.h>
 
 namespace glmmd
 {
@@ -14,36 +22,199 @@ class PhysicsWorld
 {
 public:
     PhysicsWorld();
+    ~PhysicsWorld();
 
-    void setupModelPhysics(Model &model, bool applyCurrentTransforms = false);
+    PhysicsWorld(const PhysicsWorld &)            = delete;
+    PhysicsWorld &operator=(const PhysicsWorld &) = delete;
+
+    // Models must not be moved while their physics is set up.
+    // With per-model worlds enabled, a model only collides with other models
+    // if `collideWithOtherModels` is set, such models share one world.
+    void setupModelPhysics(Model &model, bool applyCurrentTransforms = false,
+                           bool collideWithOtherModels = false);
 
     void clearModelPhysics(Model &model);
 
+    // Exchanges ModelPhysics::bodyTransforms with the simulation. Kinematic
+    // targets written since the last call are applied before stepping.
     void update(float deltaTime, int maxSubSteps = 10,
                 float fixedDeltaTime = 1.f / 60.f);
 
+    // Steps physics on a thread of its own at a fixed rate. update() then
+    // only publishes kinematic targets to it and interpolates the latest
+    // results to the render time, which lags one step behind. At most
+    // `maxSubSteps` missed steps are caught up with. stopThread() only pauses
+    // the thread, it is reused by the next start: a Bullet built with
+    // BT_THREADSAFE gives every thread that enters it an index of its own,
+    // and there are only BT_MAX_THREAD_COUNT of them.
+    void startThread(float fixedDeltaTime = 1.f / 60.f, int maxSubSteps = 10);
+    void stopThread();
+    bool threadRunning() const { return m_threadRunning; }
+
     void setGravity(const glm::vec3 &gravity);
 
+    void saveState(const Model &model, ModelPhysicsState &state) const;
+    // Contacts of the model's bodies are dropped and rebuilt by the next step
+    void restoreState(Model &model, const ModelPhysicsState &state);
+
+    // Gives every model without cross-model collision a world of its own.
+    // Models that are already set up are moved over with their current bone
+    // transforms. Independent worlds are stepped in parallel only with
+    // GLMMD_BULLET_PARALLEL_WORLDS, as Bullet's profiler and other global
+    // state need a Bullet built with BT_THREADSAFE and BT_NO_PROFILE.
+    void setPerModelWorlds(bool enabled);
+    bool perModelWorlds() const { return m_perModelWorlds; }
+
+    size_t worldCount() const { return m_scenes.size(); }
+
+    // Bullet's multithreaded world and constraint solver pool, scheduled on
+    // glmmd's parallel backend. Requires GLMMD_BULLET_MULTITHREADED, models
+    // are moved over like with setPerModelWorlds().
+    void setMultithreaded(bool enabled);
+    bool multithreaded() const { return m_multithreaded; }
+
+    // Number of pooled constraint solvers and the maximum number of threads
+    // working on one world, 0: hardware concurrency.
+    void     setThreadCount(uint32_t count);
+    uint32_t threadCount() const { return m_threadCount; }
+
+    void setSolverIterations(int iterations);
+    int  solverIterations() const { return m_solverIterations; }
+
+    // Splits every fixed step of a world into up to 4 steps, picked from the
+    // joint separations and body velocities of its models after each
+    // update. Refines at once, coarsens one step per update. Per model with
+    // per-model worlds.
+    void setAdaptiveStepping(bool enabled);
+    bool adaptiveStepping() const { return m_adaptiveStepping; }
+
+    // Lets Bullet put bodies at rest to sleep. Models are woken up when a
+    // kinematic body moves, worlds whose models all sleep are not stepped.
+    void setDeactivation(bool enabled);
+    bool deactivation() const { return m_deactivation; }
+
+    bool isSleeping(const Model &model) const;
+
 private:
-    void setupModelRigidBodies(Model &model, bool applyCurrentTransforms);
-    void setupModelJoints(Model &model);
+    // Transforms of one model passed between update() and the physics
+    // thread
+    struct Exchange
+    {
+        struct Result
+        {
+            std::vector<Transform> previous;
+            std::vector<Transform> current;
+            double                 time = 0.0;
+        };
+
+        explicit Exchange(const std::vector<Transform> &bodyTransforms)
+            : targets(bodyTransforms)
+            , results(Result{bodyTransforms, bodyTransforms})
+            , last(bodyTransforms)
+        {
+        }
+
+        TripleBuffer<std::vector<Transform>> targets;
+        TripleBuffer<Result>                 results;
+
+        std::vector<Transform> last; // owned by the physics thread
+    };
+
+    struct Scene
+    {
+        std::unique_ptr<btDefaultCollisionConfiguration>     collisionConfig;
+        std::unique_ptr<btCollisionDispatcher>               dispatcher;
+        std::unique_ptr<btBroadphaseInterface>               broadphase;
+        std::unique_ptr<btConstraintSolver>                  solver;
+        std::unique_ptr<btConstraintSolver>                  solverMt;
+        std::unique_ptr<btDiscreteDynamicsWorld>             world;
+
+        std::unique_ptr<btDefaultMotionState> groundMotionState;
+        std::unique_ptr<btRigidBody>          groundRigidBody;
+
+        struct Entry
+        {
+            Model                    *model;
+            bool                      collideWithOtherModels;
+            std::unique_ptr<Exchange> exchange;
+        };
+        std::vector<Entry> models;
+
+        int steps = 1; // per fixed step, with adaptive stepping
+    };
+
+    std::unique_ptr<Scene> createScene() const;
+
+    // Sets up all models again in newly created scenes after `change`
+    template <typename Func>
+    void recreateScenes(Func &&change);
+
+    Scene *findScene(const Model &model, size_t *entryIndex = nullptr) const;
+
+    // Shared by all instances of a ModelData that are set up at a time
+    std::shared_ptr<const PhysicsTemplate>
+    physicsTemplate(const ModelData &modelData);
+
+    // Runs func(scene) for every scene, in parallel if they are independent
+    template <typename Func>
+    void forEachScene(Func &&func);
+
+    void addModel(Model &model, bool applyCurrentTransforms,
+                  bool collideWithOtherModels);
+    void removeModel(Model &model);
+
+    // Steps the scene unless all of its models sleep, then adapts its steps
+    void stepScene(Scene &scene, float deltaTime, int maxSubSteps,
+                   float fixedDeltaTime);
+    void adaptSteps(Scene &scene, float fixedDeltaTime) const;
+
+    void updateFromThread();
+    void threadLoop();
+    void stepThread(double time);
+
+    void applySleepingThresholds(Model &model) const;
+
+    void setupModelRigidBodies(btDiscreteDynamicsWorld &world, Model &model,
+                               bool applyCurrentTransforms);
+    void setupModelJoints(btDiscreteDynamicsWorld &world, Model &model);
 
 private:
-    std::unique_ptr<btDefaultCollisionConfiguration>     m_collisionConfig;
-    std::unique_ptr<btCollisionDispatcher>               m_dispatcher;
-    std::unique_ptr<btBroadphaseInterface>               m_broadphase;
-    std::unique_ptr<btSequentialImpulseConstraintSolver> m_solver;
-    std::unique_ptr<btDiscreteDynamicsWorld>             m_world;
+    std::unique_ptr<btCollisionShape> m_groundShape;
+
+    // m_scenes[0] is shared by all models unless per-model worlds are enabled
+    std::vector<std::unique_ptr<Scene>> m_scenes;
+
+    std::unordered_map<const ModelData *,
+                       std::weak_ptr<const PhysicsTemplate>>
+        m_templates;
 
-    std::unique_ptr<btCollisionShape>     m_groundShape;
-    std::unique_ptr<btDefaultMotionState> m_groundMotionState;
-    std::unique_ptr<btRigidBody>          m_groundRigidBody;
+    bool     m_perModelWorlds   = false;
+    bool     m_multithreaded    = false;
+    uint32_t m_threadCount      = 0;
+    int      m_solverIterations = 10;
+    bool     m_adaptiveStepping = false;
+    bool     m_deactivation     = false;
 
     btVector3 m_gravity;
+
+    // Held by the physics thread while stepping, and by every call changing
+    // the scenes.
+    mutable std::mutex m_mutex;
+
+    std::thread             m_thread;
+    std::condition_variable m_threadResumed;
+
+    // Written with m_mutex held
+    bool                                  m_threadRunning = false;
+    bool                                  m_threadExit    = false;
+    uint32_t                              m_threadStarts  = 0;
+    std::chrono::steady_clock::time_point m_threadEpoch;
+    float                                 m_threadDeltaTime   = 1.f / 60.f;
+    int                                   m_threadMaxSubSteps = 10;
 };
 
 } // namespace glmmd
 
 #endif
 
-#endif
\ No newline at end of file
+#endif
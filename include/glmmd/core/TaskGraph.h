@@ -0,0 +1,117 @@
+#ifndef GLMMD_CORE_TASK_GRAPH_H_
+#define GLMMD_CORE_TASK_GRAPH_H_
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifdef GLMMD_USE_TBB
+#include <tbb/task_group.h>
+#else
+#include <glmmd/core/ThreadPool.h>
+#endif
+
+namespace glmmd
+{
+
+// A set of tasks with "runs before" edges, executed on a ThreadPool, or on
+// TBB with GLMMD_USE_TBB. Tasks whose dependencies are satisfied may run
+// concurrently, so the result is deterministic as long as tasks without an
+// edge between them touch disjoint data.
+class TaskGraph
+{
+public:
+    using TaskId = uint32_t;
+
+    TaskGraph()                             = default;
+    TaskGraph(const TaskGraph &)            = delete;
+    TaskGraph &operator=(const TaskGraph &) = delete;
+    ~TaskGraph();
+
+    TaskId addTask(std::function<void()> func);
+
+    // `after` starts only when `before` has finished
+    void precede(TaskId before, TaskId after);
+
+    void clear();
+
+    size_t size() const { return m_tasks.size(); }
+
+    // Schedules all tasks and returns immediately.
+#ifdef GLMMD_USE_TBB
+    void start();
+#else
+    void start(ThreadPool &pool = ThreadPool::global());
+#endif
+
+    // Helps the pool until the task has finished, and blocks once the pool
+    // has nothing left to run. Rethrows the first exception thrown by any
+    // task of the graph.
+    void wait(TaskId id);
+
+    // Like wait(id), until every task has finished.
+    void wait();
+
+#ifdef GLMMD_USE_TBB
+    void run()
+    {
+        start();
+        wait();
+    }
+#else
+    void run(ThreadPool &pool = ThreadPool::global())
+    {
+        start(pool);
+        wait();
+    }
+#endif
+
+private:
+    struct Task
+    {
+        std::function<void()> func;
+        std::vector<TaskId>   successors;
+        uint32_t              dependencyCount = 0;
+    };
+
+    void runTask(TaskId id);
+    void schedule(TaskId id);
+    void rethrow();
+
+#ifndef GLMMD_USE_TBB
+    // Runs queued pool tasks until done(value) holds. After finding nothing
+    // to run a number of times in a row, the remaining tasks run on other
+    // threads and this blocks until value is notified.
+    template <typename T, typename Done>
+    void helpPool(const std::atomic<T> &value, Done done);
+
+    void waitForTasks();
+#endif
+
+private:
+    std::vector<Task> m_tasks;
+
+#ifdef GLMMD_USE_TBB
+    tbb::task_group m_group;
+    bool            m_started = false;
+#else
+    ThreadPool *m_pool = nullptr;
+
+    std::unique_ptr<ThreadPool::Job> m_job;
+
+    std::atomic<uint32_t> m_unfinished{0};
+#endif
+
+    std::unique_ptr<std::atomic<uint32_t>[]> m_pending;
+    std::unique_ptr<std::atomic<bool>[]>     m_done;
+
+    std::atomic<bool>  m_failed{false};
+    std::exception_ptr m_exception;
+};
+
+} // namespace glmmd
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef GLMMD_CORE_THREAD_POOL_H_
+#define GLMMD_CORE_THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace glmmd
+{
+
+struct ThreadPoolConfig
+{
+    // Total number of threads taking part in parallel loops, including the
+    // calling thread. 0: std::thread::hardware_concurrency().
+    uint32_t threadCount = 0;
+
+    // CPU index for each worker thread, empty: no pinning.
+    std::vector<uint32_t> workerAffinity;
+};
+
+bool setCurrentThreadAffinity(uint32_t cpu);
+
+class ThreadPool
+{
+    friend class TaskGraph;
+
+public:
+    explicit ThreadPool(const ThreadPoolConfig &config = {});
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &)            = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&)                 = delete;
+    ThreadPool &operator=(ThreadPool &&)      = delete;
+
+    uint32_t threadCount() const
+    {
+        return static_cast<uint32_t>(m_workers.size()) + 1;
+    }
+
+    // func(begin, end) is called on disjoint chunks of [first, last) with at
+    // most `grain` elements each. The calling thread takes part in the work,
+    // so nested calls from inside a chunk do not spawn additional threads.
+    template <typename Func>
+    void parallelForChunked(size_t first, size_t last, size_t grain,
+                            Func &&func);
+
+    template <typename Func>
+    void parallelFor(size_t first, size_t last, size_t grain, Func &&func)
+    {
+        parallelForChunked(first, last, grain,
+                           [&func](size_t begin, size_t end)
+                           {
+                               for (; begin != end; ++begin)
+                                   func(begin);
+                           });
+    }
+
+    size_t defaultGrain(size_t count) const
+    {
+        return std::max<size_t>(1, count / (8 * threadCount()));
+    }
+
+    static ThreadPool &global();
+
+    // Recreates the global pool. Must not be called while it is in use.
+    static void configureGlobal(const ThreadPoolConfig &config);
+
+private:
+    struct Job
+    {
+        void (*invoke)(const void *, size_t, size_t);
+        const void         *func;
+        size_t              grain;
+        std::atomic<size_t> remaining;
+
+        std::atomic<bool>  failed{false};
+        std::exception_ptr exception;
+    };
+
+    struct Task
+    {
+        Job   *job;
+        size_t begin;
+        size_t end;
+    };
+
+    struct WorkQueue
+    {
+        std::mutex       mutex;
+        std::deque<Task> tasks;
+    };
+
+    void run(Job &job, size_t first, size_t last);
+
+    void execute(Task task);
+    void push(const Task &task);
+    bool tryRunOne();
+
+    void workerLoop(uint32_t index);
+
+    size_t localQueueIndex() const;
+
+private:
+    std::vector<std::thread>                m_workers;
+    std::vector<std::unique_ptr<WorkQueue>> m_queues; // 0: external threads
+
+    std::atomic<size_t>   m_queuedTasks{0};
+    std::atomic<uint32_t> m_sleepingWorkers{0};
+    std::atomic<bool>     m_stop{false};
+
+    std::mutex              m_sleepMutex;
+    std::condition_variable m_sleepCondition;
+};
+
+template <typename Func>
+void ThreadPool::parallelForChunked(size_t first, size_t last, size_t grain,
+                                    Func &&func)
+{
+    if (first >= last)
+        return;
+
+    grain = std::max<size_t>(grain, 1);
+    if (last - first <= grain || m_workers.empty())
+    {
+        for (; first < last; first += std::min(grain, last - first))
+            func(first, first + std::min(grain, last - first));
+        return;
+    }
+
+    using FuncType = std::remove_reference_t<Func>;
+
+    Job job;
+    job.invoke = [](const void *f, size_t begin, size_t end)
+    { (*static_cast<FuncType *>(const_cast<void *>(f)))(begin, end); };
+    job.func  = static_cast<const void *>(std::addressof(func));
+    job.grain = grain;
+    job.remaining.store(last - first, std::memory_order_relaxed);
+
+    run(job, first, last);
+}
+
+} // namespace glmmd
+
+#endif
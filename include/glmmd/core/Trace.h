@@ -0,0 +1,74 @@
+#ifndef GLMMD_CORE_TRACE_H_
+#define GLMMD_CORE_TRACE_H_
+
+// Scoped trace zones, compiled out unless GLMMD_ENABLE_TRACING is defined.
+// Zone names must be string literals. Each thread records into its own
+// buffer without locking, the buffers can be dumped as Chrome trace JSON
+// (chrome://tracing, https://ui.perfetto.dev).
+
+#ifdef GLMMD_ENABLE_TRACING
+
+#include <cstdint>
+#include <filesystem>
+
+namespace glmmd::trace
+{
+
+// ns since an arbitrary epoch
+uint64_t now();
+
+// Recording is off by default.
+void setEnabled(bool enabled);
+bool enabled();
+
+void record(const char *name, uint64_t begin, uint64_t end);
+
+// Name shown for the calling thread, must be a string literal.
+void setThreadName(const char *name);
+
+// Discards recorded events. Must not be called while zones are open.
+void clear();
+
+// Must not be called while zones are open.
+void dumpChromeTrace(const std::filesystem::path &path);
+
+class Scope
+{
+public:
+    explicit Scope(const char *name)
+        : m_name(name)
+        , m_begin(enabled() ? now() : 0)
+    {
+    }
+
+    ~Scope()
+    {
+        if (m_begin != 0)
+            record(m_name, m_begin, now());
+    }
+
+    Scope(const Scope &)            = delete;
+    Scope &operator=(const Scope &) = delete;
+
+private:
+    const char *m_name;
+    uint64_t    m_begin;
+};
+
+} // namespace glmmd::trace
+
+#define GLMMD_TRACE_CONCAT_IMPL(a, b) a##b
+#define GLMMD_TRACE_CONCAT(a, b)      GLMMD_TRACE_CONCAT_IMPL(a, b)
+
+#define GLMMD_TRACE_SCOPE(name)                                                \
+    ::glmmd::trace::Scope GLMMD_TRACE_CONCAT(glmmdTraceScope, __LINE__)(name)
+#define GLMMD_TRACE_THREAD_NAME(name) ::glmmd::trace::setThreadName(name)
+
+#else
+
+#define GLMMD_TRACE_SCOPE(name)       ((void)0)
+#define GLMMD_TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
+
+#endif
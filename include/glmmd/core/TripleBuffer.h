@@ -0,0 +1,63 @@
+#ifndef GLMMD_CORE_TRIPLE_BUFFER_H_
+#define GLMMD_CORE_TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace glmmd
+{
+
+// Lock-free exchange of the latest value between one producer and one
+// consumer thread. The producer fills back() and publishes it, the consumer
+// fetches the most recently published value into front(). Neither side ever
+// waits, values published in between two fetches are dropped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    explicit TripleBuffer(const T &value)
+        : m_slots{value, value, value}
+    {
+    }
+
+    TripleBuffer(const TripleBuffer &)            = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    T &back() { return m_slots[m_back]; }
+
+    void publish()
+    {
+        m_back = m_middle.exchange(m_back | DIRTY_BIT,
+                                   std::memory_order_acq_rel) &
+                 INDEX_MASK;
+    }
+
+    // Returns false if nothing was published since the last fetch
+    bool fetch()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & DIRTY_BIT) == 0)
+            return false;
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) &
+                  INDEX_MASK;
+        return true;
+    }
+
+    T       &front() { return m_slots[m_front]; }
+    const T &front() const { return m_slots[m_front]; }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 3;
+    static constexpr uint8_t DIRTY_BIT  = 4;
+
+    T m_slots[3];
+
+    uint8_t              m_back  = 0;
+    uint8_t              m_front = 1;
+    std::atomic<uint8_t> m_middle{2};
+};
+
+} // namespace glmmd
+
+#endif
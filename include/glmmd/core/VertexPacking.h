@@ -0,0 +1,54 @@
+#ifndef GLMMD_CORE_VERTEX_PACKING_H_
+#define GLMMD_CORE_VERTEX_PACKING_H_
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace glmmd
+{
+
+// Unit normal as two snorm16 of its octahedral projection, x in the low
+// half. GLSL decodes it the same way as unpackOctNormal(). Written without
+// branches, the signs of skinned normals are random.
+inline uint32_t packOctNormal(const glm::vec3 &normal)
+{
+    float l1  = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    float inv = 1.f / std::max(l1, FLT_MIN);
+    float x   = normal.x * inv;
+    float y   = normal.y * inv;
+
+    // Lower hemisphere folded over the diagonals
+    float fold  = static_cast<float>(normal.z < 0.f);
+    float foldX = std::copysign(1.f - std::abs(y), x);
+    float foldY = std::copysign(1.f - std::abs(x), y);
+    x += fold * (foldX - x);
+    y += fold * (foldY - y);
+
+    // As glm::packSnorm2x16, x and y are within [-1, 1] already
+    auto snorm16 = [](float v)
+    {
+        v *= 32767.f;
+        return static_cast<uint16_t>(
+            static_cast<int16_t>(v + std::copysign(.5f, v)));
+    };
+    return snorm16(x) | static_cast<uint32_t>(snorm16(y)) << 16;
+}
+
+inline glm::vec3 unpackOctNormal(uint32_t packed)
+{
+    glm::vec2 p = glm::unpackSnorm2x16(packed);
+    glm::vec3 n(p, 1.f - std::abs(p.x) - std::abs(p.y));
+    float     t = std::max(-n.z, 0.f);
+    n.x -= std::copysign(t, n.x);
+    n.y -= std::copysign(t, n.y);
+    return glm::normalize(n);
+}
+
+} // namespace glmmd
+
+#endif
@@ -9,14 +9,22 @@
 namespace glmmd
 {
 
+// Replaces the contents of `output`, reusing its capacity
 template <class From, class To>
-std::string codeCvt(std::string_view input)
+void codeCvt(std::string_view input, std::string &output)
 {
-    std::string output;
+    output.clear();
     output.reserve(input.size() * To::bytes / From::bytes);
     for (size_t i = 0; i < input.size();
          To::encode(From::decode(input, i), output))
         ;
+}
+
+template <class From, class To>
+std::string codeCvt(std::string_view input)
+{
+    std::string output;
+    codeCvt<From, To>(input, output);
     return output;
 }
 
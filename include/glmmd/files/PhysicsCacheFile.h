@@ -0,0 +1,23 @@
+#ifndef GLMMD_FILES_PHYSICS_CACHE_FILE_H_
+#define GLMMD_FILES_PHYSICS_CACHE_FILE_H_
+
+#include <filesystem>
+#include <memory>
+
+#include <glmmd/core/PhysicsCache.h>
+
+namespace glmmd
+{
+
+// Binary, little endian: "GLMMDPC" magic, version, frame rate, frame count,
+// bones (index, name, range), then the samples frame by frame.
+
+std::shared_ptr<PhysicsCache>
+loadPhysicsCacheFile(const std::filesystem::path &path);
+
+void dumpPhysicsCacheFile(const std::filesystem::path &path,
+                          const PhysicsCache          &cache);
+
+} // namespace glmmd
+
+#endif
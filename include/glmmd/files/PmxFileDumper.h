@@ -4,6 +4,7 @@
 #include <cassert>
 #include <filesystem>
 #include <fstream>
+#include <string_view>
 
 #include <glmmd/core/ModelData.h>
 #include <glmmd/files/CodeConverter.h>
@@ -32,7 +33,7 @@ private:
     void dumpGroupMorph(const ModelData &, const Morph &);
     void dumpVertexMorph(const ModelData &, const Morph &);
     void dumpBoneMorph(const ModelData &, const Morph &);
-    void dumpUVMorph(const ModelData &, const Morph &, uint8_t);
+    void dumpUVMorph(const ModelData &, const Morph &);
     void dumpMaterialMorph(const ModelData &, const Morph &);
 
     template <int count = 1>
@@ -83,7 +84,7 @@ private:
         }
     }
 
-    void writeTextBuffer(const std::string &buf)
+    void writeTextBuffer(std::string_view buf)
     {
         if (m_textEncoding == EncodingMethod::UTF8)
         {
@@ -34,11 +34,11 @@ private:
     void loadRigidBodies(ModelData &);
     void loadJoints(ModelData &);
 
-    void loadGroupMorph(const ModelData &, Morph &);
-    void loadVertexMorph(const ModelData &, Morph &);
-    void loadBoneMorph(const ModelData &, Morph &);
-    void loadUVMorph(const ModelData &, Morph &, uint8_t);
-    void loadMaterialMorph(const ModelData &, Morph &);
+    void loadGroupMorph(ModelData &, Morph &);
+    void loadVertexMorph(ModelData &, Morph &);
+    void loadBoneMorph(ModelData &, Morph &);
+    void loadUVMorph(ModelData &, Morph &);
+    void loadMaterialMorph(ModelData &, Morph &);
 
     template <int count = 1>
     void readFloat(float &val)
@@ -130,9 +130,15 @@ private:
         m_fin.read(buf.data(), sz);
     }
 
+    // Reads and converts in reused buffers, the model's string is assigned
+    // once
+    void readText(const ModelData &, std::pmr::string &);
+
 private:
     std::ifstream         m_fin;
     std::filesystem::path m_modelDir;
+    std::string           m_textBuffer;
+    std::string           m_utf8Buffer;
 };
 
 inline std::shared_ptr<ModelData> loadPmxFile(const std::filesystem::path &path)
@@ -0,0 +1,79 @@
+#ifndef GLMMD_FILES_SYNTHETIC_DATA_H_
+#define GLMMD_FILES_SYNTHETIC_DATA_H_
+
+#include <cstdint>
+#include <string_view>
+
+#include <glmmd/core/ModelData.h>
+#include <glmmd/files/VmdData.h>
+
+namespace glmmd
+{
+
+// Procedurally generated models and motions for reproducible benchmarks.
+// Output only depends on the config, including the seed.
+
+struct SyntheticModelConfig
+{
+    uint32_t seed = 1;
+
+    uint32_t vertexCount     = 20000;
+    uint32_t materialCount   = 8;
+    uint8_t  additionalUVNum = 0;
+
+    // Including the root bone and IK target bones. Remaining bones form
+    // chains of `chainLength` bones hanging from the root.
+    uint32_t boneCount   = 256;
+    uint32_t chainLength = 8;
+
+    // Each IK target drives the last `ikChainLength` links of one chain.
+    uint32_t ikChainCount  = 4;
+    uint32_t ikChainLength = 2;
+
+    uint32_t vertexMorphCount   = 32;
+    uint32_t vertexMorphSize    = 500;
+    uint32_t uvMorphCount       = 4;
+    uint32_t boneMorphCount     = 4;
+    uint32_t materialMorphCount = 4;
+    uint32_t groupMorphCount    = 4;
+
+    // Rigid bodies are attached to chain bones, the first one of every chain
+    // follows its bone, the rest are simulated. Joints connect consecutive
+    // bodies of a chain.
+    uint32_t rigidBodyCount = 96;
+    uint32_t jointCount     = 84;
+
+    // Relative frequencies of the skinning types
+    float bdef1Weight = 0.2f;
+    float bdef2Weight = 0.5f;
+    float bdef4Weight = 0.2f;
+    float sdefWeight  = 0.1f;
+    float qdefWeight  = 0.0f;
+};
+
+// "tiny", "small", "medium", "large" or "extreme"
+SyntheticModelConfig syntheticModelPreset(std::string_view name);
+
+ModelData generateSyntheticModel(const SyntheticModelConfig &config);
+
+struct SyntheticMotionConfig
+{
+    uint32_t seed = 1;
+
+    uint32_t frameCount       = 300;
+    uint32_t keyFrameInterval = 10;
+
+    // Fractions of bones and morphs that get key frames
+    float boneRatio  = 1.f;
+    float morphRatio = 1.f;
+
+    float rotationAmplitude    = 0.5f; // rad
+    float translationAmplitude = 1.f;
+};
+
+VmdData generateSyntheticMotion(const ModelData             &modelData,
+                                const SyntheticMotionConfig &config);
+
+} // namespace glmmd
+
+#endif
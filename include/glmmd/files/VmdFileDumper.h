@@ -0,0 +1,51 @@
+#ifndef GLMMD_FILES_VMD_FILE_DUMPER_H_
+#define GLMMD_FILES_VMD_FILE_DUMPER_H_
+
+#include <filesystem>
+#include <fstream>
+
+#include <glmmd/files/VmdData.h>
+
+namespace glmmd
+{
+
+class VmdFileDumper
+{
+public:
+    VmdFileDumper(const std::filesystem::path &path);
+    void dump(const VmdData &data);
+
+private:
+    void dumpHeader(const VmdData &);
+    void dumpBoneFrames(const VmdData &);
+    void dumpMorphFrames(const VmdData &);
+    void dumpCameraFrames(const VmdData &);
+
+    template <int count = 1>
+    void writeFloat(const float &val)
+    {
+        m_fout.write(reinterpret_cast<const char *>(&val),
+                     sizeof(float) * count);
+    }
+
+    template <typename UIntType>
+    void writeUInt(const UIntType &val)
+    {
+        m_fout.write(reinterpret_cast<const char *>(&val), sizeof(UIntType));
+    }
+
+    // Shift-JIS string, truncated or zero padded to `size` bytes
+    void writeName(const std::string &name, size_t size);
+
+private:
+    std::ofstream m_fout;
+};
+
+inline void dumpVmdFile(const std::filesystem::path &path, const VmdData &data)
+{
+    VmdFileDumper{path}.dump(data);
+}
+
+} // namespace glmmd
+
+#endif
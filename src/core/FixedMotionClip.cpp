@@ -1,6 +1,7 @@
 #include <cmath>
 
 #include <glmmd/core/FixedMotionClip.h>
+#include <glmmd/core/Trace.h>
 
 namespace glmmd
 {
@@ -14,6 +15,8 @@ FixedMotionClip::FixedMotionClip(bool loop_, float frameRate_)
 
 void FixedMotionClip::getLocalPose(float time, ModelPose &pose) const
 {
+    GLMMD_TRACE_SCOPE("FixedMotionClip::getLocalPose");
+
     if (frameCount == 0)
         return;
 
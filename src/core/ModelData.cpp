@@ -1,4 +1,10 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <memory>
+
 #include <glmmd/core/ModelData.h>
+#include <glmmd/core/VertexPacking.h>
 
 namespace glmmd
 {
@@ -18,4 +24,254 @@ void ModelData::validateIndexByteSizes()
     info.rigidBodyIndexSize = byteSize(rigidBodies.size());
 }
 
+// Makes an empty container allocate from arena. Assigning would keep the
+// default resource, pmr allocators do not propagate.
+template <typename T>
+static void useArena(T &member, std::pmr::memory_resource *arena)
+{
+    std::destroy_at(&member);
+    std::construct_at(&member, arena);
+}
+
+Material &ModelData::addMaterial()
+{
+    auto &material = materials.emplace_back();
+    useArena(material.name, arena());
+    useArena(material.nameEN, arena());
+    useArena(material.memo, arena());
+    return material;
+}
+
+IKData &ModelData::addIKData()
+{
+    auto &ik = ikData.emplace_back();
+    useArena(ik.links, arena());
+    return ik;
+}
+
+Bone &ModelData::addBone()
+{
+    auto &bone = bones.emplace_back();
+    useArena(bone.name, arena());
+    useArena(bone.nameEN, arena());
+    return bone;
+}
+
+Morph &ModelData::addMorph()
+{
+    auto &morph = morphs.emplace_back();
+    useArena(morph.name, arena());
+    useArena(morph.nameEN, arena());
+    return morph;
+}
+
+DisplayFrame &ModelData::addDisplayFrame()
+{
+    auto &frame = displayFrames.emplace_back();
+    useArena(frame.name, arena());
+    useArena(frame.nameEN, arena());
+    useArena(frame.elements, arena());
+    return frame;
+}
+
+RigidBody &ModelData::addRigidBody()
+{
+    auto &rigidBody = rigidBodies.emplace_back();
+    useArena(rigidBody.name, arena());
+    useArena(rigidBody.nameEN, arena());
+    return rigidBody;
+}
+
+Joint &ModelData::addJoint()
+{
+    auto &joint = joints.emplace_back();
+    useArena(joint.name, arena());
+    useArena(joint.nameEN, arena());
+    return joint;
+}
+
+template <typename T>
+static uint32_t appendElements(std::vector<T> &pool, int32_t count)
+{
+    auto offset = static_cast<uint32_t>(pool.size());
+    pool.resize(pool.size() + std::max(count, 0));
+    return offset;
+}
+
+void ModelData::allocateMorphElements(Morph &morph)
+{
+    switch (morph.type)
+    {
+    case MorphType::Group:
+        morph.offset = appendElements(morphPools.group, morph.count);
+        break;
+    case MorphType::Vertex:
+        morph.offset = appendElements(morphPools.vertex, morph.count);
+        break;
+    case MorphType::Bone:
+        morph.offset = appendElements(morphPools.bone, morph.count);
+        break;
+    case MorphType::UV:
+    case MorphType::UV1:
+    case MorphType::UV2:
+    case MorphType::UV3:
+    case MorphType::UV4:
+        morph.offset = appendElements(morphPools.uv, morph.count);
+        break;
+    case MorphType::Material:
+        morph.offset = appendElements(morphPools.material, morph.count);
+        break;
+    }
+}
+
+void ModelData::updateSkinningData()
+{
+    {
+        std::lock_guard lock(m_restVertices->mutex);
+        m_restVertices->buffer.reset();
+        m_restVertices->positionNormals.reset();
+        m_restVertices->positionOctNormals.reset();
+    }
+
+    size_t n = vertices.size();
+
+    skinning.normals.resize(n);
+    skinning.types.resize(n);
+    skinning.boneWeights.resize(n * 4);
+    skinning.sdef.clear();
+
+    bool narrow = bones.size() <= 0x10000u;
+    skinning.boneIndices16.clear();
+    skinning.boneIndices32.clear();
+    if (narrow)
+        skinning.boneIndices16.resize(n * 4);
+    else
+        skinning.boneIndices32.resize(n * 4);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const auto &vert = vertices[i];
+
+        skinning.normals[i] = vert.normal;
+        skinning.types[i]   = vert.skinningType;
+
+        for (size_t k = 0; k < 4; ++k)
+        {
+            auto bone =
+                static_cast<uint32_t>(std::max(vert.boneIndices[k], 0));
+            if (narrow)
+                skinning.boneIndices16[i * 4 + k] = static_cast<uint16_t>(bone);
+            else
+                skinning.boneIndices32[i * 4 + k] = bone;
+
+            float w = std::clamp(vert.boneWeights[k], 0.f, 1.f);
+            skinning.boneWeights[i * 4 + k] =
+                static_cast<uint16_t>(w * 65535.f + 0.5f);
+        }
+
+        if (vert.skinningType == VertexSkinningType::SDEF)
+            skinning.sdef.push_back({static_cast<uint32_t>(i), vert.sdefC,
+                                     0.5f * (vert.sdefR0 - vert.sdefR1)});
+    }
+}
+
+std::shared_ptr<const std::vector<float>> ModelData::restVertexBuffer() const
+{
+    std::lock_guard lock(m_restVertices->mutex);
+    if (m_restVertices->buffer)
+        return m_restVertices->buffer;
+
+    size_t stride = restVertexStride();
+    auto   buffer =
+        std::make_shared<std::vector<float>>(vertices.size() * stride);
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const auto &vert = vertices[i];
+
+        float *out = buffer->data() + i * stride;
+        *out++     = vert.position.x;
+        *out++     = vert.position.y;
+        *out++     = vert.position.z;
+        *out++     = vert.normal.x;
+        *out++     = vert.normal.y;
+        *out++     = vert.normal.z;
+        *out++     = vert.uv.x;
+        *out++     = vert.uv.y;
+        for (uint8_t j = 0; j < info.additionalUVNum; ++j)
+            for (uint8_t k = 0; k < 4; ++k)
+                *out++ = additionalUVs[i][j][k];
+    }
+
+    m_restVertices->buffer = std::move(buffer);
+    return m_restVertices->buffer;
+}
+
+std::shared_ptr<const std::vector<float>>
+ModelData::restPositionNormalBuffer(bool octNormals) const
+{
+    std::lock_guard lock(m_restVertices->mutex);
+    auto &cached = octNormals ? m_restVertices->positionOctNormals
+                              : m_restVertices->positionNormals;
+    if (cached)
+        return cached;
+
+    size_t stride = octNormals ? 4 : 6;
+    auto   buffer =
+        std::make_shared<std::vector<float>>(vertices.size() * stride);
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const auto &vert = vertices[i];
+
+        float *out = buffer->data() + i * stride;
+        *out++     = vert.position.x;
+        *out++     = vert.position.y;
+        *out++     = vert.position.z;
+        if (octNormals)
+            *out = std::bit_cast<float>(packOctNormal(vert.normal));
+        else
+        {
+            *out++ = vert.normal.x;
+            *out++ = vert.normal.y;
+            *out   = vert.normal.z;
+        }
+    }
+
+    cached = std::move(buffer);
+    return cached;
+}
+
+template <typename T>
+static NameIndex makeNameIndex(const std::vector<T> &elements)
+{
+    std::vector<std::string_view> names(elements.size());
+    for (size_t i = 0; i < elements.size(); ++i)
+        names[i] = elements[i].name;
+    return NameIndex(names);
+}
+
+void ModelData::updateNameIndices()
+{
+    boneNames     = makeNameIndex(bones);
+    morphNames    = makeNameIndex(morphs);
+    materialNames = makeNameIndex(materials);
+}
+
+uint32_t ModelData::findBone(std::string_view name) const
+{
+    assert(boneNames.elementCount() == bones.size());
+    return boneNames.find(name);
+}
+
+uint32_t ModelData::findMorph(std::string_view name) const
+{
+    assert(morphNames.elementCount() == morphs.size());
+    return morphNames.find(name);
+}
+
+uint32_t ModelData::findMaterial(std::string_view name) const
+{
+    assert(materialNames.elementCount() == materials.size());
+    return materialNames.find(name);
+}
+
 } // namespace glmmd
@@ -1,9 +1,11 @@
 #include <algorithm>
+#include <stdexcept>
 
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <glmmd/core/ModelPose.h>
 #include <glmmd/core/ParallelForEach.h>
+#include <glmmd/core/Trace.h>
 
 namespace glmmd
 {
@@ -109,6 +111,20 @@ void ModelPose::applyToRenderData(ModelRenderData &renderData) const
 
 void ModelPose::applyMorphsToRenderData(ModelRenderData &renderData) const
 {
+    GLMMD_TRACE_SCOPE("applyMorphsToRenderData");
+
+    bool uvMorphs = false, materialMorphs = false;
+    for (size_t i = 0; i < m_morphRatios.size(); ++i)
+    {
+        if (m_morphRatios[i] == 0.f)
+            continue;
+        auto type = m_modelData->morphs[i].type;
+        uvMorphs |= type >= MorphType::UV && type <= MorphType::UV4;
+        materialMorphs |= type == MorphType::Material;
+    }
+    renderData.beginUVMorphs(uvMorphs);
+    renderData.beginMaterialMorphs(materialMorphs);
+
     for (size_t i = 0; i < m_morphRatios.size(); ++i)
     {
         const auto &morph = m_modelData->morphs[i];
@@ -119,19 +135,17 @@ void ModelPose::applyMorphsToRenderData(ModelRenderData &renderData) const
         switch (morph.type)
         {
         case MorphType::Vertex:
-            for (int32_t j = 0; j < morph.count; ++j)
+            for (const auto &data : m_modelData->vertexMorphs(morph))
             {
-                const auto &data = morph.vertex[j];
                 renderData.setVertexPosition(
                     data.index, renderData.getVertexPosition(data.index) +
                                     ratio * data.offset);
             }
             break;
         case MorphType::Material:
-            for (int32_t j = 0; j < morph.count; ++j)
+            for (const auto &data : m_modelData->materialMorphs(morph))
             {
-                const auto &data  = morph.material[j];
-                size_t      first = 0, last = renderData.materials.size();
+                size_t first = 0, last = renderData.materials.size();
                 if (data.index >= 0)
                 {
                     first = data.index;
@@ -180,12 +194,11 @@ void ModelPose::applyMorphsToRenderData(ModelRenderData &renderData) const
             }
             break;
         case MorphType::UV:
-            for (int32_t j = 0; j < morph.count; ++j)
+            for (const auto &data : m_modelData->uvMorphs(morph))
             {
-                const auto &data = morph.uv[j];
                 renderData.setVertexUV(data.index,
                                        renderData.getVertexUV(data.index) +
-                                           ratio * glm::vec2(data.offset[0]));
+                                           ratio * glm::vec2(data.offset));
             }
             break;
         case MorphType::UV1:
@@ -195,13 +208,12 @@ void ModelPose::applyMorphsToRenderData(ModelRenderData &renderData) const
         {
             auto uvIndex = static_cast<uint8_t>(morph.type) -
                            static_cast<uint8_t>(MorphType::UV1);
-            for (int32_t j = 0; j < morph.count; ++j)
+            for (const auto &data : m_modelData->uvMorphs(morph))
             {
-                const auto &data = morph.uv[j];
                 renderData.setVertexAdditionalUV(
                     data.index, uvIndex,
                     renderData.getVertexAdditionalUV(data.index, uvIndex) +
-                        ratio * data.offset[1 + uvIndex]);
+                        ratio * data.offset);
             }
         }
         break;
@@ -216,73 +228,106 @@ void ModelPose::applyMorphsToRenderData(ModelRenderData &renderData) const
 void ModelPose::applyBoneTransformsToRenderData(
     ModelRenderData &renderData) const
 {
+    GLMMD_TRACE_SCOPE("applyBoneTransformsToRenderData");
+
+    const auto &skinning = m_modelData->skinning;
+    if (skinning.vertexCount() != m_modelData->vertices.size())
+        throw std::runtime_error(
+            "Skinning data is out of date, call updateSkinningData().");
+
     std::vector<glm::dualquat> finalBoneTransforms(
         m_globalBoneTransforms.size());
     for (uint32_t i = 0; i < finalBoneTransforms.size(); ++i)
         finalBoneTransforms[i] = getFinalBoneTransform(i);
 
-    parallelForEach(
-        m_modelData->vertices.begin(), m_modelData->vertices.end(),
-        [&](const Vertex &vert)
-        {
-            auto i   = static_cast<uint32_t>(&vert - &m_modelData->vertices[0]);
-            auto pos = renderData.getVertexPosition(i);
-            auto norm = renderData.getVertexNormal(i);
+    constexpr size_t skinningGrain = 1024;
 
-            if (vert.skinningType == VertexSkinningType::SDEF)
+    auto skin = [&](const auto *boneIndices)
+    {
+        parallelForChunked(
+            0, skinning.vertexCount(), skinningGrain,
+            [&](size_t begin, size_t end)
             {
-                const auto &dq0 = finalBoneTransforms[vert.boneIndices[0]];
-                const auto &dq1 = finalBoneTransforms[vert.boneIndices[1]];
-                const auto &q0  = dq0.real;
-                const auto &q1  = dq1.real;
+                GLMMD_TRACE_SCOPE("skinning chunk");
 
-                float w0 = vert.boneWeights[0];
-                float w1 = 1.f - w0;
+                const auto *types   = skinning.types.data();
+                const auto *weights = skinning.boneWeights.data();
+                const auto *normals = skinning.normals.data();
+                const auto *boneDqs = finalBoneTransforms.data();
+                auto       *target  = renderData.skinningTarget();
 
-                auto q = glm::slerp(q0, q1, w1);
+                auto sdef = std::lower_bound(
+                    skinning.sdef.begin(), skinning.sdef.end(), begin,
+                    [](const SkinningData::Sdef &s, size_t i)
+                    { return s.vertex < i; });
 
-                const auto &c = vert.sdefC;
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const auto *bones = boneIndices + i * 4;
+                    const auto *w     = weights + i * 4;
+                    auto        type  = types[i];
 
-                auto r = 0.5f * (vert.sdefR0 - vert.sdefR1);
+                    // Morphs move positions only, normals start at rest
+                    auto pos  = renderData.getVertexPosition(i);
+                    auto norm = normals[i];
 
-                pos = q * (pos - c) + (dq0 * (c + w1 * r)) * w0 +
-                      (dq1 * (c - w0 * r)) * w1;
-                norm = q * norm;
-            }
-            else
-            {
-                int nb =
-                    vert.skinningType == VertexSkinningType::BDEF1
-                        ? 1
-                        : (vert.skinningType == VertexSkinningType::BDEF2 ? 2
-                                                                          : 4);
+                    if (type == VertexSkinningType::SDEF)
+                    {
+                        const auto &dq0 = boneDqs[bones[0]];
+                        const auto &dq1 = boneDqs[bones[1]];
+                        const auto &q0  = dq0.real;
+                        const auto &q1  = dq1.real;
 
-                glm::dualquat dq = finalBoneTransforms[vert.boneIndices[0]];
-                auto          q0 = dq.real;
+                        float w0 = SkinningData::unpackWeight(w[0]);
+                        float w1 = 1.f - w0;
 
-                if (nb > 1)
-                {
-                    dq *= vert.boneWeights[0];
-                    for (int bi = 1; bi < nb; ++bi)
+                        auto q = glm::slerp(q0, q1, w1);
+
+                        const auto &c = sdef->c;
+                        const auto &r = sdef->r;
+                        ++sdef;
+
+                        pos = q * (pos - c) + (dq0 * (c + w1 * r)) * w0 +
+                              (dq1 * (c - w0 * r)) * w1;
+                        norm = q * norm;
+                    }
+                    else
                     {
-                        float w = vert.boneWeights[bi];
-                        if (glm::dot(q0,
-                                     finalBoneTransforms[vert.boneIndices[bi]]
-                                         .real) < 0)
-                            w = -w;
-                        dq = dq + w * finalBoneTransforms[vert.boneIndices[bi]];
+                        int nb = type == VertexSkinningType::BDEF1   ? 1
+                                 : type == VertexSkinningType::BDEF2 ? 2
+                                                                     : 4;
+
+                        glm::dualquat dq = boneDqs[bones[0]];
+                        auto          q0 = dq.real;
+
+                        if (nb > 1)
+                        {
+                            dq *= SkinningData::unpackWeight(w[0]);
+                            for (int bi = 1; bi < nb; ++bi)
+                            {
+                                const auto &dqi = boneDqs[bones[bi]];
+                                float wi = SkinningData::unpackWeight(w[bi]);
+                                if (glm::dot(q0, dqi.real) < 0)
+                                    wi = -wi;
+                                dq = dq + wi * dqi;
+                            }
+
+                            dq = glm::normalize(dq);
+                        }
+
+                        pos  = dq * pos;
+                        norm = dq.real * norm;
                     }
 
-                    dq = glm::normalize(dq);
+                    renderData.writeSkinnedVertex(target, i, pos, norm);
                 }
+            });
+    };
 
-                pos  = dq * pos;
-                norm = dq.real * norm;
-            }
-
-            renderData.setVertexPosition(i, pos);
-            renderData.setVertexNormal(i, norm);
-        });
+    if (!skinning.boneIndices16.empty())
+        skin(skinning.boneIndices16.data());
+    else
+        skin(skinning.boneIndices32.data());
 }
 
 void ModelPose::blendWith(const ModelPose &other, float t)
@@ -1,7 +1,11 @@
 #include <algorithm>
 #include <numeric>
 
+#include <glm/gtx/euler_angles.hpp>
+
 #include <glmmd/core/ModelPoseSolver.h>
+#include <glmmd/core/ParallelForEach.h>
+#include <glmmd/core/Trace.h>
 
 namespace glmmd
 {
@@ -38,6 +42,7 @@ void ModelPoseSolver::create(const std::shared_ptr<const ModelData> &modelData)
     }
 
     sortBoneDeformOrder();
+    createPhysicsSync();
 }
 
 void ModelPoseSolver::sortBoneDeformOrder()
@@ -98,6 +103,8 @@ void ModelPoseSolver::sortBoneDeformOrder()
 
 void ModelPoseSolver::solveBeforePhysics(ModelPose &pose) const
 {
+    GLMMD_TRACE_SCOPE("solveBeforePhysics");
+
     applyGroupMorphs(pose);
     applyBoneMorphs(pose);
 
@@ -112,6 +119,8 @@ void ModelPoseSolver::solveBeforePhysics(ModelPose &pose) const
 
 void ModelPoseSolver::solveAfterPhysics(ModelPose &pose) const
 {
+    GLMMD_TRACE_SCOPE("solveAfterPhysics");
+
     for (const auto &[first, last] : m_updateAfterPhysicsRanges)
     {
         solveGlobalBoneTransforms(pose, first, last);
@@ -121,106 +130,119 @@ void ModelPoseSolver::solveAfterPhysics(ModelPose &pose) const
     }
 }
 
-#ifndef GLMMD_DONT_USE_BULLET
-static btTransform glm2bt(const Transform &t)
+void ModelPoseSolver::createPhysicsSync()
 {
-    btTransform transform;
-    transform.setRotation(
-        btQuaternion(t.rotation.x, t.rotation.y, t.rotation.z, t.rotation.w));
-    transform.setOrigin(
-        btVector3(t.translation.x, t.translation.y, t.translation.z));
-    return transform;
-}
+    const auto &bones = m_modelData->bones;
 
-static Transform bt2glm(const btTransform &t)
-{
-    auto o = t.getOrigin();
-    auto q = t.getRotation();
+    m_staticBodySync.clear();
+    m_dynamicBodySync.clear();
+    m_physicsSweep.clear();
 
-    Transform transform{.translation = glm::vec3(o.x(), o.y(), o.z()),
-                        .rotation    = glm::quat(q.w(), q.x(), q.y(), q.z())};
-    return transform;
-}
-#endif
+    std::vector<uint8_t> driven(bones.size(), 0);
+    for (uint32_t i = 0; i < m_modelData->rigidBodies.size(); ++i)
+    {
+        const auto &rigidBody = m_modelData->rigidBodies[i];
+        if (rigidBody.boneIndex < 0)
+            continue;
+        auto bone = static_cast<uint32_t>(rigidBody.boneIndex);
 
-void ModelPoseSolver::syncStaticRigidBodyTransforms(const ModelPose     &pose,
-                                                    const RigidBodyData &rb,
-                                                    int32_t bi) const
-{
-#ifndef GLMMD_DONT_USE_BULLET
-    Transform t = rb.offset;
-    t.translation -= m_modelData->bones[bi].position;
-    t *= pose.m_globalBoneTransforms[bi];
-    rb.motionState->setWorldTransform(glm2bt(t));
-#endif
-}
+        Transform offset{
+            .translation = rigidBody.position - bones[bone].position,
+            .rotation    = glm::quat_cast(
+                glm::eulerAngleYXZ(rigidBody.rotation.y, rigidBody.rotation.x,
+                                   rigidBody.rotation.z))};
 
-void ModelPoseSolver::syncDynamicRigidBodyTransforms(ModelPose           &pose,
-                                                     const RigidBodyData &rb,
-                                                     int32_t bi) const
-{
-#ifndef GLMMD_DONT_USE_BULLET
-    btTransform transform;
-    rb.motionState->getWorldTransform(transform);
-    Transform t = rb.offset;
-    t.translation -= m_modelData->bones[bi].position;
-    pose.m_globalBoneTransforms[bi] = t.inverse() * bt2glm(transform);
-
-// for (auto k : m_boneChildren[bi])
-//     solveChildGlobalBoneTransforms(pose, k);
-#endif
+        switch (rigidBody.physicsCalcType)
+        {
+        case PhysicsCalcType::Static:
+            m_staticBodySync.push_back({i, bone, offset});
+            break;
+        case PhysicsCalcType::Dynamic:
+            m_dynamicBodySync.push_back({i, bone, offset.inverse()});
+            driven[bone] = 1;
+            break;
+        case PhysicsCalcType::Mixed:
+            offset.rotation = glm::inverse(offset.rotation);
+            m_physicsSweep.push_back({i, bone, offset});
+            driven[bone] = 1;
+            break;
+        }
+    }
+
+    // Bones below dynamic or mixed bodies follow them, unless driven by a
+    // body themselves or deformed after physics
+    std::vector<uint8_t>  below(bones.size(), 0);
+    std::vector<uint32_t> stack;
+    for (uint32_t i = 0; i < bones.size(); ++i)
+        if (driven[i])
+            stack.insert(stack.end(), m_boneChildren[i].begin(),
+                         m_boneChildren[i].end());
+    while (!stack.empty())
+    {
+        uint32_t i = stack.back();
+        stack.pop_back();
+        if (below[i])
+            continue;
+        below[i] = 1;
+        stack.insert(stack.end(), m_boneChildren[i].begin(),
+                     m_boneChildren[i].end());
+    }
+    for (uint32_t i = 0; i < bones.size(); ++i)
+        if (below[i] && !driven[i] && !bones[i].deformAfterPhysics())
+            m_physicsSweep.push_back({NO_BODY, i, Transform::identity});
+
+    std::vector<uint32_t> deformPosition(bones.size());
+    for (uint32_t k = 0; k < m_boneDeformOrder.size(); ++k)
+        deformPosition[m_boneDeformOrder[k]] = k;
+    std::stable_sort(
+        m_physicsSweep.begin(), m_physicsSweep.end(),
+        [&](const BodySync &a, const BodySync &b)
+        { return deformPosition[a.bone] < deformPosition[b.bone]; });
 }
 
-void ModelPoseSolver::syncMixedRigidBodyTransforms(ModelPose           &pose,
-                                                   const RigidBodyData &rb,
-                                                   int32_t bi) const
+void ModelPoseSolver::syncWithPhysics(ModelPose    &pose,
+                                      ModelPhysics &physics) const
 {
-#ifndef GLMMD_DONT_USE_BULLET
-    btTransform transform;
-    rb.motionState->getWorldTransform(transform);
+    GLMMD_TRACE_SCOPE("syncWithPhysics");
 
-    auto      q        = transform.getRotation();
-    glm::quat rotation = glm::quat(q.w(), q.x(), q.y(), q.z()) *
-                         glm::inverse(rb.offset.rotation);
-    pose.m_globalBoneTransforms[bi].rotation = rotation;
+    if (physics.rigidBodies.empty())
+        return;
 
-    glm::vec3 translation =
-        pose.m_globalBoneTransforms[bi] *
-        (rb.offset.translation - m_modelData->bones[bi].position);
+    auto &globals    = pose.m_globalBoneTransforms;
+    auto &transforms = physics.bodyTransforms;
 
-    transform.setOrigin(btVector3(translation.x, translation.y, translation.z));
-    rb.motionState->setWorldTransform(transform);
+    constexpr size_t syncGrain = 256;
 
-// for (auto k : m_boneChildren[bi])
-//     solveChildGlobalBoneTransforms(pose, k);
-#endif
-}
+    parallelFor(0, m_staticBodySync.size(), syncGrain,
+                [&](size_t i)
+                {
+                    const auto &s      = m_staticBodySync[i];
+                    transforms[s.body] = s.offset * globals[s.bone];
+                });
 
-void ModelPoseSolver::syncWithPhysics(ModelPose    &pose,
-                                      ModelPhysics &physics) const
-{
-    for (size_t i = 0; i < physics.rigidBodies.size(); ++i)
+    for (const auto &s : m_dynamicBodySync)
+        globals[s.bone] = s.offset * transforms[s.body];
+
+    for (const auto &s : m_physicsSweep)
     {
-        auto   &rb = physics.rigidBodies[i];
-        int32_t j  = m_modelData->rigidBodies[i].boneIndex;
-        if (j < 0)
+        solveGlobalBoneTransform(pose, s.bone);
+        if (s.body == NO_BODY)
             continue;
 
-        switch (m_modelData->rigidBodies[i].physicsCalcType)
-        {
-        case PhysicsCalcType::Static:
-            syncStaticRigidBodyTransforms(pose, rb, j);
-            break;
-        case PhysicsCalcType::Dynamic:
-            syncDynamicRigidBodyTransforms(pose, rb, j);
-            break;
-        case PhysicsCalcType::Mixed:
-            syncMixedRigidBodyTransforms(pose, rb, j);
-            break;
-        }
+        globals[s.bone].rotation =
+            transforms[s.body].rotation * s.offset.rotation;
+        transforms[s.body].translation =
+            globals[s.bone] * s.offset.translation;
     }
 }
 
+void ModelPoseSolver::solveBonesBelowPhysics(ModelPose &pose) const
+{
+    for (const auto &s : m_physicsSweep)
+        if (s.body == NO_BODY)
+            solveGlobalBoneTransform(pose, s.bone);
+}
+
 void ModelPoseSolver::applyGroupMorphs(ModelPose &pose) const
 {
     for (uint32_t i = 0; i < pose.m_morphRatios.size(); ++i)
@@ -229,9 +251,8 @@ void ModelPoseSolver::applyGroupMorphs(ModelPose &pose) const
         if (pose.m_morphRatios[i] == 0.f || morph.type != MorphType::Group)
             continue;
 
-        for (int32_t j = 0; j < morph.count; ++j)
+        for (const auto &m : m_modelData->groupMorphs(morph))
         {
-            const auto &m = morph.group[j];
             if (m_modelData->morphs[m.index].type != MorphType::Group)
                 pose.m_morphRatios[m.index] += pose.m_morphRatios[i] * m.ratio;
         }
@@ -245,9 +266,8 @@ void ModelPoseSolver::applyBoneMorphs(ModelPose &pose) const
         const auto &morph = m_modelData->morphs[i];
         if (morph.type == MorphType::Bone && pose.m_morphRatios[i] != 0.f)
         {
-            for (int32_t j = 0; j < morph.count; ++j)
+            for (const auto &boneMorph : m_modelData->boneMorphs(morph))
             {
-                const auto &boneMorph = morph.bone[j];
                 pose.m_localBoneTransforms[boneMorph.index] *=
                     pose.m_morphRatios[i] *
                     Transform{.translation = boneMorph.translation,
@@ -260,6 +280,8 @@ void ModelPoseSolver::applyBoneMorphs(ModelPose &pose) const
 void ModelPoseSolver::solveIK(ModelPose &pose, uint32_t first,
                               uint32_t last) const
 {
+    GLMMD_TRACE_SCOPE("solveIK");
+
     for (; first != last; ++first)
     {
         const auto &bone = m_modelData->bones[m_boneDeformOrder[first]];
@@ -346,9 +368,8 @@ void ModelPoseSolver::solveIK(ModelPose &pose, uint32_t first,
     }
 }
 
-bool ModelPoseSolver::solveChildGlobalBoneTransforms(ModelPose &pose,
-                                                     uint32_t   boneIndex,
-                                                     int32_t    stop) const
+void ModelPoseSolver::solveGlobalBoneTransform(ModelPose &pose,
+                                               uint32_t   boneIndex) const
 {
     const auto &bone                   = m_modelData->bones[boneIndex];
     glm::vec3   localTranslationOffset = bone.position;
@@ -361,6 +382,13 @@ bool ModelPoseSolver::solveChildGlobalBoneTransforms(ModelPose &pose,
             localTransform * pose.m_globalBoneTransforms[bone.parentIndex];
     else
         pose.m_globalBoneTransforms[boneIndex] = localTransform;
+}
+
+bool ModelPoseSolver::solveChildGlobalBoneTransforms(ModelPose &pose,
+                                                     uint32_t   boneIndex,
+                                                     int32_t    stop) const
+{
+    solveGlobalBoneTransform(pose, boneIndex);
 
     if (boneIndex == static_cast<uint32_t>(stop))
         return false;
@@ -375,24 +403,7 @@ void ModelPoseSolver::solveGlobalBoneTransforms(ModelPose &pose, uint32_t first,
                                                 uint32_t last) const
 {
     for (; first < last; ++first)
-    {
-        uint32_t i = m_boneDeformOrder[first];
-
-        const auto &bone = m_modelData->bones[i];
-
-        glm::vec3 localTranslationOffset = bone.position;
-        if (bone.parentIndex != -1)
-            localTranslationOffset -=
-                m_modelData->bones[bone.parentIndex].position;
-
-        Transform localTransform = pose.m_localBoneTransforms[i];
-        localTransform.translation += localTranslationOffset;
-        if (bone.parentIndex != -1)
-            pose.m_globalBoneTransforms[i] =
-                localTransform * pose.m_globalBoneTransforms[bone.parentIndex];
-        else
-            pose.m_globalBoneTransforms[i] = localTransform;
-    }
+        solveGlobalBoneTransform(pose, m_boneDeformOrder[first]);
 }
 
 void ModelPoseSolver::updateInheritedBoneTransforms(ModelPose &pose,
@@ -1,9 +1,10 @@
 #include <algorithm>
-#ifndef GLMMD_DONT_PARALLELIZE
-#include <execution>
-#endif
+#include <bit>
+#include <stdexcept>
 
 #include <glmmd/core/ModelRenderData.h>
+#include <glmmd/core/ParallelForEach.h>
+#include <glmmd/core/VertexPacking.h>
 
 namespace glmmd
 {
@@ -34,51 +35,88 @@ void MaterialFactors::initMul()
     toonTexture   = glm::vec4(1.f);
 }
 
-ModelRenderData::ModelRenderData(const std::shared_ptr<const ModelData> &data)
+ModelRenderData::ModelRenderData(const std::shared_ptr<const ModelData> &data,
+                                 VertexLayout                            layout)
 {
-    create(data);
+    create(data, layout);
 }
 
-void ModelRenderData::create(const std::shared_ptr<const ModelData> &data)
+void ModelRenderData::create(const std::shared_ptr<const ModelData> &data,
+                             VertexLayout                            layout)
 {
     if (!data)
         return;
 
-    m_data = data;
+    m_data             = data;
+    m_layout           = layout;
+    m_uvsMorphed       = false;
+    m_materialsMorphed = false;
 
-    stride = 3 + 3 + 2 + 4 * data->info.additionalUVNum;
-    vertexBuffer.resize(data->vertices.size() * stride);
-    materials.resize(data->materials.size());
-    m_initialVertexBuffer.resize(data->vertices.size() * stride);
+    m_initialVertexBuffer = data->restVertexBuffer();
 
-    for (size_t i = 0; i < m_data->vertices.size(); ++i)
+    size_t restStride = data->restVertexStride();
+    if (layout != VertexLayout::Interleaved)
     {
-        const auto &vert = m_data->vertices[i];
-
-        size_t offset = i * stride;
-
-        m_initialVertexBuffer[offset++] = vert.position.x;
-        m_initialVertexBuffer[offset++] = vert.position.y;
-        m_initialVertexBuffer[offset++] = vert.position.z;
-        m_initialVertexBuffer[offset++] = vert.normal.x;
-        m_initialVertexBuffer[offset++] = vert.normal.y;
-        m_initialVertexBuffer[offset++] = vert.normal.z;
-        m_initialVertexBuffer[offset++] = vert.uv.x;
-        m_initialVertexBuffer[offset++] = vert.uv.y;
-        for (uint8_t j = 0; j < data->info.additionalUVNum; ++j)
-            for (uint8_t k = 0; k < 4; ++k)
-                m_initialVertexBuffer[offset++] = data->additionalUVs[i][j][k];
+        constexpr size_t uvGrain = 4096;
+
+        bool compact = layout == VertexLayout::CompactStreams;
+
+        m_initialPositionNormals = data->restPositionNormalBuffer(compact);
+
+        stride   = compact ? 4 : 6;
+        uvStride = compact ? 1 + 2 * data->info.additionalUVNum
+                           : restStride - 6;
+        uvBuffer.resize(data->vertices.size() * uvStride);
+        parallelForChunked(0, data->vertices.size(), uvGrain,
+                           [this](size_t first, size_t last)
+                           {
+                               for (; first != last; ++first)
+                                   resetVertexUVs(first);
+                           });
+        ++uvVersion;
+
+        m_uvMorphVertices.clear();
+        for (const auto &uvMorph : data->morphPools.uv)
+            m_uvMorphVertices.push_back(uvMorph.index);
+        std::sort(m_uvMorphVertices.begin(), m_uvMorphVertices.end());
+        m_uvMorphVertices.erase(std::unique(m_uvMorphVertices.begin(),
+                                            m_uvMorphVertices.end()),
+                                m_uvMorphVertices.end());
+
+        m_uvMorphRestUVs.resize(m_uvMorphVertices.size() * uvStride);
+        for (size_t i = 0; i < m_uvMorphVertices.size(); ++i)
+            std::copy_n(uvBuffer.begin() + m_uvMorphVertices[i] * uvStride,
+                        uvStride, m_uvMorphRestUVs.begin() + i * uvStride);
     }
+    else
+    {
+        m_initialPositionNormals.reset();
+
+        stride   = restStride;
+        uvStride = restStride;
+        uvBuffer.clear();
+        m_uvMorphVertices.clear();
+        m_uvMorphRestUVs.clear();
+    }
+    vertexBuffer.resize(data->vertices.size() * stride);
+    materials.resize(data->materials.size());
+    ++materialVersion;
 }
 
 void ModelRenderData::init()
 {
-    std::copy(
-#ifndef GLMMD_DONT_PARALLELIZE
-        std::execution::par,
-#endif
-        m_initialVertexBuffer.begin(), m_initialVertexBuffer.end(),
-        vertexBuffer.begin());
+    constexpr size_t copyGrain = 1 << 16;
+
+    const auto &initial = m_layout == VertexLayout::Interleaved
+                              ? *m_initialVertexBuffer
+                              : *m_initialPositionNormals;
+    parallelForChunked(0, initial.size(), copyGrain,
+                       [&](size_t first, size_t last)
+                       {
+                           std::copy(initial.begin() + first,
+                                     initial.begin() + last,
+                                     vertexBuffer.begin() + first);
+                       });
 
     for (size_t i = 0; i < m_data->materials.size(); ++i)
     {
@@ -97,6 +135,57 @@ void ModelRenderData::init()
     }
 }
 
+void ModelRenderData::beginUVMorphs(bool active)
+{
+    if (m_layout == VertexLayout::Interleaved)
+        return;
+    if (active || m_uvsMorphed)
+        resetUVs();
+    m_uvsMorphed = active;
+}
+
+void ModelRenderData::beginMaterialMorphs(bool active)
+{
+    if (active || m_materialsMorphed)
+        ++materialVersion;
+    m_materialsMorphed = active;
+}
+
+void ModelRenderData::resetUVs()
+{
+    for (size_t i = 0; i < m_uvMorphVertices.size(); ++i)
+        std::copy_n(m_uvMorphRestUVs.begin() + i * uvStride, uvStride,
+                    uvBuffer.begin() + m_uvMorphVertices[i] * uvStride);
+    ++uvVersion;
+}
+
+void ModelRenderData::resetVertexUVs(size_t index)
+{
+    const float *in = m_initialVertexBuffer->data() +
+                      index * m_data->restVertexStride() + 6;
+    float       *out = uvBuffer.data() + index * uvStride;
+    if (m_layout == VertexLayout::CompactStreams)
+    {
+        for (size_t i = 0; i < uvStride; ++i, in += 2)
+            out[i] = std::bit_cast<float>(
+                glm::packHalf2x16(glm::vec2(in[0], in[1])));
+    }
+    else
+        std::copy_n(in, uvStride, out);
+}
+
+float *ModelRenderData::uvData()
+{
+    return m_layout == VertexLayout::Interleaved ? vertexBuffer.data() + 6
+                                                 : uvBuffer.data();
+}
+
+const float *ModelRenderData::uvData() const
+{
+    return m_layout == VertexLayout::Interleaved ? vertexBuffer.data() + 6
+                                                 : uvBuffer.data();
+}
+
 void ModelRenderData::applyMaterialFactors()
 {
     for (size_t i = 0; i < m_data->materials.size(); ++i)
@@ -125,22 +214,31 @@ glm::vec3 ModelRenderData::getVertexPosition(size_t index) const
 glm::vec3 ModelRenderData::getVertexNormal(size_t index) const
 {
     size_t offset = index * stride + 3;
+    if (m_layout == VertexLayout::CompactStreams)
+        return unpackOctNormal(std::bit_cast<uint32_t>(vertexBuffer[offset]));
     return glm::vec3(vertexBuffer[offset], vertexBuffer[offset + 1],
                      vertexBuffer[offset + 2]);
 }
 
 glm::vec2 ModelRenderData::getVertexUV(size_t index) const
 {
-    size_t offset = index * stride + 6;
-    return glm::vec2(vertexBuffer[offset], vertexBuffer[offset + 1]);
+    const float *uv = uvData() + index * uvStride;
+    if (m_layout == VertexLayout::CompactStreams)
+        return glm::unpackHalf2x16(std::bit_cast<uint32_t>(uv[0]));
+    return glm::vec2(uv[0], uv[1]);
 }
 
 glm::vec4 ModelRenderData::getVertexAdditionalUV(size_t index,
                                                  size_t uvIndex) const
 {
-    size_t offset = index * stride + 8 + 4 * uvIndex;
-    return glm::vec4(vertexBuffer[offset], vertexBuffer[offset + 1],
-                     vertexBuffer[offset + 2], vertexBuffer[offset + 3]);
+    if (m_layout == VertexLayout::CompactStreams)
+    {
+        const float *uv = uvData() + index * uvStride + 1 + 2 * uvIndex;
+        return glm::vec4(glm::unpackHalf2x16(std::bit_cast<uint32_t>(uv[0])),
+                         glm::unpackHalf2x16(std::bit_cast<uint32_t>(uv[1])));
+    }
+    const float *uv = uvData() + index * uvStride + 2 + 4 * uvIndex;
+    return glm::vec4(uv[0], uv[1], uv[2], uv[3]);
 }
 
 void ModelRenderData::setVertexPosition(size_t index, const glm::vec3 &position)
@@ -153,7 +251,12 @@ void ModelRenderData::setVertexPosition(size_t index, const glm::vec3 &position)
 
 void ModelRenderData::setVertexNormal(size_t index, const glm::vec3 &normal)
 {
-    size_t offset            = index * stride + 3;
+    size_t offset = index * stride + 3;
+    if (m_layout == VertexLayout::CompactStreams)
+    {
+        vertexBuffer[offset] = std::bit_cast<float>(packOctNormal(normal));
+        return;
+    }
     vertexBuffer[offset]     = normal.x;
     vertexBuffer[offset + 1] = normal.y;
     vertexBuffer[offset + 2] = normal.z;
@@ -161,19 +264,65 @@ void ModelRenderData::setVertexNormal(size_t index, const glm::vec3 &normal)
 
 void ModelRenderData::setVertexUV(size_t index, const glm::vec2 &uv)
 {
-    size_t offset            = index * stride + 6;
-    vertexBuffer[offset]     = uv.x;
-    vertexBuffer[offset + 1] = uv.y;
+    float *out = uvData() + index * uvStride;
+    if (m_layout == VertexLayout::CompactStreams)
+    {
+        out[0] = std::bit_cast<float>(glm::packHalf2x16(uv));
+        return;
+    }
+    out[0] = uv.x;
+    out[1] = uv.y;
 }
 
 void ModelRenderData::setVertexAdditionalUV(size_t index, size_t uvIndex,
                                             const glm::vec4 &additionalUV)
 {
-    size_t offset            = index * stride + 8 + 4 * uvIndex;
-    vertexBuffer[offset]     = additionalUV.x;
-    vertexBuffer[offset + 1] = additionalUV.y;
-    vertexBuffer[offset + 2] = additionalUV.z;
-    vertexBuffer[offset + 3] = additionalUV.w;
+    if (m_layout == VertexLayout::CompactStreams)
+    {
+        glm::vec2 xy(additionalUV.x, additionalUV.y);
+        glm::vec2 zw(additionalUV.z, additionalUV.w);
+
+        float *out = uvData() + index * uvStride + 1 + 2 * uvIndex;
+        out[0]     = std::bit_cast<float>(glm::packHalf2x16(xy));
+        out[1]     = std::bit_cast<float>(glm::packHalf2x16(zw));
+        return;
+    }
+    float *out = uvData() + index * uvStride + 2 + 4 * uvIndex;
+    out[0]     = additionalUV.x;
+    out[1]     = additionalUV.y;
+    out[2]     = additionalUV.z;
+    out[3]     = additionalUV.w;
+}
+
+void ModelRenderData::setSkinningTarget(float *target)
+{
+    if (target && m_layout == VertexLayout::Interleaved)
+        throw std::runtime_error(
+            "Skinning targets need a stream vertex layout.");
+    m_skinningTarget = target;
+}
+
+float *ModelRenderData::skinningTarget()
+{
+    return m_skinningTarget ? m_skinningTarget : vertexBuffer.data();
+}
+
+void ModelRenderData::writeSkinnedVertex(float *target, size_t index,
+                                         const glm::vec3 &position,
+                                         const glm::vec3 &normal) const
+{
+    float *out = target + index * stride;
+    out[0]     = position.x;
+    out[1]     = position.y;
+    out[2]     = position.z;
+    if (m_layout == VertexLayout::CompactStreams)
+    {
+        out[3] = std::bit_cast<float>(packOctNormal(normal));
+        return;
+    }
+    out[3] = normal.x;
+    out[4] = normal.y;
+    out[5] = normal.z;
 }
 
 } // namespace glmmd
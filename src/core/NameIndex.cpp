@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <numeric>
+#include <unordered_set>
+
+#include <glmmd/core/NameIndex.h>
+
+namespace glmmd
+{
+
+// Buckets of a single key store their slot directly
+constexpr uint32_t DIRECT_SLOT = 0x80000000u;
+
+// Tried per bucket before starting over with another salt
+constexpr uint32_t MAX_DISPLACEMENT = 1u << 16;
+
+static uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static size_t bucketOf(uint64_t h, size_t bucketCount)
+{
+    return mix(h) % bucketCount;
+}
+
+static size_t slotOf(uint64_t h, uint32_t displacement, size_t slotCount)
+{
+    if (displacement & DIRECT_SLOT)
+        return displacement & ~DIRECT_SLOT;
+    return mix(h + displacement * 0x9E3779B97F4A7C15ull) % slotCount;
+}
+
+NameIndex::NameIndex(std::span<const std::string_view> names)
+    : m_elementCount(names.size())
+{
+    std::unordered_set<std::string_view> unique;
+    std::vector<Key>                     keys;
+    for (uint32_t i = 0; i < names.size(); ++i)
+    {
+        if (!unique.insert(names[i]).second)
+            continue;
+        keys.push_back({static_cast<uint32_t>(m_chars.size()),
+                        static_cast<uint32_t>(names[i].size()), i});
+        m_chars += names[i];
+    }
+
+    for (uint64_t salt = 0; !build(keys, salt); ++salt)
+        ;
+}
+
+bool NameIndex::build(const std::vector<Key> &keys, uint64_t salt)
+{
+    m_salt = salt;
+
+    size_t n           = keys.size();
+    size_t bucketCount = std::max<size_t>(n / 2, 1);
+    m_displacements.assign(n == 0 ? 0 : bucketCount, 0);
+    m_slots.assign(n, Key{0, 0, NOT_FOUND});
+    if (n == 0)
+        return true;
+
+    std::vector<uint64_t>              hashes(n);
+    std::vector<std::vector<uint32_t>> buckets(bucketCount);
+    for (uint32_t k = 0; k < n; ++k)
+    {
+        hashes[k] = hash(std::string_view(m_chars).substr(keys[k].offset,
+                                                          keys[k].length));
+        buckets[bucketOf(hashes[k], bucketCount)].push_back(k);
+    }
+
+    // Largest buckets first, while most slots are free
+    std::vector<uint32_t> order(bucketCount);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b)
+                     { return buckets[a].size() > buckets[b].size(); });
+
+    std::vector<bool>   used(n);
+    std::vector<size_t> slots;
+    size_t              nextFree = 0;
+    for (auto b : order)
+    {
+        const auto &bucket = buckets[b];
+        if (bucket.empty())
+            break;
+
+        if (bucket.size() == 1)
+        {
+            while (used[nextFree])
+                ++nextFree;
+            m_displacements[b] = DIRECT_SLOT | static_cast<uint32_t>(nextFree);
+            used[nextFree]     = true;
+            m_slots[nextFree]  = keys[bucket[0]];
+            continue;
+        }
+
+        uint32_t d = 0;
+        for (; d < MAX_DISPLACEMENT; ++d)
+        {
+            slots.clear();
+            for (auto k : bucket)
+            {
+                auto s = slotOf(hashes[k], d, n);
+                if (used[s] ||
+                    std::find(slots.begin(), slots.end(), s) != slots.end())
+                    break;
+                slots.push_back(s);
+            }
+            if (slots.size() == bucket.size())
+                break;
+        }
+        if (d == MAX_DISPLACEMENT)
+            return false;
+
+        m_displacements[b] = d;
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            used[slots[i]]    = true;
+            m_slots[slots[i]] = keys[bucket[i]];
+        }
+    }
+    return true;
+}
+
+uint64_t NameIndex::hash(std::string_view name) const
+{
+    // FNV-1a
+    uint64_t h = 0xCBF29CE484222325ull ^ m_salt;
+    for (char c : name)
+        h = (h ^ static_cast<uint8_t>(c)) * 0x100000001B3ull;
+    return h;
+}
+
+uint32_t NameIndex::find(std::string_view name) const
+{
+    if (m_slots.empty())
+        return NOT_FOUND;
+
+    auto        h   = hash(name);
+    auto        d   = m_displacements[bucketOf(h, m_displacements.size())];
+    const auto &key = m_slots[slotOf(h, d, m_slots.size())];
+    if (std::string_view(m_chars).substr(key.offset, key.length) != name)
+        return NOT_FOUND;
+    return key.index;
+}
+
+} // namespace glmmd
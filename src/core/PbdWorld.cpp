@@ -0,0 +1,1470 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+#include <glm/gtx/euler_angles.hpp>
+
+#include <glmmd/core/ParallelForEach.h>
+#include <glmmd/core/PbdWorld.h>
+#include <glmmd/core/Trace.h>
+
+namespace glmmd
+{
+
+constexpr float GRAVITY_SCALE = 12.5f;
+
+constexpr uint32_t NO_BODY = ~0u;
+
+constexpr uint16_t GROUND_GROUP = 1 << 15;
+constexpr uint16_t GROUND_MASK  = 0x7FFF;
+
+constexpr float CONTACT_MARGIN = 0.1f;
+
+// Angular limits and contacts are soft like Bullet's, violations decay at
+// this rate (1/s). Hard ones make chains resting against them jitter.
+constexpr float LIMIT_RATE = 60.f;
+
+// Joint separations above this refine the substeps, below half of it
+// coarsen them. Violated angular limits are not counted, being soft they do
+// not depend on the substeps.
+constexpr float MAX_JOINT_ERROR = 0.1f;
+// Motion of a body per substep relative to its radius
+constexpr float MAX_SUBSTEP_MOTION = 0.5f;
+
+// Bodies slower than this, at any point, are at rest
+constexpr float SLEEP_SPEED = 0.1f;
+constexpr float SLEEP_TIME  = 1.f;
+// Kinematic bodies moving less than this do not wake up a model
+constexpr float WAKE_DISTANCE = 1e-4f;
+constexpr float WAKE_ANGLE    = 1e-4f;
+
+static uint64_t pairKey(uint32_t a, uint32_t b)
+{
+    if (a > b)
+        std::swap(a, b);
+    return static_cast<uint64_t>(a) << 32 | b;
+}
+
+// Rotates q by the small rotation vector v
+static void rotate(glm::quat &q, const glm::vec3 &v)
+{
+    q = glm::normalize(q + 0.5f * glm::quat(0.f, v.x, v.y, v.z) * q);
+}
+
+static void closestPoints(const glm::vec3 &p1, const glm::vec3 &q1,
+                          const glm::vec3 &p2, const glm::vec3 &q2,
+                          glm::vec3 &c1, glm::vec3 &c2)
+{
+    constexpr float EPS = 1e-8f;
+
+    glm::vec3 d1 = q1 - p1;
+    glm::vec3 d2 = q2 - p2;
+    glm::vec3 r  = p1 - p2;
+    float     a  = glm::dot(d1, d1);
+    float     e  = glm::dot(d2, d2);
+    float     f  = glm::dot(d2, r);
+
+    float s = 0.f, t = 0.f;
+    if (a <= EPS && e <= EPS)
+    {
+    }
+    else if (a <= EPS)
+        t = std::clamp(f / e, 0.f, 1.f);
+    else
+    {
+        float c = glm::dot(d1, r);
+        if (e <= EPS)
+            s = std::clamp(-c / a, 0.f, 1.f);
+        else
+        {
+            float b     = glm::dot(d1, d2);
+            float denom = a * e - b * b;
+            if (denom > EPS)
+                s = std::clamp((b * f - c * e) / denom, 0.f, 1.f);
+            t = (b * s + f) / e;
+            if (t < 0.f)
+            {
+                t = 0.f;
+                s = std::clamp(-c / a, 0.f, 1.f);
+            }
+            else if (t > 1.f)
+            {
+                t = 1.f;
+                s = std::clamp((b - c) / a, 0.f, 1.f);
+            }
+        }
+    }
+    c1 = p1 + d1 * s;
+    c2 = p2 + d2 * t;
+}
+
+// Joints are solved in batches of LANES joints, with one float per joint in
+// each lane. Lane operations are loops over fixed size arrays without
+// branches, which compilers turn into SIMD instructions.
+constexpr size_t LANES = 8;
+
+struct Lane
+{
+    float v[LANES];
+
+    Lane() = default;
+    Lane(float f) { std::fill_n(v, LANES, f); }
+
+    float  operator[](size_t l) const { return v[l]; }
+    float &operator[](size_t l) { return v[l]; }
+};
+
+template <typename Op>
+static Lane map(const Lane &a, Op op)
+{
+    Lane r;
+    for (size_t l = 0; l < LANES; ++l)
+        r[l] = op(a[l]);
+    return r;
+}
+
+template <typename Op>
+static Lane map(const Lane &a, const Lane &b, Op op)
+{
+    Lane r;
+    for (size_t l = 0; l < LANES; ++l)
+        r[l] = op(a[l], b[l]);
+    return r;
+}
+
+static Lane operator+(const Lane &a, const Lane &b)
+{
+    return map(a, b, [](float x, float y) { return x + y; });
+}
+
+static Lane operator-(const Lane &a, const Lane &b)
+{
+    return map(a, b, [](float x, float y) { return x - y; });
+}
+
+static Lane operator*(const Lane &a, const Lane &b)
+{
+    return map(a, b, [](float x, float y) { return x * y; });
+}
+
+static Lane operator/(const Lane &a, const Lane &b)
+{
+    return map(a, b, [](float x, float y) { return x / y; });
+}
+
+static Lane operator-(const Lane &a)
+{
+    return map(a, [](float x) { return -x; });
+}
+
+// Masks are 1 in the lanes where they are set, 0 elsewhere
+static Lane operator>(const Lane &a, const Lane &b)
+{
+    return map(a, b, [](float x, float y) { return x > y ? 1.f : 0.f; });
+}
+
+static Lane operator!=(const Lane &a, const Lane &b)
+{
+    return map(a, b, [](float x, float y) { return x != y ? 1.f : 0.f; });
+}
+
+static Lane select(const Lane &mask, const Lane &a, const Lane &b)
+{
+    Lane r;
+    for (size_t l = 0; l < LANES; ++l)
+    {
+        // Both loaded up front, so that this becomes a blend
+        float x = a[l];
+        float y = b[l];
+        r[l]    = mask[l] != 0.f ? x : y;
+    }
+    return r;
+}
+
+static bool any(const Lane &mask)
+{
+    float r = 0.f;
+    for (size_t l = 0; l < LANES; ++l)
+        r = std::max(r, mask[l]);
+    return r != 0.f;
+}
+
+static Lane min(const Lane &a, const Lane &b)
+{
+    return map(a, b, [](float x, float y) { return std::min(x, y); });
+}
+
+static Lane max(const Lane &a, const Lane &b)
+{
+    return map(a, b, [](float x, float y) { return std::max(x, y); });
+}
+
+static Lane sqrt(const Lane &a)
+{
+    return map(a, [](float x) { return std::sqrt(x); });
+}
+
+// Polynomial approximations, branch free unlike the ones of the C library.
+// atan2 (Abramowitz and Stegun 4.4.49) is off by at most 2e-8 rad, sin and
+// cos by at most 6e-8 in [-pi/2, pi/2].
+static Lane atan2(const Lane &y, const Lane &x)
+{
+    Lane r;
+    for (size_t l = 0; l < LANES; ++l)
+    {
+        float ax = std::abs(x[l]);
+        float ay = std::abs(y[l]);
+        float lo = std::min(ax, ay);
+        float hi = std::max(ax, ay);
+        float t  = hi > 0.f ? lo / hi : 0.f;
+        float s  = t * t;
+        float a  = 0.0028662257f;
+        a        = a * s - 0.0161657367f;
+        a        = a * s + 0.0429096138f;
+        a        = a * s - 0.0752896400f;
+        a        = a * s + 0.1065626393f;
+        a        = a * s - 0.1420889944f;
+        a        = a * s + 0.1999355085f;
+        a        = a * s - 0.3333314528f;
+        a        = (a * s + 1.f) * t;
+        a        = ay > ax ? 1.57079637f - a : a;
+        a        = x[l] < 0.f ? 3.14159274f - a : a;
+        r[l]     = y[l] < 0.f ? -a : a;
+    }
+    return r;
+}
+
+static void sinCos(const Lane &x, Lane &sin, Lane &cos)
+{
+    for (size_t l = 0; l < LANES; ++l)
+    {
+        float t = x[l];
+        float s = t * t;
+        sin[l]  = t * (1.f +
+                      s * (-1.f / 6.f +
+                           s * (1.f / 120.f +
+                                s * (-1.f / 5040.f +
+                                     s * (1.f / 362880.f +
+                                          s * (-1.f / 39916800.f))))));
+        cos[l]  = 1.f +
+                 s * (-0.5f +
+                      s * (1.f / 24.f +
+                           s * (-1.f / 720.f +
+                                s * (1.f / 40320.f +
+                                     s * (-1.f / 3628800.f +
+                                          s * (1.f / 479001600.f))))));
+    }
+}
+
+struct Vec3Lanes
+{
+    Lane x, y, z;
+};
+
+static Vec3Lanes operator+(const Vec3Lanes &a, const Vec3Lanes &b)
+{
+    return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+static Vec3Lanes operator-(const Vec3Lanes &a, const Vec3Lanes &b)
+{
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static Vec3Lanes operator*(const Vec3Lanes &a, const Vec3Lanes &b)
+{
+    return {a.x * b.x, a.y * b.y, a.z * b.z};
+}
+
+static Vec3Lanes operator*(const Vec3Lanes &a, const Lane &s)
+{
+    return {a.x * s, a.y * s, a.z * s};
+}
+
+static Vec3Lanes operator-(const Vec3Lanes &a)
+{
+    return {-a.x, -a.y, -a.z};
+}
+
+static Lane dot(const Vec3Lanes &a, const Vec3Lanes &b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static Vec3Lanes cross(const Vec3Lanes &a, const Vec3Lanes &b)
+{
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+            a.x * b.y - a.y * b.x};
+}
+
+static Vec3Lanes clamp(const Vec3Lanes &v, const Vec3Lanes &lo,
+                       const Vec3Lanes &hi)
+{
+    return {min(max(v.x, lo.x), hi.x), min(max(v.y, lo.y), hi.y),
+            min(max(v.z, lo.z), hi.z)};
+}
+
+struct QuatLanes
+{
+    Lane w, x, y, z;
+};
+
+static QuatLanes operator*(const QuatLanes &a, const QuatLanes &b)
+{
+    return {a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+            a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+            a.w * b.y + a.y * b.w + a.z * b.x - a.x * b.z,
+            a.w * b.z + a.z * b.w + a.x * b.y - a.y * b.x};
+}
+
+static QuatLanes conjugate(const QuatLanes &q)
+{
+    return {q.w, -q.x, -q.y, -q.z};
+}
+
+static QuatLanes select(const Lane &mask, const QuatLanes &a,
+                        const QuatLanes &b)
+{
+    return {select(mask, a.w, b.w), select(mask, a.x, b.x),
+            select(mask, a.y, b.y), select(mask, a.z, b.z)};
+}
+
+// Rotates v by the unit quaternion q
+static Vec3Lanes operator*(const QuatLanes &q, const Vec3Lanes &v)
+{
+    Vec3Lanes u{q.x, q.y, q.z};
+    Vec3Lanes uv  = cross(u, v);
+    Vec3Lanes uuv = cross(u, uv);
+    return v + (uv * q.w + uuv) * Lane(2.f);
+}
+
+// Rotates q by the small rotation vector v, like rotate() above
+static QuatLanes rotate(const QuatLanes &q, const Vec3Lanes &v)
+{
+    Vec3Lanes u{q.x, q.y, q.z};
+    Vec3Lanes d = (v * q.w + cross(v, u)) * Lane(0.5f);
+    QuatLanes r{q.w - Lane(0.5f) * dot(v, u), q.x + d.x, q.y + d.y,
+                q.z + d.z};
+    Lane invLength =
+        Lane(1.f) / sqrt(r.w * r.w + r.x * r.x + r.y * r.y + r.z * r.z);
+    return {r.w * invLength, r.x * invLength, r.y * invLength,
+            r.z * invLength};
+}
+
+static Vec3Lanes rotationVector(const QuatLanes &q)
+{
+    Lane      sign = select(Lane(0.f) > q.w, Lane(-1.f), Lane(1.f));
+    Vec3Lanes axis{q.x * sign, q.y * sign, q.z * sign};
+    Lane      s = sqrt(dot(axis, axis));
+    Lane      angle =
+        Lane(2.f) * atan2(s, q.w * sign) / max(s, Lane(1e-6f));
+    return axis * select(Lane(1e-6f) > s, Lane(2.f), angle);
+}
+
+// Angles of the rotation Rx(x) * Ry(y) * Rz(z), which Bullet's 6DOF joints
+// limit
+static Vec3Lanes eulerAnglesXYZ(const QuatLanes &q)
+{
+    Lane one(1.f), two(2.f);
+    Lane m20 = min(max(two * (q.x * q.z + q.w * q.y), -one), one);
+    return {atan2(two * (q.w * q.x - q.y * q.z),
+                  one - two * (q.x * q.x + q.y * q.y)),
+            atan2(m20, sqrt(one - m20 * m20)),
+            atan2(two * (q.w * q.z - q.x * q.y),
+                  one - two * (q.y * q.y + q.z * q.z))};
+}
+
+static QuatLanes eulerAnglesXYZToQuat(const Vec3Lanes &angles)
+{
+    Lane half(0.5f);
+    Lane sx, cx, sy, cy, sz, cz;
+    sinCos(angles.x * half, sx, cx);
+    sinCos(angles.y * half, sy, cy);
+    sinCos(angles.z * half, sz, cz);
+    return {cx * cy * cz - sx * sy * sz, sx * cy * cz + cx * sy * sz,
+            cx * sy * cz - sx * cy * sz, cx * cy * sz + sx * sy * cz};
+}
+
+// Symmetric, only the upper triangle is stored
+struct Mat3Lanes
+{
+    Lane xx, xy, xz, yy, yz, zz;
+};
+
+static Vec3Lanes operator*(const Mat3Lanes &m, const Vec3Lanes &v)
+{
+    return {m.xx * v.x + m.xy * v.y + m.xz * v.z,
+            m.xy * v.x + m.yy * v.y + m.yz * v.z,
+            m.xz * v.x + m.yz * v.y + m.zz * v.z};
+}
+
+// LANES joints of one color, i.e. without a dynamic body in common, so that
+// they can be solved at once. Unused lanes repeat the first joint.
+struct JointBatch
+{
+    uint32_t count;
+    uint32_t bodiesA[LANES];
+    uint32_t bodiesB[LANES];
+
+    // Joint frames relative to the bodies
+    Vec3Lanes frameTranslationsA;
+    Vec3Lanes frameTranslationsB;
+    QuatLanes frameRotationsA;
+    QuatLanes frameRotationsB;
+
+    Vec3Lanes linearLowerLimits;
+    Vec3Lanes linearUpperLimits;
+    Vec3Lanes angularLowerLimits;
+    Vec3Lanes angularUpperLimits;
+
+    // Spring axes of equal compliance are corrected together, in up to three
+    // groups per joint. The axis masks are 1 for the axes of a group, a
+    // compliance of 0 means no spring.
+    Vec3Lanes linearSpringAxes[3];
+    Vec3Lanes angularSpringAxes[3];
+    Lane      linearCompliances[3];
+    Lane      angularCompliances[3];
+    // Most groups of any joint in the batch
+    int linearSpringGroups;
+    int angularSpringGroups;
+};
+
+// Bodies of a joint batch, gathered from the body arrays
+struct BodyLanes
+{
+    Vec3Lanes position;
+    QuatLanes rotation;
+    Lane      inverseMass;
+    Mat3Lanes inverseInertia;
+};
+
+static void setLane(Vec3Lanes &lanes, size_t l, const glm::vec3 &v)
+{
+    lanes.x[l] = v.x;
+    lanes.y[l] = v.y;
+    lanes.z[l] = v.z;
+}
+
+static void setLane(QuatLanes &lanes, size_t l, const glm::quat &q)
+{
+    lanes.w[l] = q.w;
+    lanes.x[l] = q.x;
+    lanes.y[l] = q.y;
+    lanes.z[l] = q.z;
+}
+
+// Groups the spring axes of a joint by compliance, returns the number of
+// groups
+static int setSprings(Vec3Lanes (&axes)[3], Lane (&compliances)[3], size_t l,
+                      const glm::vec3 &axisCompliances)
+{
+    int       group = 0;
+    glm::vec3 done(0.f);
+    for (int k = 0; k < 3; ++k)
+    {
+        if (axisCompliances[k] == 0.f || done[k] != 0.f)
+            continue;
+        glm::vec3 mask(0.f);
+        for (int m = k; m < 3; ++m)
+            if (axisCompliances[m] == axisCompliances[k])
+            {
+                mask[m] = 1.f;
+                done[m] = 1.f;
+            }
+        setLane(axes[group], l, mask);
+        compliances[group][l] = axisCompliances[k];
+        ++group;
+    }
+    int count = group;
+    for (; group < 3; ++group)
+    {
+        setLane(axes[group], l, glm::vec3(0.f));
+        compliances[group][l] = 0.f;
+    }
+    return count;
+}
+
+// Moves the anchors rA and rB, relative to the positions of bodies a and b,
+// so that the anchor of b moves by -correction relative to the anchor of a,
+// in the lanes set in mask
+static void correctJointPosition(BodyLanes &a, BodyLanes &b,
+                                 const Vec3Lanes &rA, const Vec3Lanes &rB,
+                                 const Vec3Lanes &correction,
+                                 const Lane &alpha, const Lane &mask)
+{
+    Lane      c2 = dot(correction, correction);
+    Vec3Lanes n  = correction * (Lane(1.f) / sqrt(max(c2, Lane(1e-12f))));
+
+    Vec3Lanes rnA = cross(rA, n);
+    Vec3Lanes rnB = cross(rB, n);
+    Lane      w   = alpha + a.inverseMass + dot(rnA, a.inverseInertia * rnA) +
+              b.inverseMass + dot(rnB, b.inverseInertia * rnB);
+
+    Lane active = mask * (c2 > Lane(1e-12f)) * (w > Lane(0.f));
+    Vec3Lanes p = correction * select(active, Lane(1.f) / w, Lane(0.f));
+
+    a.position = a.position + p * a.inverseMass;
+    b.position = b.position - p * b.inverseMass;
+    a.rotation = select(
+        active, rotate(a.rotation, a.inverseInertia * cross(rA, p)),
+        a.rotation);
+    b.rotation = select(
+        active, rotate(b.rotation, -(b.inverseInertia * cross(rB, p))),
+        b.rotation);
+}
+
+// Rotates b by -correction relative to a, in the lanes set in mask
+static void correctJointRotation(BodyLanes &a, BodyLanes &b,
+                                 const Vec3Lanes &correction,
+                                 const Lane &alpha, const Lane &mask)
+{
+    Vec3Lanes wA = a.inverseInertia * correction;
+    Vec3Lanes wB = b.inverseInertia * correction;
+
+    // (n . wA + n . wB) / theta with n = correction / theta
+    Lane theta2 = dot(correction, correction);
+    Lane w      = alpha + (dot(correction, wA) + dot(correction, wB)) /
+                         max(theta2, Lane(1e-12f));
+
+    Lane active = mask * (theta2 > Lane(1e-12f)) * (w > Lane(0.f));
+    Lane invW   = select(active, Lane(1.f) / w, Lane(0.f));
+
+    a.rotation = select(active, rotate(a.rotation, wA * invW), a.rotation);
+    b.rotation = select(active, rotate(b.rotation, -(wB * invW)), b.rotation);
+}
+
+// Per-body data is stored as one array per field, loops over bodies run
+// over contiguous arrays. Joints are kept in batches ordered by color and
+// solved a batch at a time, contacts one at a time.
+struct PbdWorld::ModelState
+{
+    Model *model;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> previousPositions;
+    std::vector<glm::quat> previousRotations;
+    std::vector<glm::vec3> linearVelocities;
+    std::vector<glm::vec3> angularVelocities;
+
+    std::vector<float>     inverseMasses;
+    std::vector<glm::vec3> inverseInertias; // diagonal, in body space
+    std::vector<glm::mat3> worldInverseInertias; // updated every substep
+    std::vector<float>     gravityFactors;  // 0 for static bodies
+    std::vector<float>     linearDampings;
+    std::vector<float>     angularDampings;
+
+    // Per substep damping and limit factors, recomputed when the substep
+    // changes
+    float              dampingStep = 0.f;
+    std::vector<float> linearDampingFactors;
+    std::vector<float> angularDampingFactors;
+    float              limitFactor = 1.f;
+
+    // Joint order of the next substep, alternating across steps
+    bool reverseJoints = false;
+
+    // Collision capsules, the segment runs from -halfAxis to halfAxis in
+    // body space
+    std::vector<glm::vec3> halfAxes;
+    std::vector<float>     radii;
+    std::vector<uint16_t>  groups;
+    std::vector<uint16_t>  masks;
+
+    std::vector<uint32_t>  kinematicBodies;
+    std::vector<Transform> kinematicStarts;
+
+    std::vector<JointBatch> jointBatches;
+
+    // Sorted (min << 32 | max) keys of bodies connected by a joint
+    std::vector<uint64_t> linkedPairs;
+
+    // Collision candidates, rebuilt every step
+    std::vector<glm::vec3>                     boundsMin;
+    std::vector<glm::vec3>                     boundsMax;
+    std::vector<uint32_t>                      sweepOrder;
+    std::vector<std::pair<uint32_t, uint32_t>> contactPairs;
+    std::vector<uint32_t>                      groundContacts;
+
+    // Body transforms before the last update. The velocities after a
+    // substep swing back and forth while bodies rest, motion is measured
+    // over whole updates instead.
+    std::vector<Transform> updateStarts;
+
+    int   substeps = 1; // adaptive substeps
+    float restTime = 0.f;
+    bool  sleeping = false;
+
+    void setup(Model &model, bool applyCurrentTransforms);
+
+    // Kinematic bodies move from their start transforms towards the targets
+    // in ModelPhysics::bodyTransforms, covering [from, to] of the way.
+    void step(float deltaTime, int substeps, const glm::vec3 &gravity,
+              float from, float to);
+
+    void writeResults() const;
+
+    bool kinematicMoved() const;
+
+    // Largest joint separation relative to MAX_JOINT_ERROR
+    float jointError() const;
+
+    // Largest speed of any point of a dynamic body over the last update of
+    // length deltaTime, and the largest one relative to the body radius
+    void saveUpdateStarts();
+    void measureMotion(float deltaTime, float &maxSpeed,
+                       float &maxRelativeSpeed) const;
+
+    void adaptSubsteps(float stepTime, float relativeSpeed, int maxSubsteps);
+    void updateRest(float deltaTime, float maxSpeed, bool moved);
+    void wakeUp(int maxSubsteps);
+
+    void findContacts(float deltaTime);
+    void integrate(float h, const glm::vec3 &gravity);
+    void updateVelocities(float h);
+    // Alternating the order keeps errors from piling up at one end of the
+    // chains, which makes chains of light bodies jitter
+    void solveJoints(float h, bool reverse);
+    void solveJointBatch(const JointBatch &batch, float invH2);
+    void solveContacts();
+
+    void gatherBodies(const uint32_t (&indices)[LANES],
+                      BodyLanes &bodies) const;
+    void scatterBodies(const uint32_t (&indices)[LANES], size_t count,
+                       const BodyLanes &bodies);
+
+    // Moves the anchors rA and rB, relative to the positions of bodies a
+    // and b, so that the anchor of b moves by -correction relative to the
+    // anchor of a. Either body may be NO_BODY.
+    void correctPosition(uint32_t a, uint32_t b, const glm::vec3 &rA,
+                         const glm::vec3 &rB, const glm::vec3 &correction,
+                         float alpha);
+};
+
+void PbdWorld::ModelState::setup(Model &m, bool applyCurrentTransforms)
+{
+    model = &m;
+
+    const auto &data    = m.data();
+    auto       &physics = m.physics();
+
+    size_t n = data.rigidBodies.size();
+
+    physics.rigidBodies.clear();
+    physics.rigidBodies.resize(n);
+    physics.joints.clear();
+    physics.bodyTransforms.clear();
+    physics.bodyTransforms.reserve(n);
+
+    positions.reserve(n);
+    rotations.reserve(n);
+    inverseMasses.reserve(n);
+    inverseInertias.reserve(n);
+    gravityFactors.reserve(n);
+    linearDampings.reserve(n);
+    angularDampings.reserve(n);
+    halfAxes.reserve(n);
+    radii.reserve(n);
+    groups.reserve(n);
+    masks.reserve(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const auto &rigidBody = data.rigidBodies[i];
+        auto       &body      = physics.rigidBodies[i];
+
+        body.offset.rotation    = glm::quat_cast(glm::eulerAngleYXZ(
+            rigidBody.rotation.y, rigidBody.rotation.x, rigidBody.rotation.z));
+        body.offset.translation = rigidBody.position;
+
+        Transform t = body.offset;
+        if (applyCurrentTransforms && rigidBody.boneIndex >= 0)
+        {
+            int32_t j = rigidBody.boneIndex;
+            t.translation -= data.bones[j].position;
+            t *= m.pose().getGlobalBoneTransform(j);
+        }
+        physics.bodyTransforms.push_back(t);
+        positions.push_back(t.translation);
+        rotations.push_back(t.rotation);
+
+        // Same inertia approximations as Bullet, capsules as boxes
+        glm::vec3 halfExtents;
+        switch (rigidBody.shape)
+        {
+        case RigidBodyShape::Sphere:
+            halfAxes.emplace_back(0.f);
+            radii.push_back(rigidBody.getSphereRadius());
+            halfExtents = glm::vec3(rigidBody.getSphereRadius() *
+                                    std::sqrt(0.6f));
+            break;
+        case RigidBodyShape::Capsule:
+        {
+            float r = rigidBody.getCapsuleRadius();
+            float h = 0.5f * rigidBody.getCapsuleHeight();
+            halfAxes.emplace_back(0.f, h, 0.f);
+            radii.push_back(r);
+            halfExtents = glm::vec3(r, r + h, r);
+            break;
+        }
+        case RigidBodyShape::Box:
+        {
+            halfExtents    = rigidBody.getBoxHalfExtents();
+            int longest    = 0;
+            for (int k = 1; k < 3; ++k)
+                if (halfExtents[k] > halfExtents[longest])
+                    longest = k;
+            float r = std::max(halfExtents[(longest + 1) % 3],
+                               halfExtents[(longest + 2) % 3]);
+            glm::vec3 axis(0.f);
+            axis[longest] = std::max(halfExtents[longest] - r, 0.f);
+            halfAxes.push_back(axis);
+            radii.push_back(r);
+            break;
+        }
+        }
+
+        float mass = rigidBody.physicsCalcType == PhysicsCalcType::Static
+                         ? 0.f
+                         : rigidBody.mass;
+        if (mass > 0.f)
+        {
+            glm::vec3 sq = halfExtents * halfExtents;
+            glm::vec3 inertia =
+                mass / 3.f * glm::vec3(sq.y + sq.z, sq.x + sq.z, sq.x + sq.y);
+            inverseMasses.push_back(1.f / mass);
+            inverseInertias.push_back(glm::vec3(
+                inertia.x > 0.f ? 1.f / inertia.x : 0.f,
+                inertia.y > 0.f ? 1.f / inertia.y : 0.f,
+                inertia.z > 0.f ? 1.f / inertia.z : 0.f));
+            gravityFactors.push_back(1.f);
+        }
+        else
+        {
+            inverseMasses.push_back(0.f);
+            inverseInertias.emplace_back(0.f);
+            gravityFactors.push_back(0.f);
+        }
+
+        if (rigidBody.physicsCalcType == PhysicsCalcType::Static)
+            kinematicBodies.push_back(static_cast<uint32_t>(i));
+
+        linearDampings.push_back(rigidBody.linearDamping);
+        angularDampings.push_back(rigidBody.angularDamping);
+        groups.push_back(static_cast<uint16_t>(1 << rigidBody.group));
+        masks.push_back(rigidBody.collisionGroupMask);
+    }
+
+    previousPositions = positions;
+    previousRotations = rotations;
+    worldInverseInertias.resize(n);
+    linearVelocities.assign(n, glm::vec3(0.f));
+    angularVelocities.assign(n, glm::vec3(0.f));
+    kinematicStarts.resize(kinematicBodies.size());
+
+    // Axes with lower > upper are free, like in Bullet
+    auto limits = [](glm::vec3 lower, glm::vec3 upper, glm::vec3 &lo,
+                     glm::vec3 &hi)
+    {
+        for (int k = 0; k < 3; ++k)
+            if (lower[k] > upper[k])
+            {
+                lower[k] = -FLT_MAX;
+                upper[k] = FLT_MAX;
+            }
+        lo = lower;
+        hi = upper;
+    };
+    auto compliances = [](const glm::vec3 &stiffness)
+    {
+        glm::vec3 c(0.f);
+        for (int k = 0; k < 3; ++k)
+            if (stiffness[k] > 1e-6f)
+                c[k] = 1.f / stiffness[k];
+        return c;
+    };
+
+    struct JointDesc
+    {
+        uint32_t  a, b;
+        Transform frameA, frameB;
+        glm::vec3 linearLower, linearUpper, angularLower, angularUpper;
+        glm::vec3 linearCompliances, angularCompliances;
+    };
+    std::vector<JointDesc> joints;
+    joints.reserve(data.joints.size());
+
+    for (const auto &joint : data.joints)
+    {
+        if (joint.rigidBodyIndexA < 0 || joint.rigidBodyIndexB < 0 ||
+            joint.rigidBodyIndexA == joint.rigidBodyIndexB)
+            continue;
+
+        uint32_t a = static_cast<uint32_t>(joint.rigidBodyIndexA);
+        uint32_t b = static_cast<uint32_t>(joint.rigidBodyIndexB);
+        if (inverseMasses[a] == 0.f && inverseMasses[b] == 0.f)
+            continue;
+
+        Transform transform{
+            .translation = joint.position,
+            .rotation    = glm::quat_cast(glm::eulerAngleYXZ(
+                joint.rotation.y, joint.rotation.x, joint.rotation.z))};
+
+        auto &desc  = joints.emplace_back();
+        desc.a      = a;
+        desc.b      = b;
+        desc.frameA = transform * physics.rigidBodies[a].offset.inverse();
+        desc.frameB = transform * physics.rigidBodies[b].offset.inverse();
+        limits(joint.linearLowerLimit, joint.linearUpperLimit,
+               desc.linearLower, desc.linearUpper);
+        limits(joint.angularLowerLimit, joint.angularUpperLimit,
+               desc.angularLower, desc.angularUpper);
+        desc.linearCompliances  = compliances(joint.linearStiffness);
+        desc.angularCompliances = compliances(joint.angularStiffness);
+
+        linkedPairs.push_back(pairKey(a, b));
+    }
+
+    // Greedy coloring: every joint takes the first color that no earlier
+    // joint on one of its dynamic bodies has. Static bodies are not moved by
+    // the solver and may be shared within a color.
+    std::vector<std::vector<uint32_t>> bodyColors(n);
+    std::vector<uint32_t>              colors(joints.size());
+    auto used = [&](uint32_t body, uint32_t color)
+    {
+        const auto &c = bodyColors[body];
+        return inverseMasses[body] != 0.f &&
+               std::find(c.begin(), c.end(), color) != c.end();
+    };
+    for (size_t j = 0; j < joints.size(); ++j)
+    {
+        uint32_t color = 0;
+        while (used(joints[j].a, color) || used(joints[j].b, color))
+            ++color;
+        colors[j] = color;
+        bodyColors[joints[j].a].push_back(color);
+        bodyColors[joints[j].b].push_back(color);
+    }
+
+    std::vector<uint32_t> order(joints.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(),
+                     [&colors](uint32_t a, uint32_t b)
+                     { return colors[a] < colors[b]; });
+
+    for (size_t k = 0; k < order.size();)
+    {
+        size_t count = 1;
+        while (count < LANES && k + count < order.size() &&
+               colors[order[k + count]] == colors[order[k]])
+            ++count;
+
+        auto &batch = jointBatches.emplace_back();
+        batch.count = static_cast<uint32_t>(count);
+        batch.linearSpringGroups  = 0;
+        batch.angularSpringGroups = 0;
+        for (size_t l = 0; l < LANES; ++l)
+        {
+            const auto &desc = joints[order[k + (l < count ? l : 0)]];
+            batch.bodiesA[l] = desc.a;
+            batch.bodiesB[l] = desc.b;
+            setLane(batch.frameTranslationsA, l, desc.frameA.translation);
+            setLane(batch.frameTranslationsB, l, desc.frameB.translation);
+            setLane(batch.frameRotationsA, l, desc.frameA.rotation);
+            setLane(batch.frameRotationsB, l, desc.frameB.rotation);
+            setLane(batch.linearLowerLimits, l, desc.linearLower);
+            setLane(batch.linearUpperLimits, l, desc.linearUpper);
+            setLane(batch.angularLowerLimits, l, desc.angularLower);
+            setLane(batch.angularUpperLimits, l, desc.angularUpper);
+            batch.linearSpringGroups = std::max(
+                batch.linearSpringGroups,
+                setSprings(batch.linearSpringAxes, batch.linearCompliances, l,
+                           desc.linearCompliances));
+            batch.angularSpringGroups = std::max(
+                batch.angularSpringGroups,
+                setSprings(batch.angularSpringAxes, batch.angularCompliances,
+                           l, desc.angularCompliances));
+        }
+        k += count;
+    }
+    std::sort(linkedPairs.begin(), linkedPairs.end());
+
+    boundsMin.resize(n);
+    boundsMax.resize(n);
+    sweepOrder.resize(n);
+    std::iota(sweepOrder.begin(), sweepOrder.end(), 0u);
+}
+
+void PbdWorld::ModelState::step(float deltaTime, int substeps,
+                                const glm::vec3 &gravity, float from,
+                                float to)
+{
+    const auto &targets = model->physics().bodyTransforms;
+
+    float h = deltaTime / static_cast<float>(substeps);
+    if (h != dampingStep)
+    {
+        dampingStep = h;
+        linearDampingFactors.resize(linearDampings.size());
+        angularDampingFactors.resize(angularDampings.size());
+        for (size_t i = 0; i < linearDampings.size(); ++i)
+        {
+            linearDampingFactors[i] =
+                std::pow(1.f - linearDampings[i], h);
+            angularDampingFactors[i] =
+                std::pow(1.f - angularDampings[i], h);
+        }
+        limitFactor = 1.f - std::exp(-LIMIT_RATE * h);
+    }
+
+    findContacts(deltaTime);
+
+    for (int k = 0; k < substeps; ++k)
+    {
+        integrate(h, gravity);
+
+        float t = from + (to - from) * static_cast<float>(k + 1) /
+                             static_cast<float>(substeps);
+        for (size_t j = 0; j < kinematicBodies.size(); ++j)
+        {
+            uint32_t i   = kinematicBodies[j];
+            positions[i] = glm::mix(kinematicStarts[j].translation,
+                                    targets[i].translation, t);
+            rotations[i] = glm::slerp(kinematicStarts[j].rotation,
+                                      targets[i].rotation, t);
+        }
+
+        solveJoints(h, reverseJoints);
+        reverseJoints = !reverseJoints;
+        solveContacts();
+        updateVelocities(h);
+    }
+}
+
+void PbdWorld::ModelState::writeResults() const
+{
+    auto &transforms = model->physics().bodyTransforms;
+    for (size_t i = 0; i < transforms.size(); ++i)
+        if (gravityFactors[i] != 0.f)
+            transforms[i] = {positions[i], rotations[i]};
+}
+
+bool PbdWorld::ModelState::kinematicMoved() const
+{
+    const auto &targets = model->physics().bodyTransforms;
+    for (uint32_t i : kinematicBodies)
+    {
+        glm::vec3 d = targets[i].translation - positions[i];
+        // The vector part of the difference is sin(angle / 2) long
+        glm::quat q = glm::conjugate(rotations[i]) * targets[i].rotation;
+        glm::vec3 r(q.x, q.y, q.z);
+        if (glm::dot(d, d) > WAKE_DISTANCE * WAKE_DISTANCE ||
+            glm::dot(r, r) > 0.25f * WAKE_ANGLE * WAKE_ANGLE)
+            return true;
+    }
+    return false;
+}
+
+float PbdWorld::ModelState::jointError() const
+{
+    float error2 = 0.f;
+    for (const auto &batch : jointBatches)
+    {
+        BodyLanes a, b;
+        gatherBodies(batch.bodiesA, a);
+        gatherBodies(batch.bodiesB, b);
+
+        QuatLanes frameA = a.rotation * batch.frameRotationsA;
+        Vec3Lanes offset =
+            conjugate(frameA) *
+            (b.position + b.rotation * batch.frameTranslationsB - a.position -
+             a.rotation * batch.frameTranslationsA);
+        Vec3Lanes d = offset - clamp(offset, batch.linearLowerLimits,
+                                     batch.linearUpperLimits);
+        Lane      distance2 = dot(d, d);
+        for (size_t l = 0; l < batch.count; ++l)
+            error2 = std::max(error2, distance2[l]);
+    }
+    return std::sqrt(error2) / MAX_JOINT_ERROR;
+}
+
+void PbdWorld::ModelState::saveUpdateStarts()
+{
+    updateStarts.resize(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+        updateStarts[i] = {positions[i], rotations[i]};
+}
+
+void PbdWorld::ModelState::measureMotion(float  deltaTime, float &maxSpeed,
+                                         float &maxRelativeSpeed) const
+{
+    maxSpeed         = 0.f;
+    maxRelativeSpeed = 0.f;
+    float invDt      = 1.f / deltaTime;
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+        if (inverseMasses[i] == 0.f)
+            continue;
+        glm::quat dq =
+            rotations[i] * glm::conjugate(updateStarts[i].rotation);
+        float angle  = 2.f * glm::length(glm::vec3(dq.x, dq.y, dq.z));
+        float extent = glm::length(halfAxes[i]) + radii[i];
+        float speed =
+            (glm::distance(positions[i], updateStarts[i].translation) +
+             angle * extent) *
+            invDt;
+        maxSpeed = std::max(maxSpeed, speed);
+        if (radii[i] > 0.f)
+            maxRelativeSpeed = std::max(maxRelativeSpeed, speed / radii[i]);
+    }
+}
+
+void PbdWorld::ModelState::adaptSubsteps(float stepTime, float relativeSpeed,
+                                         int maxSubsteps)
+{
+    int needed = static_cast<int>(
+        std::ceil(relativeSpeed * stepTime / MAX_SUBSTEP_MOTION));
+
+    float error = jointError();
+    if (error > 1.f)
+        substeps *= 2;
+    else if (error < 0.5f)
+        --substeps;
+    substeps = std::clamp(std::max(substeps, needed), 1, maxSubsteps);
+}
+
+void PbdWorld::ModelState::updateRest(float deltaTime, float maxSpeed,
+                                      bool moved)
+{
+    if (moved || maxSpeed >= SLEEP_SPEED)
+    {
+        restTime = 0.f;
+        return;
+    }
+
+    restTime += deltaTime;
+    if (restTime < SLEEP_TIME)
+        return;
+
+    // Below the sleep speed, stopping is not visible
+    sleeping = true;
+    std::fill(linearVelocities.begin(), linearVelocities.end(),
+              glm::vec3(0.f));
+    std::fill(angularVelocities.begin(), angularVelocities.end(),
+              glm::vec3(0.f));
+}
+
+void PbdWorld::ModelState::wakeUp(int maxSubsteps)
+{
+    sleeping = false;
+    restTime = 0.f;
+    substeps = maxSubsteps;
+}
+
+void PbdWorld::ModelState::integrate(float h, const glm::vec3 &gravity)
+{
+    size_t n = positions.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        previousPositions[i] = positions[i];
+        linearVelocities[i]  = (linearVelocities[i] +
+                               gravity * (gravityFactors[i] * h)) *
+                              linearDampingFactors[i];
+        positions[i] += linearVelocities[i] * h;
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+        previousRotations[i]  = rotations[i];
+        angularVelocities[i] *= angularDampingFactors[i];
+        rotate(rotations[i], angularVelocities[i] * h);
+    }
+    // Kept for the substep, corrections are small
+    for (size_t i = 0; i < n; ++i)
+    {
+        glm::mat3 r = glm::mat3_cast(rotations[i]);
+        glm::mat3 scaled(r[0] * inverseInertias[i].x,
+                         r[1] * inverseInertias[i].y,
+                         r[2] * inverseInertias[i].z);
+        worldInverseInertias[i] = scaled * glm::transpose(r);
+    }
+}
+
+void PbdWorld::ModelState::updateVelocities(float h)
+{
+    float  invH = 1.f / h;
+    size_t n    = positions.size();
+    for (size_t i = 0; i < n; ++i)
+        linearVelocities[i] = (positions[i] - previousPositions[i]) * invH;
+    for (size_t i = 0; i < n; ++i)
+    {
+        glm::quat dq = rotations[i] * glm::conjugate(previousRotations[i]);
+        glm::vec3 w  = glm::vec3(dq.x, dq.y, dq.z) * (2.f * invH);
+        angularVelocities[i] = dq.w < 0.f ? -w : w;
+    }
+}
+
+void PbdWorld::ModelState::correctPosition(uint32_t a, uint32_t b,
+                                           const glm::vec3 &rA,
+                                           const glm::vec3 &rB,
+                                           const glm::vec3 &correction,
+                                           float            alpha)
+{
+    float c = glm::length(correction);
+    if (c < 1e-6f)
+        return;
+    glm::vec3 n = correction / c;
+
+    float w = alpha;
+    if (a != NO_BODY)
+    {
+        glm::vec3 rn = glm::cross(rA, n);
+        w += inverseMasses[a] + glm::dot(rn, worldInverseInertias[a] * rn);
+    }
+    if (b != NO_BODY)
+    {
+        glm::vec3 rn = glm::cross(rB, n);
+        w += inverseMasses[b] + glm::dot(rn, worldInverseInertias[b] * rn);
+    }
+    if (w <= 0.f)
+        return;
+
+    glm::vec3 p = correction / w;
+    if (a != NO_BODY)
+    {
+        positions[a] += p * inverseMasses[a];
+        rotate(rotations[a], worldInverseInertias[a] * glm::cross(rA, p));
+    }
+    if (b != NO_BODY)
+    {
+        positions[b] -= p * inverseMasses[b];
+        rotate(rotations[b], -(worldInverseInertias[b] * glm::cross(rB, p)));
+    }
+}
+
+void PbdWorld::ModelState::gatherBodies(const uint32_t (&indices)[LANES],
+                                        BodyLanes &bodies) const
+{
+    for (size_t l = 0; l < LANES; ++l)
+    {
+        uint32_t         i = indices[l];
+        const glm::mat3 &m = worldInverseInertias[i];
+
+        bodies.position.x[l]       = positions[i].x;
+        bodies.position.y[l]       = positions[i].y;
+        bodies.position.z[l]       = positions[i].z;
+        bodies.rotation.w[l]       = rotations[i].w;
+        bodies.rotation.x[l]       = rotations[i].x;
+        bodies.rotation.y[l]       = rotations[i].y;
+        bodies.rotation.z[l]       = rotations[i].z;
+        bodies.inverseMass[l]      = inverseMasses[i];
+        bodies.inverseInertia.xx[l] = m[0][0];
+        bodies.inverseInertia.xy[l] = m[1][0];
+        bodies.inverseInertia.xz[l] = m[2][0];
+        bodies.inverseInertia.yy[l] = m[1][1];
+        bodies.inverseInertia.yz[l] = m[2][1];
+        bodies.inverseInertia.zz[l] = m[2][2];
+    }
+}
+
+void PbdWorld::ModelState::scatterBodies(const uint32_t (&indices)[LANES],
+                                         size_t           count,
+                                         const BodyLanes &bodies)
+{
+    for (size_t l = 0; l < count; ++l)
+    {
+        uint32_t i = indices[l];
+        if (inverseMasses[i] == 0.f)
+            continue;
+        positions[i] = {bodies.position.x[l], bodies.position.y[l],
+                        bodies.position.z[l]};
+        rotations[i] = {bodies.rotation.w[l], bodies.rotation.x[l],
+                        bodies.rotation.y[l], bodies.rotation.z[l]};
+    }
+}
+
+void PbdWorld::ModelState::solveJoints(float h, bool reverse)
+{
+    // Joints of one color are independent, reversing the batches reverses
+    // the order of the colors
+    float  invH2 = 1.f / (h * h);
+    size_t n     = jointBatches.size();
+    for (size_t k = 0; k < n; ++k)
+        solveJointBatch(jointBatches[reverse ? n - 1 - k : k], invH2);
+}
+
+void PbdWorld::ModelState::solveJointBatch(const JointBatch &batch,
+                                           float             invH2)
+{
+    BodyLanes a, b;
+    gatherBodies(batch.bodiesA, a);
+    gatherBodies(batch.bodiesB, b);
+
+    const Lane zero(0.f), one(1.f);
+
+    // Angular limits and springs, measured in the frame of A. Out of the
+    // limits, B is turned towards the clamped rotation.
+    QuatLanes frameA   = a.rotation * batch.frameRotationsA;
+    QuatLanes frameB   = b.rotation * batch.frameRotationsB;
+    QuatLanes relative = conjugate(frameA) * frameB;
+    Vec3Lanes angles   = eulerAnglesXYZ(relative);
+    Vec3Lanes inLimits =
+        clamp(angles, batch.angularLowerLimits, batch.angularUpperLimits);
+    Lane violated = max(max(inLimits.x != angles.x, inLimits.y != angles.y),
+                        inLimits.z != angles.z);
+    if (any(violated))
+    {
+        QuatLanes clamped = eulerAnglesXYZToQuat(inLimits);
+        correctJointRotation(
+            a, b,
+            frameA * rotationVector(relative * conjugate(clamped)) *
+                Lane(limitFactor),
+            zero, violated);
+    }
+    for (int k = 0; k < batch.angularSpringGroups; ++k)
+        correctJointRotation(a, b, frameA * (inLimits * batch.angularSpringAxes[k]),
+                        batch.angularCompliances[k] * Lane(invH2),
+                        batch.angularCompliances[k] != zero);
+
+    // Linear limits and springs
+    frameA           = a.rotation * batch.frameRotationsA;
+    Vec3Lanes rA     = a.rotation * batch.frameTranslationsA;
+    Vec3Lanes rB     = b.rotation * batch.frameTranslationsB;
+    Vec3Lanes offset = conjugate(frameA) * (b.position + rB - a.position - rA);
+    inLimits =
+        clamp(offset, batch.linearLowerLimits, batch.linearUpperLimits);
+    correctJointPosition(a, b, rA, rB, frameA * (offset - inLimits), zero, one);
+    for (int k = 0; k < batch.linearSpringGroups; ++k)
+        correctJointPosition(a, b, a.rotation * batch.frameTranslationsA,
+                        b.rotation * batch.frameTranslationsB,
+                        frameA * (inLimits * batch.linearSpringAxes[k]),
+                        batch.linearCompliances[k] * Lane(invH2),
+                        batch.linearCompliances[k] != zero);
+
+    scatterBodies(batch.bodiesA, batch.count, a);
+    scatterBodies(batch.bodiesB, batch.count, b);
+}
+
+void PbdWorld::ModelState::findContacts(float deltaTime)
+{
+    size_t n = positions.size();
+    for (size_t i = 0; i < n; ++i)
+    {
+        glm::vec3 axis   = glm::abs(rotations[i] * halfAxes[i]);
+        glm::vec3 extent = axis + radii[i] + CONTACT_MARGIN;
+        glm::vec3 motion = linearVelocities[i] * deltaTime;
+        boundsMin[i]     = positions[i] - extent + glm::min(motion, 0.f);
+        boundsMax[i]     = positions[i] + extent + glm::max(motion, 0.f);
+    }
+    // Kinematic bodies sweep to their targets
+    const auto &targets = model->physics().bodyTransforms;
+    for (uint32_t i : kinematicBodies)
+    {
+        glm::vec3 motion = targets[i].translation - positions[i];
+        boundsMin[i] += glm::min(motion, 0.f);
+        boundsMax[i] += glm::max(motion, 0.f);
+    }
+
+    // Sweep and prune along x
+    std::sort(sweepOrder.begin(), sweepOrder.end(),
+              [this](uint32_t a, uint32_t b)
+              { return boundsMin[a].x < boundsMin[b].x; });
+
+    contactPairs.clear();
+    groundContacts.clear();
+    for (size_t k = 0; k < n; ++k)
+    {
+        uint32_t i = sweepOrder[k];
+
+        if (inverseMasses[i] != 0.f && boundsMin[i].y < 0.f &&
+            (masks[i] & GROUND_GROUP) && (groups[i] & GROUND_MASK))
+            groundContacts.push_back(i);
+
+        for (size_t l = k + 1; l < n; ++l)
+        {
+            uint32_t j = sweepOrder[l];
+            if (boundsMin[j].x > boundsMax[i].x)
+                break;
+            if (inverseMasses[i] == 0.f && inverseMasses[j] == 0.f)
+                continue;
+            if (!(masks[i] & groups[j]) || !(masks[j] & groups[i]))
+                continue;
+            if (boundsMin[j].y > boundsMax[i].y ||
+                boundsMax[j].y < boundsMin[i].y ||
+                boundsMin[j].z > boundsMax[i].z ||
+                boundsMax[j].z < boundsMin[i].z)
+                continue;
+            if (std::binary_search(linkedPairs.begin(), linkedPairs.end(),
+                                   pairKey(i, j)))
+                continue;
+            contactPairs.emplace_back(i, j);
+        }
+    }
+}
+
+void PbdWorld::ModelState::solveContacts()
+{
+    for (auto [a, b] : contactPairs)
+    {
+        glm::vec3 axisA = rotations[a] * halfAxes[a];
+        glm::vec3 axisB = rotations[b] * halfAxes[b];
+        glm::vec3 cA, cB;
+        closestPoints(positions[a] - axisA, positions[a] + axisA,
+                      positions[b] - axisB, positions[b] + axisB, cA, cB);
+
+        glm::vec3 d     = cB - cA;
+        float     dist  = glm::length(d);
+        float     depth = radii[a] + radii[b] - dist;
+        if (depth <= 0.f)
+            continue;
+
+        glm::vec3 n = dist > 1e-6f ? d / dist : glm::vec3(0.f, 1.f, 0.f);
+        correctPosition(a, b, cA + n * radii[a] - positions[a],
+                        cB - n * radii[b] - positions[b],
+                        -n * (depth * limitFactor), 0.f);
+    }
+
+    for (uint32_t i : groundContacts)
+    {
+        glm::vec3 axis = rotations[i] * halfAxes[i];
+        glm::vec3 p    = positions[i] - (axis.y > 0.f ? axis : -axis);
+        float     depth = radii[i] - p.y;
+        if (depth <= 0.f)
+            continue;
+
+        glm::vec3 contact = p - glm::vec3(0.f, radii[i], 0.f);
+        correctPosition(NO_BODY, i, glm::vec3(0.f), contact - positions[i],
+                        glm::vec3(0.f, -depth, 0.f), 0.f);
+    }
+}
+
+PbdWorld::PbdWorld()
+    : m_gravity(glm::vec3(0.f, -9.8f, 0.f) * GRAVITY_SCALE)
+{
+}
+
+PbdWorld::~PbdWorld() = default;
+
+void PbdWorld::setupModelPhysics(Model &model, bool applyCurrentTransforms)
+{
+    clearModelPhysics(model);
+
+    auto state = std::make_unique<ModelState>();
+    state->setup(model, applyCurrentTransforms);
+    state->substeps = m_substeps;
+    m_models.push_back(std::move(state));
+}
+
+void PbdWorld::clearModelPhysics(Model &model)
+{
+    auto it = std::find_if(m_models.begin(), m_models.end(),
+                           [&model](const auto &state)
+                           { return state->model == &model; });
+    if (it == m_models.end())
+        return;
+
+    m_models.erase(it);
+    model.physics().rigidBodies.clear();
+    model.physics().joints.clear();
+    model.physics().bodyTransforms.clear();
+}
+
+void PbdWorld::update(float deltaTime, int maxSubSteps, float fixedDeltaTime)
+{
+    GLMMD_TRACE_SCOPE("PbdWorld::update");
+
+    int   steps    = 1;
+    float stepTime = deltaTime;
+    if (maxSubSteps > 0)
+    {
+        m_timeAccum += deltaTime;
+        steps = static_cast<int>(m_timeAccum / fixedDeltaTime);
+        m_timeAccum -= static_cast<float>(steps) * fixedDeltaTime;
+        steps    = std::min(steps, maxSubSteps);
+        stepTime = fixedDeltaTime;
+    }
+    if (steps <= 0 || stepTime <= 0.f)
+        return;
+
+    parallelFor(0, m_models.size(), 1,
+                [&](size_t i)
+                {
+                    auto &state = *m_models[i];
+
+                    bool moved = m_deactivation && state.kinematicMoved();
+                    if (state.sleeping)
+                    {
+                        if (!moved)
+                            return;
+                        state.wakeUp(m_substeps);
+                    }
+
+                    for (size_t j = 0; j < state.kinematicBodies.size(); ++j)
+                    {
+                        uint32_t k = state.kinematicBodies[j];
+                        state.kinematicStarts[j] = {state.positions[k],
+                                                    state.rotations[k]};
+                    }
+
+                    bool measure = m_adaptiveSubsteps || m_deactivation;
+                    if (measure)
+                        state.saveUpdateStarts();
+
+                    int substeps = m_adaptiveSubsteps
+                                       ? std::min(state.substeps, m_substeps)
+                                       : m_substeps;
+                    for (int k = 0; k < steps; ++k)
+                        state.step(stepTime, substeps, m_gravity,
+                                   static_cast<float>(k) / steps,
+                                   static_cast<float>(k + 1) / steps);
+                    state.writeResults();
+
+                    if (!measure)
+                        return;
+
+                    float maxSpeed, maxRelativeSpeed;
+                    state.measureMotion(stepTime * steps, maxSpeed,
+                                        maxRelativeSpeed);
+                    if (m_adaptiveSubsteps)
+                        state.adaptSubsteps(stepTime, maxRelativeSpeed,
+                                            m_substeps);
+                    if (m_deactivation)
+                        state.updateRest(stepTime * steps, maxSpeed, moved);
+                });
+}
+
+void PbdWorld::setGravity(const glm::vec3 &gravity)
+{
+    m_gravity = gravity * GRAVITY_SCALE;
+    for (const auto &state : m_models)
+        state->wakeUp(m_substeps);
+}
+
+void PbdWorld::setSubsteps(int substeps)
+{
+    m_substeps = std::max(substeps, 1);
+}
+
+void PbdWorld::setAdaptiveSubsteps(bool enabled)
+{
+    m_adaptiveSubsteps = enabled;
+    for (const auto &state : m_models)
+        state->substeps = m_substeps;
+}
+
+void PbdWorld::setDeactivation(bool enabled)
+{
+    m_deactivation = enabled;
+    for (const auto &state : m_models)
+        state->wakeUp(m_substeps);
+}
+
+bool PbdWorld::isSleeping(const Model &model) const
+{
+    for (const auto &state : m_models)
+        if (state->model == &model)
+            return state->sleeping;
+    return false;
+}
+
+} // namespace glmmd
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+#include <glmmd/core/PhysicsCache.h>
+#include <glmmd/core/Trace.h>
+
+namespace glmmd
+{
+
+constexpr float QUAT_COMPONENT_RANGE = 0.70710678f; // 1 / sqrt(2)
+constexpr float ROTATION_STEPS       = 32767.f;
+constexpr float TRANSLATION_STEPS    = 65535.f;
+
+static void encodeRotation(glm::quat q, uint16_t out[3])
+{
+    float c[4]{q.x, q.y, q.z, q.w};
+
+    int largest = 0;
+    for (int i = 1; i < 4; ++i)
+        if (std::abs(c[i]) > std::abs(c[largest]))
+            largest = i;
+    float sign = c[largest] < 0.f ? -1.f : 1.f;
+
+    for (int i = 0, j = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float v = glm::clamp(sign * c[i] / QUAT_COMPONENT_RANGE, -1.f, 1.f);
+        out[j++] = static_cast<uint16_t>(
+            std::lround((v * 0.5f + 0.5f) * ROTATION_STEPS));
+    }
+    out[0] |= static_cast<uint16_t>((largest & 1) << 15);
+    out[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+}
+
+static glm::quat decodeRotation(const uint16_t in[3])
+{
+    int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+
+    float c[4];
+    float sum = 0.f;
+    for (int i = 0, j = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float v = static_cast<float>(in[j++] & 0x7FFF) / ROTATION_STEPS;
+        c[i]    = (v * 2.f - 1.f) * QUAT_COMPONENT_RANGE;
+        sum += c[i] * c[i];
+    }
+    c[largest] = std::sqrt(std::max(0.f, 1.f - sum));
+
+    return glm::quat(c[3], c[0], c[1], c[2]);
+}
+
+PhysicsCache::PhysicsCache(const ModelData &modelData, float frameRate)
+    : m_frameRate(frameRate)
+{
+    for (const auto &rigidBody : modelData.rigidBodies)
+        if (rigidBody.physicsCalcType != PhysicsCalcType::Static &&
+            rigidBody.boneIndex >= 0)
+            m_bones.push_back(static_cast<uint32_t>(rigidBody.boneIndex));
+
+    std::sort(m_bones.begin(), m_bones.end());
+    m_bones.erase(std::unique(m_bones.begin(), m_bones.end()), m_bones.end());
+
+    m_boneNames.reserve(m_bones.size());
+    for (auto i : m_bones)
+        m_boneNames.emplace_back(modelData.bones[i].name);
+}
+
+PhysicsCache::PhysicsCache(float frameRate, std::vector<uint32_t> bones,
+                           std::vector<std::string> boneNames,
+                           std::vector<BoneRange>   ranges,
+                           std::vector<Sample>      samples)
+    : m_frameRate(frameRate)
+    , m_bones(std::move(bones))
+    , m_boneNames(std::move(boneNames))
+    , m_ranges(std::move(ranges))
+    , m_samples(std::move(samples))
+{
+    if (m_boneNames.size() != m_bones.size() ||
+        m_ranges.size() != m_bones.size())
+        throw std::runtime_error("Invalid physics cache.");
+
+    if (!m_bones.empty())
+        m_frameCount =
+            static_cast<uint32_t>(m_samples.size() / m_bones.size());
+    if (static_cast<size_t>(m_frameCount) * m_bones.size() != m_samples.size())
+        throw std::runtime_error("Invalid physics cache.");
+}
+
+void PhysicsCache::record(const ModelPose &pose)
+{
+    for (auto i : m_bones)
+        m_recorded.push_back(pose.getGlobalBoneTransform(i));
+}
+
+void PhysicsCache::finish()
+{
+    GLMMD_TRACE_SCOPE("PhysicsCache::finish");
+
+    size_t boneCount = m_bones.size();
+    if (boneCount == 0)
+    {
+        m_recorded.clear();
+        return;
+    }
+
+    uint32_t frameCount =
+        static_cast<uint32_t>(m_recorded.size() / boneCount);
+
+    m_ranges.assign(boneCount, {glm::vec3(0.f), glm::vec3(0.f)});
+    for (size_t b = 0; b < boneCount; ++b)
+    {
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(std::numeric_limits<float>::lowest());
+        for (uint32_t f = 0; f < frameCount; ++f)
+        {
+            const auto &t = m_recorded[f * boneCount + b].translation;
+            lo            = glm::min(lo, t);
+            hi            = glm::max(hi, t);
+        }
+        if (frameCount == 0)
+            continue;
+        m_ranges[b].origin = lo;
+        m_ranges[b].scale  = (hi - lo) / TRANSLATION_STEPS;
+    }
+
+    m_samples.resize(static_cast<size_t>(frameCount) * boneCount);
+    for (size_t k = 0; k < m_samples.size(); ++k)
+    {
+        const auto &range = m_ranges[k % boneCount];
+        const auto &t     = m_recorded[k];
+        auto       &s     = m_samples[k];
+
+        for (int c = 0; c < 3; ++c)
+        {
+            float v = 0.f;
+            if (range.scale[c] > 0.f)
+                v = (t.translation[c] - range.origin[c]) / range.scale[c];
+            s.translation[c] = static_cast<uint16_t>(
+                std::lround(glm::clamp(v, 0.f, TRANSLATION_STEPS)));
+        }
+        encodeRotation(glm::normalize(t.rotation), s.rotation);
+    }
+
+    m_frameCount = frameCount;
+    m_recorded.clear();
+    m_recorded.shrink_to_fit();
+}
+
+Transform PhysicsCache::decode(uint32_t frame, size_t boneIndex) const
+{
+    const auto &range = m_ranges[boneIndex];
+    const auto &s     = m_samples[frame * m_bones.size() + boneIndex];
+
+    glm::vec3 translation(s.translation[0], s.translation[1],
+                          s.translation[2]);
+    return {.translation = range.origin + range.scale * translation,
+            .rotation    = decodeRotation(s.rotation)};
+}
+
+void PhysicsCache::apply(float time, ModelPose &pose) const
+{
+    if (!pose.m_modelData || !matches(*pose.m_modelData))
+        throw std::runtime_error("Physics cache does not match the model.");
+
+    if (m_frameCount == 0)
+        return;
+
+    float frame = glm::clamp(time * m_frameRate, 0.f,
+                             static_cast<float>(m_frameCount - 1));
+    auto  f0    = static_cast<uint32_t>(frame);
+    auto  f1    = std::min(f0 + 1, m_frameCount - 1);
+    float t     = frame - static_cast<float>(f0);
+
+    for (size_t b = 0; b < m_bones.size(); ++b)
+    {
+        Transform a = decode(f0, b);
+        Transform c = decode(f1, b);
+
+        pose.m_globalBoneTransforms[m_bones[b]] = {
+            .translation = glm::mix(a.translation, c.translation, t),
+            .rotation    = glm::slerp(a.rotation, c.rotation, t)};
+    }
+}
+
+bool PhysicsCache::matches(const ModelData &modelData) const
+{
+    for (size_t b = 0; b < m_bones.size(); ++b)
+        if (m_bones[b] >= modelData.bones.size() ||
+            std::string_view(modelData.bones[m_bones[b]].name) !=
+                m_boneNames[b])
+            return false;
+    return true;
+}
+
+float PhysicsCache::duration() const
+{
+    if (m_frameCount == 0)
+        return 0.f;
+    return static_cast<float>(m_frameCount - 1) / m_frameRate;
+}
+
+} // namespace glmmd
@@ -0,0 +1,102 @@
+#ifndef GLMMD_DONT_USE_BULLET
+
+#include <algorithm>
+#include <cmath>
+
+#include <glmmd/core/PhysicsCheckpoints.h>
+
+namespace glmmd
+{
+
+static size_t checkpointSize(const std::vector<ModelPhysicsState> &states)
+{
+    size_t size = 0;
+    for (const auto &state : states)
+        size += state.size() * sizeof(RigidBodyState);
+    return size;
+}
+
+PhysicsCheckpoints::PhysicsCheckpoints(float interval, size_t memoryLimit)
+    : m_initialInterval(std::max(interval, 1e-3f))
+    , m_interval(m_initialInterval)
+    , m_memoryLimit(memoryLimit)
+{
+}
+
+void PhysicsCheckpoints::record(const PhysicsWorld     &world,
+                                std::span<Model *const> models, float time)
+{
+    if (time < 0.f)
+        return;
+
+    float slot = std::floor(time / m_interval);
+
+    auto it = std::lower_bound(m_checkpoints.begin(), m_checkpoints.end(),
+                               slot * m_interval,
+                               [](const Checkpoint &c, float t)
+                               { return c.time < t; });
+    if (it != m_checkpoints.end() &&
+        std::floor(it->time / m_interval) == slot)
+        return;
+
+    Checkpoint checkpoint{time, std::vector<ModelPhysicsState>(models.size())};
+    for (size_t i = 0; i < models.size(); ++i)
+        world.saveState(*models[i], checkpoint.states[i]);
+
+    m_memoryUsage += checkpointSize(checkpoint.states);
+    m_checkpoints.insert(it, std::move(checkpoint));
+
+    while (m_memoryUsage > m_memoryLimit && m_checkpoints.size() > 1)
+        thinOut();
+}
+
+float PhysicsCheckpoints::restore(PhysicsWorld           &world,
+                                  std::span<Model *const> models,
+                                  float                   time) const
+{
+    auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(),
+                               time, [](float t, const Checkpoint &c)
+                               { return t < c.time; });
+    if (it == m_checkpoints.begin())
+        return -1.f;
+    --it;
+
+    if (it->states.size() != models.size())
+        return -1.f;
+
+    for (size_t i = 0; i < models.size(); ++i)
+        world.restoreState(*models[i], it->states[i]);
+    return it->time;
+}
+
+void PhysicsCheckpoints::clear()
+{
+    m_checkpoints.clear();
+    m_memoryUsage = 0;
+    m_interval    = m_initialInterval;
+}
+
+void PhysicsCheckpoints::thinOut()
+{
+    m_interval *= 2.f;
+
+    // Keep the first checkpoint of every doubled interval
+    std::vector<Checkpoint> kept;
+    float                   lastSlot = -1.f;
+    for (auto &checkpoint : m_checkpoints)
+    {
+        float slot = std::floor(checkpoint.time / m_interval);
+        if (slot == lastSlot)
+        {
+            m_memoryUsage -= checkpointSize(checkpoint.states);
+            continue;
+        }
+        lastSlot = slot;
+        kept.push_back(std::move(checkpoint));
+    }
+    m_checkpoints = std::move(kept);
+}
+
+} // namespace glmmd
+
+#endif
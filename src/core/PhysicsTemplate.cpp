@@ -0,0 +1,252 @@
+#ifndef GLMMD_DONT_USE_BULLET
+
+#include <cstddef>
+#include <map>
+#include <new>
+#include <tuple>
+
+#include <glm/gtx/component_wise.hpp>
+#include <glm/gtx/euler_angles.hpp>
+
+#include <glmmd/core/PhysicsTemplate.h>
+
+namespace glmmd
+{
+
+// Bullet's aligned allocator uses 16 bytes
+constexpr size_t POOL_ALIGNMENT = 16;
+
+inline static btVector3 glm2btVector3(const glm::vec3 &v)
+{
+    return {v.x, v.y, v.z};
+}
+
+inline static btQuaternion glm2btQuaternion(const glm::quat &q)
+{
+    return {q.x, q.y, q.z, q.w};
+}
+
+inline static btTransform glm2btTransform(const Transform &transform)
+{
+    btTransform t;
+    t.setOrigin(glm2btVector3(transform.translation));
+    t.setRotation(glm2btQuaternion(transform.rotation));
+    return t;
+}
+
+inline static btMatrix3x3 eulerAnglesToMatrix(const glm::vec3 &eulerAngles)
+{
+    glm::mat4 rot =
+        glm::eulerAngleYXZ(eulerAngles.y, eulerAngles.x, eulerAngles.z);
+    btMatrix3x3 m;
+    m.setIdentity();
+    m.setFromOpenGLSubMatrix(&rot[0][0]);
+    return m;
+}
+
+static size_t alignUp(size_t size)
+{
+    return (size + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT * POOL_ALIGNMENT;
+}
+
+PhysicsTemplate::PhysicsTemplate(const ModelData &modelData)
+{
+    std::map<std::tuple<RigidBodyShape, float, float, float>,
+             btCollisionShape *>
+        uniqueShapes;
+
+    m_bodies.reserve(modelData.rigidBodies.size());
+    for (const auto &rigidBody : modelData.rigidBodies)
+    {
+        auto &body = m_bodies.emplace_back();
+
+        auto &shape = uniqueShapes[{rigidBody.shape, rigidBody.size.x,
+                                    rigidBody.size.y, rigidBody.size.z}];
+        if (!shape)
+        {
+            switch (rigidBody.shape)
+            {
+            case RigidBodyShape::Sphere:
+                m_shapes.push_back(std::make_unique<btSphereShape>(
+                    rigidBody.getSphereRadius()));
+                break;
+            case RigidBodyShape::Capsule:
+                m_shapes.push_back(std::make_unique<btCapsuleShape>(
+                    rigidBody.getCapsuleRadius(),
+                    rigidBody.getCapsuleHeight()));
+                break;
+            case RigidBodyShape::Box:
+                m_shapes.push_back(std::make_unique<btBoxShape>(
+                    glm2btVector3(rigidBody.getBoxHalfExtents())));
+                break;
+            }
+            shape = m_shapes.back().get();
+        }
+        body.shape = shape;
+
+        switch (rigidBody.shape)
+        {
+        case RigidBodyShape::Sphere:
+            body.radius         = rigidBody.getSphereRadius();
+            body.boundingRadius = body.radius;
+            break;
+        case RigidBodyShape::Capsule:
+            body.radius         = rigidBody.getCapsuleRadius();
+            body.boundingRadius =
+                body.radius + 0.5f * rigidBody.getCapsuleHeight();
+            break;
+        case RigidBodyShape::Box:
+        {
+            glm::vec3 halfExtents = rigidBody.getBoxHalfExtents();
+            body.radius           = glm::compMin(halfExtents);
+            body.boundingRadius   = glm::length(halfExtents);
+            break;
+        }
+        }
+
+        body.kinematic =
+            rigidBody.physicsCalcType == PhysicsCalcType::Static;
+        body.mass = body.kinematic ? 0.f : rigidBody.mass;
+        if (body.mass != 0.f)
+            body.shape->calculateLocalInertia(body.mass, body.localInertia);
+        else
+            body.localInertia.setZero();
+
+        body.linearDamping  = rigidBody.linearDamping;
+        body.angularDamping = rigidBody.angularDamping;
+        body.restitution    = rigidBody.restitution;
+        body.friction       = rigidBody.friction;
+        body.group          = 1 << rigidBody.group;
+        body.mask           = rigidBody.collisionGroupMask;
+
+        body.offset.rotation    = glm::quat_cast(glm::eulerAngleYXZ(
+            rigidBody.rotation.y, rigidBody.rotation.x, rigidBody.rotation.z));
+        body.offset.translation = rigidBody.position;
+        body.offsetBt           = glm2btTransform(body.offset);
+    }
+
+    for (const auto &joint : modelData.joints)
+    {
+        if (joint.rigidBodyIndexA < 0 || joint.rigidBodyIndexB < 0 ||
+            joint.rigidBodyIndexA == joint.rigidBodyIndexB)
+            continue;
+
+        const auto &a = m_bodies[joint.rigidBodyIndexA];
+        const auto &b = m_bodies[joint.rigidBodyIndexB];
+        if (a.mass == 0.f && b.mass == 0.f)
+            continue;
+
+        btTransform transform;
+        transform.setOrigin(glm2btVector3(joint.position));
+        transform.setBasis(eulerAnglesToMatrix(joint.rotation));
+
+        auto &j             = m_joints.emplace_back();
+        j.bodyA             = static_cast<uint32_t>(joint.rigidBodyIndexA);
+        j.bodyB             = static_cast<uint32_t>(joint.rigidBodyIndexB);
+        j.frameA            = a.offsetBt.inverseTimes(transform);
+        j.frameB            = b.offsetBt.inverseTimes(transform);
+        j.linearLowerLimit  = glm2btVector3(joint.linearLowerLimit);
+        j.linearUpperLimit  = glm2btVector3(joint.linearUpperLimit);
+        j.angularLowerLimit = glm2btVector3(joint.angularLowerLimit);
+        j.angularUpperLimit = glm2btVector3(joint.angularUpperLimit);
+        for (int i = 0; i < 3; ++i)
+        {
+            j.stiffness[i]     = joint.linearStiffness[i];
+            j.stiffness[i + 3] = joint.angularStiffness[i];
+        }
+    }
+}
+
+PhysicsInstance::PhysicsInstance(
+    std::shared_ptr<const PhysicsTemplate> physicsTemplate,
+    const std::vector<Transform>          &bodyTransforms)
+    : m_template(std::move(physicsTemplate))
+    , m_bodyCount(m_template->bodies().size())
+    , m_jointCount(m_template->joints().size())
+{
+    static_assert(alignof(btDefaultMotionState) <= POOL_ALIGNMENT &&
+                  alignof(btRigidBody) <= POOL_ALIGNMENT &&
+                  alignof(btGeneric6DofSpringConstraint) <= POOL_ALIGNMENT);
+
+    size_t motionStatesSize =
+        alignUp(sizeof(btDefaultMotionState) * m_bodyCount);
+    size_t rigidBodiesSize = alignUp(sizeof(btRigidBody) * m_bodyCount);
+    size_t jointsSize = sizeof(btGeneric6DofSpringConstraint) * m_jointCount;
+
+    m_memory = ::operator new(motionStatesSize + rigidBodiesSize + jointsSize,
+                              std::align_val_t(POOL_ALIGNMENT));
+
+    auto *memory   = static_cast<std::byte *>(m_memory);
+    m_motionStates = reinterpret_cast<btDefaultMotionState *>(memory);
+    m_rigidBodies =
+        reinterpret_cast<btRigidBody *>(memory + motionStatesSize);
+    m_joints = reinterpret_cast<btGeneric6DofSpringConstraint *>(
+        memory + motionStatesSize + rigidBodiesSize);
+
+    const auto &bodies = m_template->bodies();
+    for (size_t i = 0; i < m_bodyCount; ++i)
+    {
+        const auto &body = bodies[i];
+
+        new (&m_motionStates[i])
+            btDefaultMotionState(glm2btTransform(bodyTransforms[i]));
+
+        btRigidBody::btRigidBodyConstructionInfo info(
+            body.mass, &m_motionStates[i], body.shape, body.localInertia);
+        info.m_linearDamping     = body.linearDamping;
+        info.m_angularDamping    = body.angularDamping;
+        info.m_restitution       = body.restitution;
+        info.m_friction          = body.friction;
+        info.m_additionalDamping = true;
+
+        auto &rigidBody = *new (&m_rigidBodies[i]) btRigidBody(info);
+        rigidBody.setSleepingThresholds(0.f, 0.f);
+
+        if (body.kinematic)
+        {
+            rigidBody.setCollisionFlags(rigidBody.getCollisionFlags() |
+                                        btCollisionObject::CF_KINEMATIC_OBJECT);
+            rigidBody.setActivationState(DISABLE_DEACTIVATION);
+        }
+        else
+            rigidBody.setActivationState(ACTIVE_TAG);
+    }
+
+    const auto &joints = m_template->joints();
+    for (size_t i = 0; i < m_jointCount; ++i)
+    {
+        const auto &joint = joints[i];
+
+        auto &constraint = *new (&m_joints[i]) btGeneric6DofSpringConstraint(
+            m_rigidBodies[joint.bodyA], m_rigidBodies[joint.bodyB],
+            joint.frameA, joint.frameB, true);
+
+        constraint.setLinearLowerLimit(joint.linearLowerLimit);
+        constraint.setLinearUpperLimit(joint.linearUpperLimit);
+        constraint.setAngularLowerLimit(joint.angularLowerLimit);
+        constraint.setAngularUpperLimit(joint.angularUpperLimit);
+
+        for (int k = 0; k < 6; ++k)
+        {
+            constraint.setStiffness(k, joint.stiffness[k]);
+            constraint.enableSpring(k, !btFuzzyZero(joint.stiffness[k]));
+        }
+    }
+}
+
+PhysicsInstance::~PhysicsInstance()
+{
+    // Constraints refer to the bodies, bodies to the motion states
+    for (size_t i = m_jointCount; i-- > 0;)
+        m_joints[i].~btGeneric6DofSpringConstraint();
+    for (size_t i = m_bodyCount; i-- > 0;)
+    {
+        m_rigidBodies[i].~btRigidBody();
+        m_motionStates[i].~btDefaultMotionState();
+    }
+    ::operator delete(m_memory, std::align_val_t(POOL_ALIGNMENT));
+}
+
+} // namespace glmmd
+
+#endif
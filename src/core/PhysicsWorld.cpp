@@ -1,14 +1,41 @@
 #ifndef GLMMD_DONT_USE_BULLET
 
-#include <glm/gtx/euler_angles.hpp>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+#ifdef GLMMD_BULLET_MULTITHREADED
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <LinearMath/btThreads.h>
+#endif
 
+#include <glmmd/core/ParallelForEach.h>
 #include <glmmd/core/PhysicsWorld.h>
+#include <glmmd/core/Trace.h>
 
 namespace glmmd
 {
 
 constexpr float GRAVITY_SCALE = 12.5f;
 
+// Adaptive stepping: joint separations above this refine the steps, below
+// half of it coarsen them. Bodies should move less than MAX_STEP_MOTION
+// times their radius per step.
+constexpr int   MAX_ADAPTIVE_STEPS = 4;
+constexpr float MAX_JOINT_ERROR    = 0.1f;
+constexpr float MAX_STEP_MOTION    = 0.5f;
+
+// Deactivation: bodies slower than this for Bullet's deactivation time go to
+// sleep, kinematic bodies moving less than this do not wake up a model.
+constexpr float SLEEP_LINEAR_SPEED  = 0.1f;
+constexpr float SLEEP_ANGULAR_SPEED = 0.1f;
+constexpr float WAKE_DISTANCE       = 1e-4f;
+constexpr float WAKE_ANGLE          = 1e-4f;
+
 inline static btVector3 glm2btVector3(const glm::vec3 &v)
 {
     return {v.x, v.y, v.z};
@@ -27,205 +54,801 @@ inline static btTransform glm2btTransform(const Transform &transform)
     return t;
 }
 
-inline static btMatrix3x3 eulerAnglesToMatrix(const glm::vec3 &eulerAngles)
+inline static Transform bt2glmTransform(const btTransform &transform)
+{
+    auto o = transform.getOrigin();
+    auto q = transform.getRotation();
+    return {.translation = glm::vec3(o.x(), o.y(), o.z()),
+            .rotation    = glm::quat(q.w(), q.x(), q.y(), q.z())};
+}
+
+static bool moved(const btTransform &from, const btTransform &to)
+{
+    // The vector part of the difference is sin(angle / 2) long
+    btQuaternion q = from.getRotation().inverse() * to.getRotation();
+    return (to.getOrigin() - from.getOrigin()).length2() >
+               WAKE_DISTANCE * WAKE_DISTANCE ||
+           btVector3(q.x(), q.y(), q.z()).length2() >
+               0.25f * WAKE_ANGLE * WAKE_ANGLE;
+}
+
+static void wakeUp(Model &model)
+{
+    for (const auto &body : model.physics().rigidBodies)
+        if (!body.rigidBody->isStaticOrKinematicObject())
+            body.rigidBody->activate(true);
+}
+
+static bool sleeping(const Model &model)
+{
+    for (const auto &body : model.physics().rigidBodies)
+        if (!body.rigidBody->isStaticOrKinematicObject() &&
+            body.rigidBody->isActive())
+            return false;
+    return true;
+}
+
+// Kinematic bodies follow their targets from the next step on. Returns
+// whether any of them moved noticeably, for a sleeping model since it fell
+// asleep, so that slow motion wakes it up too.
+static bool applyKinematicTargets(Model                        &model,
+                                  const std::vector<Transform> &targets)
+{
+    bool  asleep   = sleeping(model);
+    bool  anyMoved = false;
+    auto &bodies   = model.physics().rigidBodies;
+    for (size_t i = 0; i < bodies.size(); ++i)
+        if (model.data().rigidBodies[i].physicsCalcType ==
+            PhysicsCalcType::Static)
+        {
+            btTransform target = glm2btTransform(targets[i]);
+            if (asleep)
+                anyMoved = anyMoved || moved(bodies[i].awakeTarget, target);
+            else
+            {
+                btTransform current;
+                bodies[i].motionState->getWorldTransform(current);
+                anyMoved = anyMoved || moved(current, target);
+                bodies[i].awakeTarget = target;
+            }
+            bodies[i].motionState->setWorldTransform(target);
+        }
+    return anyMoved;
+}
+
+// Largest joint separation beyond the linear limits
+static float jointError(const Model &model)
+{
+    const auto &physics = model.physics();
+    const auto &joints  = physics.instance->physicsTemplate().joints();
+
+    float error = 0.f;
+    for (const auto &joint : joints)
+    {
+        btTransform a =
+            physics.rigidBodies[joint.bodyA].rigidBody->getWorldTransform() *
+            joint.frameA;
+        btTransform b =
+            physics.rigidBodies[joint.bodyB].rigidBody->getWorldTransform() *
+            joint.frameB;
+
+        btVector3 offset   = a.invXform(b.getOrigin());
+        btVector3 inLimits = offset;
+        for (int k = 0; k < 3; ++k)
+            if (joint.linearLowerLimit[k] <= joint.linearUpperLimit[k])
+                inLimits[k] = btClamped(offset[k], joint.linearLowerLimit[k],
+                                        joint.linearUpperLimit[k]);
+        error = std::max(error, offset.distance(inLimits));
+    }
+    return error;
+}
+
+// Largest speed of any point of a dynamic body relative to its radius
+static float relativeSpeed(const Model &model)
+{
+    const auto &physics = model.physics();
+    const auto &bodies  = physics.instance->physicsTemplate().bodies();
+
+    float speed = 0.f;
+    for (size_t i = 0; i < bodies.size(); ++i)
+    {
+        const auto &body = *physics.rigidBodies[i].rigidBody;
+        if (bodies[i].kinematic || bodies[i].radius <= 0.f)
+            continue;
+        float s = body.getLinearVelocity().length() +
+                  body.getAngularVelocity().length() *
+                      bodies[i].boundingRadius;
+        speed   = std::max(speed, s / bodies[i].radius);
+    }
+    return speed;
+}
+
+static void readBodyTransforms(const Model            &model,
+                               std::vector<Transform> &transforms)
+{
+    const auto &bodies = model.physics().rigidBodies;
+    for (size_t i = 0; i < bodies.size(); ++i)
+    {
+        btTransform t;
+        bodies[i].motionState->getWorldTransform(t);
+        transforms[i] = bt2glmTransform(t);
+    }
+}
+
+static Transform interpolate(const Transform &a, const Transform &b, float t)
+{
+    return {.translation = glm::mix(a.translation, b.translation, t),
+            .rotation    = glm::slerp(a.rotation, b.rotation, t)};
+}
+
+#ifdef GLMMD_BULLET_MULTITHREADED
+// Runs Bullet's parallel loops on glmmd's parallel backend. Bullet indexes
+// per-thread data with btGetCurrentThreadIndex(), which counts every thread
+// that ever entered Bullet, so getNumThreads() reports the maximum and the
+// configured thread count only limits the number of chunks per loop. The
+// maximum is BT_MAX_THREAD_COUNT (64), btCollisionDispatcherMt sizes its
+// per-thread manifold lists by it, two arrays of 64 mostly empty lists.
+class PhysicsTaskScheduler : public btITaskScheduler
+{
+public:
+    PhysicsTaskScheduler()
+        : btITaskScheduler("glmmd")
+    {
+    }
+
+    int  getMaxNumThreads() const override { return BT_MAX_THREAD_COUNT; }
+    int  getNumThreads() const override { return BT_MAX_THREAD_COUNT; }
+    void setNumThreads(int numThreads) override
+    {
+        m_concurrency = std::clamp(numThreads, 1, BT_MAX_THREAD_COUNT);
+    }
+
+    void parallelFor(int iBegin, int iEnd, int grainSize,
+                     const btIParallelForBody &body) override
+    {
+        // Member functions hide the free ones
+        glmmd::parallelForChunked(
+            iBegin, iEnd, chunkSize(iBegin, iEnd, grainSize),
+            [&body](size_t first, size_t last)
+            { body.forLoop(static_cast<int>(first), static_cast<int>(last)); });
+    }
+
+    btScalar parallelSum(int iBegin, int iEnd, int grainSize,
+                         const btIParallelSumBody &body) override
+    {
+        if (iBegin >= iEnd)
+            return btScalar(0);
+
+        // Fixed chunks summed in order, so results do not depend on timing
+        int    chunk = chunkSize(iBegin, iEnd, grainSize);
+        size_t count = static_cast<size_t>((iEnd - iBegin + chunk - 1) / chunk);
+        std::vector<btScalar> sums(count);
+        glmmd::parallelFor(0, count, 1,
+                           [&](size_t i)
+                           {
+                               int first = iBegin + static_cast<int>(i) * chunk;
+                               sums[i]   = body.sumLoop(
+                                   first, std::min(first + chunk, iEnd));
+                           });
+        return std::accumulate(sums.begin(), sums.end(), btScalar(0));
+    }
+
+private:
+    int chunkSize(int iBegin, int iEnd, int grainSize) const
+    {
+        int n = iEnd - iBegin;
+        return std::max({grainSize, (n + m_concurrency - 1) / m_concurrency,
+                         1});
+    }
+
+private:
+    int m_concurrency = BT_MAX_THREAD_COUNT;
+};
+
+static PhysicsTaskScheduler &physicsTaskScheduler()
 {
-    glm::mat4 rot =
-        glm::eulerAngleYXZ(eulerAngles.y, eulerAngles.x, eulerAngles.z);
-    btMatrix3x3 m;
-    m.setIdentity();
-    m.setFromOpenGLSubMatrix(&rot[0][0]);
-    return m;
+    static PhysicsTaskScheduler scheduler;
+    return scheduler;
 }
+#endif
 
 PhysicsWorld::PhysicsWorld()
-    : m_collisionConfig(new btDefaultCollisionConfiguration())
-    , m_dispatcher(new btCollisionDispatcher(m_collisionConfig.get()))
-    , m_broadphase(new btDbvtBroadphase())
-    , m_solver(new btSequentialImpulseConstraintSolver())
-    , m_world(new btDiscreteDynamicsWorld(m_dispatcher.get(),
-                                          m_broadphase.get(), m_solver.get(),
-                                          m_collisionConfig.get()))
-    , m_groundShape(new btStaticPlaneShape(btVector3(0.f, 1.f, 0.f), 0.f))
+    : m_groundShape(new btStaticPlaneShape(btVector3(0.f, 1.f, 0.f), 0.f))
     , m_gravity(btVector3(0.f, -9.8f, 0.f) * GRAVITY_SCALE)
 {
-    m_world->setGravity(m_gravity);
+    m_scenes.push_back(createScene());
+}
+
+PhysicsWorld::~PhysicsWorld()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_threadRunning = false;
+        m_threadExit    = true;
+    }
+    m_threadResumed.notify_one();
+    if (m_thread.joinable())
+        m_thread.join();
+
+    for (const auto &scene : m_scenes)
+        scene->world->removeRigidBody(scene->groundRigidBody.get());
+}
+
+std::unique_ptr<PhysicsWorld::Scene> PhysicsWorld::createScene() const
+{
+    auto scene = std::make_unique<Scene>();
+
+    scene->collisionConfig =
+        std::make_unique<btDefaultCollisionConfiguration>();
+    scene->broadphase = std::make_unique<btDbvtBroadphase>();
+
+    if (m_multithreaded)
+    {
+#ifdef GLMMD_BULLET_MULTITHREADED
+        uint32_t threadCount = m_threadCount != 0
+                                   ? m_threadCount
+                                   : std::thread::hardware_concurrency();
+        threadCount          = std::max(threadCount, 1u);
+
+        auto &scheduler = physicsTaskScheduler();
+        scheduler.setNumThreads(static_cast<int>(threadCount));
+        btSetTaskScheduler(&scheduler);
+
+        auto solverPool = std::make_unique<btConstraintSolverPoolMt>(
+            static_cast<int>(threadCount));
+
+        scene->dispatcher = std::make_unique<btCollisionDispatcherMt>(
+            scene->collisionConfig.get());
+        scene->solverMt =
+            std::make_unique<btSequentialImpulseConstraintSolverMt>();
+        scene->world = std::make_unique<btDiscreteDynamicsWorldMt>(
+            scene->dispatcher.get(), scene->broadphase.get(), solverPool.get(),
+            scene->solverMt.get(), scene->collisionConfig.get());
+        scene->solver = std::move(solverPool);
+#endif
+    }
+    else
+    {
+        scene->dispatcher = std::make_unique<btCollisionDispatcher>(
+            scene->collisionConfig.get());
+        scene->solver =
+            std::make_unique<btSequentialImpulseConstraintSolver>();
+        scene->world = std::make_unique<btDiscreteDynamicsWorld>(
+            scene->dispatcher.get(), scene->broadphase.get(),
+            scene->solver.get(), scene->collisionConfig.get());
+    }
+
+    scene->world->setGravity(m_gravity);
+    scene->world->getSolverInfo().m_numIterations = m_solverIterations;
 
     btTransform groundTransform;
     groundTransform.setIdentity();
-    m_groundMotionState =
+    scene->groundMotionState =
         std::make_unique<btDefaultMotionState>(groundTransform);
 
     btRigidBody::btRigidBodyConstructionInfo groundInfo(
-        0.f, m_groundMotionState.get(), m_groundShape.get(),
+        0.f, scene->groundMotionState.get(), m_groundShape.get(),
         btVector3(0.f, 0.f, 0.f));
-    m_groundRigidBody = std::make_unique<btRigidBody>(groundInfo);
+    scene->groundRigidBody = std::make_unique<btRigidBody>(groundInfo);
+
+    scene->world->addRigidBody(scene->groundRigidBody.get(), 1 << 15, 0x7FFF);
+
+    return scene;
+}
+
+PhysicsWorld::Scene *PhysicsWorld::findScene(const Model &model,
+                                             size_t      *entryIndex) const
+{
+    for (const auto &scene : m_scenes)
+        for (size_t i = 0; i < scene->models.size(); ++i)
+            if (scene->models[i].model == &model)
+            {
+                if (entryIndex)
+                    *entryIndex = i;
+                return scene.get();
+            }
+    return nullptr;
+}
 
-    m_world->addRigidBody(m_groundRigidBody.get(), 1 << 15, 0x7FFF);
+template <typename Func>
+void PhysicsWorld::forEachScene(Func &&func)
+{
+#ifdef GLMMD_BULLET_PARALLEL_WORLDS
+    // Multithreaded worlds already parallelize internally
+    if (m_scenes.size() > 1 && !m_multithreaded)
+    {
+        parallelFor(0, m_scenes.size(), 1,
+                    [&](size_t i) { func(*m_scenes[i]); });
+        return;
+    }
+#endif
+
+    for (const auto &scene : m_scenes)
+        func(*scene);
 }
 
 void PhysicsWorld::update(float deltaTime, int maxSubSteps,
                           float fixedDeltaTime)
 {
-    m_world->stepSimulation(deltaTime, maxSubSteps, fixedDeltaTime);
+    if (threadRunning())
+    {
+        updateFromThread();
+        return;
+    }
+
+    forEachScene(
+        [&](Scene &scene)
+        {
+            for (const auto &entry : scene.models)
+                if (applyKinematicTargets(
+                        *entry.model, entry.model->physics().bodyTransforms) &&
+                    m_deactivation)
+                    wakeUp(*entry.model);
+
+            stepScene(scene, deltaTime, maxSubSteps, fixedDeltaTime);
+
+            for (const auto &entry : scene.models)
+                readBodyTransforms(*entry.model,
+                                   entry.model->physics().bodyTransforms);
+        });
 }
 
-void PhysicsWorld::setGravity(const glm::vec3 &gravity)
+void PhysicsWorld::stepScene(Scene &scene, float deltaTime, int maxSubSteps,
+                             float fixedDeltaTime)
 {
-    m_gravity = glm2btVector3(gravity) * GRAVITY_SCALE;
-    m_world->setGravity(m_gravity);
+    if (m_deactivation &&
+        std::all_of(scene.models.begin(), scene.models.end(),
+                    [](const auto &entry) { return sleeping(*entry.model); }))
+        return;
+
+    // Variable steps, with maxSubSteps <= 0, are not split
+    int steps = m_adaptiveStepping && maxSubSteps > 0 ? scene.steps : 1;
+    scene.world->stepSimulation(deltaTime, maxSubSteps * steps,
+                                fixedDeltaTime / static_cast<float>(steps));
+
+    if (m_adaptiveStepping && maxSubSteps > 0)
+        adaptSteps(scene, fixedDeltaTime);
 }
 
-void PhysicsWorld::setupModelPhysics(Model &model, bool applyCurrentTransforms)
+void PhysicsWorld::adaptSteps(Scene &scene, float fixedDeltaTime) const
 {
-    setupModelRigidBodies(model, applyCurrentTransforms);
-    setupModelJoints(model);
+    float error = 0.f, speed = 0.f;
+    for (const auto &entry : scene.models)
+    {
+        error = std::max(error, jointError(*entry.model) / MAX_JOINT_ERROR);
+        speed = std::max(speed, relativeSpeed(*entry.model));
+    }
+
+    int needed = static_cast<int>(
+        std::ceil(speed * fixedDeltaTime / MAX_STEP_MOTION));
+
+    if (error > 1.f)
+        scene.steps *= 2;
+    else if (error < 0.5f)
+        --scene.steps;
+    scene.steps = std::clamp(std::max(scene.steps, needed), 1,
+                             MAX_ADAPTIVE_STEPS);
 }
 
-void PhysicsWorld::setupModelRigidBodies(Model &model,
-                                         bool   applyCurrentTransforms)
+void PhysicsWorld::updateFromThread()
+{
+    using namespace std::chrono;
+
+    double renderTime =
+        duration<double>(steady_clock::now() - m_threadEpoch).count() -
+        m_threadDeltaTime;
+
+    for (const auto &scene : m_scenes)
+        for (const auto &entry : scene->models)
+        {
+            auto &exchange       = *entry.exchange;
+            auto &bodyTransforms = entry.model->physics().bodyTransforms;
+
+            exchange.targets.back() = bodyTransforms;
+            exchange.targets.publish();
+
+            exchange.results.fetch();
+            const auto &result = exchange.results.front();
+
+            float t = static_cast<float>(
+                (renderTime - result.time) / m_threadDeltaTime + 1.0);
+            t       = glm::clamp(t, 0.f, 1.f);
+
+            const auto &rigidBodies = entry.model->data().rigidBodies;
+            for (size_t i = 0; i < bodyTransforms.size(); ++i)
+                if (rigidBodies[i].physicsCalcType != PhysicsCalcType::Static)
+                    bodyTransforms[i] = interpolate(result.previous[i],
+                                                    result.current[i], t);
+        }
+}
+
+void PhysicsWorld::startThread(float fixedDeltaTime, int maxSubSteps)
 {
-    model.physics().rigidBodies.clear();
-    model.physics().rigidBodies.reserve(model.data().rigidBodies.size());
-    for (const auto &rigidBody : model.data().rigidBodies)
     {
-        auto &body = model.physics().rigidBodies.emplace_back();
+        std::lock_guard lock(m_mutex);
+        m_threadDeltaTime   = fixedDeltaTime;
+        m_threadMaxSubSteps = std::max(maxSubSteps, 1);
+        m_threadEpoch       = std::chrono::steady_clock::now();
+        m_threadRunning     = true;
+        ++m_threadStarts;
+    }
+
+    if (m_thread.joinable())
+        m_threadResumed.notify_one();
+    else
+        m_thread = std::thread(&PhysicsWorld::threadLoop, this);
+}
+
+void PhysicsWorld::stopThread()
+{
+    // The thread checks m_threadRunning before every step
+    std::lock_guard lock(m_mutex);
+    m_threadRunning = false;
+}
 
-        switch (rigidBody.shape)
+void PhysicsWorld::threadLoop()
+{
+    using namespace std::chrono;
+
+    GLMMD_TRACE_THREAD_NAME("physics");
+
+    uint32_t                 starts = 0;
+    steady_clock::duration   period{};
+    steady_clock::time_point next;
+    int                      maxSubSteps = 1;
+
+    while (true)
+    {
         {
-        case RigidBodyShape::Sphere:
-            body.shape =
-                std::make_unique<btSphereShape>(rigidBody.getSphereRadius());
-            break;
-        case RigidBodyShape::Capsule:
-            body.shape = std::make_unique<btCapsuleShape>(
-                rigidBody.getCapsuleRadius(), rigidBody.getCapsuleHeight());
-            break;
-        case RigidBodyShape::Box:
-            body.shape = std::make_unique<btBoxShape>(
-                glm2btVector3(rigidBody.getBoxHalfExtents()));
-            break;
+            std::unique_lock lock(m_mutex);
+            m_threadResumed.wait(
+                lock, [this] { return m_threadRunning || m_threadExit; });
+            if (m_threadExit)
+                return;
+
+            if (starts != m_threadStarts)
+            {
+                starts      = m_threadStarts;
+                period      = duration_cast<steady_clock::duration>(
+                    duration<double>(m_threadDeltaTime));
+                next        = steady_clock::now();
+                maxSubSteps = m_threadMaxSubSteps;
+            }
+
+            next += period;
+            stepThread(duration<double>(next - m_threadEpoch).count());
         }
 
-        btVector3 localInertia;
-        float     mass = rigidBody.physicsCalcType == PhysicsCalcType::Static
-                             ? 0.f
-                             : rigidBody.mass;
-        if (mass != 0.f)
-            body.shape->calculateLocalInertia(mass, localInertia);
-        else
-            localInertia.setZero();
-
-        btTransform offset;
-
-        glm::mat4 rot = glm::eulerAngleYXZ(
-            rigidBody.rotation.y, rigidBody.rotation.x, rigidBody.rotation.z);
-        body.offset.rotation = glm::quat_cast(rot);
-        btMatrix3x3 m;
-        m.setIdentity();
-        m.setFromOpenGLSubMatrix(&rot[0][0]);
-        offset.setBasis(m);
-        body.offset.translation = rigidBody.position;
-        offset.setOrigin(glm2btVector3(rigidBody.position));
-
-        if (applyCurrentTransforms && rigidBody.boneIndex >= 0)
+        auto now = steady_clock::now();
+        if (now - next > maxSubSteps * period)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void PhysicsWorld::stepThread(double time)
+{
+    GLMMD_TRACE_SCOPE("physics step");
+
+    forEachScene(
+        [&](Scene &scene)
         {
-            int32_t j = rigidBody.boneIndex;
+            for (const auto &entry : scene.models)
+                if (entry.exchange->targets.fetch() &&
+                    applyKinematicTargets(*entry.model,
+                                          entry.exchange->targets.front()) &&
+                    m_deactivation)
+                    wakeUp(*entry.model);
+
+            stepScene(scene, m_threadDeltaTime, 1, m_threadDeltaTime);
+
+            for (const auto &entry : scene.models)
+            {
+                auto &exchange = *entry.exchange;
+                auto &result   = exchange.results.back();
+
+                result.previous = exchange.last;
+                readBodyTransforms(*entry.model, result.current);
+                result.time   = time;
+                exchange.last = result.current;
+
+                exchange.results.publish();
+            }
+        });
+}
 
-            Transform t = body.offset;
-            t.translation -= model.data().bones[j].position;
-            t *= model.pose().getGlobalBoneTransform(j);
+void PhysicsWorld::setGravity(const glm::vec3 &gravity)
+{
+    std::lock_guard lock(m_mutex);
 
-            body.motionState =
-                std::make_unique<btDefaultMotionState>(glm2btTransform(t));
-        }
-        else
-            body.motionState = std::make_unique<btDefaultMotionState>(offset);
+    m_gravity = glm2btVector3(gravity) * GRAVITY_SCALE;
+    for (const auto &scene : m_scenes)
+    {
+        scene->world->setGravity(m_gravity);
+        for (const auto &entry : scene->models)
+            wakeUp(*entry.model);
+    }
+}
 
-        btRigidBody::btRigidBodyConstructionInfo info(
-            mass, body.motionState.get(), body.shape.get(), localInertia);
-        info.m_linearDamping     = rigidBody.linearDamping;
-        info.m_angularDamping    = rigidBody.angularDamping;
-        info.m_restitution       = rigidBody.restitution;
-        info.m_friction          = rigidBody.friction;
-        info.m_additionalDamping = true;
+void PhysicsWorld::saveState(const Model &model, ModelPhysicsState &state) const
+{
+    std::lock_guard lock(m_mutex);
+
+    const auto &bodies = model.physics().rigidBodies;
+    state.resize(bodies.size());
+    for (size_t i = 0; i < bodies.size(); ++i)
+    {
+        const auto &body = *bodies[i].rigidBody;
+        const auto &v    = body.getLinearVelocity();
+        const auto &w    = body.getAngularVelocity();
+
+        state[i].transform       = bt2glmTransform(body.getWorldTransform());
+        state[i].linearVelocity  = glm::vec3(v.x(), v.y(), v.z());
+        state[i].angularVelocity = glm::vec3(w.x(), w.y(), w.z());
+    }
+}
+
+void PhysicsWorld::restoreState(Model &model, const ModelPhysicsState &state)
+{
+    std::lock_guard lock(m_mutex);
+
+    Scene *scene = findScene(model);
+    if (!scene || state.size() != model.physics().rigidBodies.size())
+        return;
 
-        body.rigidBody = std::make_unique<btRigidBody>(info);
-        body.rigidBody->setSleepingThresholds(0.f, 0.f);
+    auto *pairCache = scene->world->getBroadphase()->getOverlappingPairCache();
+    auto &bodies    = model.physics().rigidBodies;
+    for (size_t i = 0; i < bodies.size(); ++i)
+    {
+        auto     &body = *bodies[i].rigidBody;
+        btTransform t  = glm2btTransform(state[i].transform);
+        btVector3   v  = glm2btVector3(state[i].linearVelocity);
+        btVector3   w  = glm2btVector3(state[i].angularVelocity);
+
+        body.setWorldTransform(t);
+        body.setInterpolationWorldTransform(t);
+        bodies[i].motionState->setWorldTransform(t);
+
+        body.setLinearVelocity(v);
+        body.setAngularVelocity(w);
+        body.setInterpolationLinearVelocity(v);
+        body.setInterpolationAngularVelocity(w);
+        body.clearForces();
+        if (!body.isStaticOrKinematicObject())
+            body.activate(true);
+
+        if (body.getBroadphaseHandle())
+            pairCache->cleanProxyFromPairs(body.getBroadphaseHandle(),
+                                           scene->world->getDispatcher());
+
+        model.physics().bodyTransforms[i] = state[i].transform;
+    }
+}
+
+template <typename Func>
+void PhysicsWorld::recreateScenes(Func &&change)
+{
+    std::lock_guard lock(m_mutex);
+
+    std::vector<std::pair<Model *, bool>> models;
+    for (const auto &scene : m_scenes)
+        for (const auto &entry : scene->models)
+            models.emplace_back(entry.model, entry.collideWithOtherModels);
+
+    for (const auto &[model, collideWithOtherModels] : models)
+        removeModel(*model);
+
+    change();
+
+    m_scenes[0]->world->removeRigidBody(m_scenes[0]->groundRigidBody.get());
+    m_scenes.clear();
+    m_scenes.push_back(createScene());
+
+    for (const auto &[model, collideWithOtherModels] : models)
+        addModel(*model, true, collideWithOtherModels);
+}
+
+void PhysicsWorld::setPerModelWorlds(bool enabled)
+{
+    if (m_perModelWorlds != enabled)
+        recreateScenes([&] { m_perModelWorlds = enabled; });
+}
+
+void PhysicsWorld::setMultithreaded(bool enabled)
+{
+#ifndef GLMMD_BULLET_MULTITHREADED
+    if (enabled)
+        throw std::runtime_error(
+            "glmmd was built without multithreaded Bullet.");
+#endif
+    if (m_multithreaded != enabled)
+        recreateScenes([&] { m_multithreaded = enabled; });
+}
 
-        if (rigidBody.physicsCalcType == PhysicsCalcType::Static)
+void PhysicsWorld::setThreadCount(uint32_t count)
+{
+    if (m_threadCount == count)
+        return;
+    if (m_multithreaded)
+        recreateScenes([&] { m_threadCount = count; });
+    else
+        m_threadCount = count;
+}
+
+void PhysicsWorld::setSolverIterations(int iterations)
+{
+    std::lock_guard lock(m_mutex);
+
+    m_solverIterations = std::max(iterations, 1);
+    for (const auto &scene : m_scenes)
+        scene->world->getSolverInfo().m_numIterations = m_solverIterations;
+}
+
+void PhysicsWorld::setAdaptiveStepping(bool enabled)
+{
+    std::lock_guard lock(m_mutex);
+
+    m_adaptiveStepping = enabled;
+    for (const auto &scene : m_scenes)
+        scene->steps = 1;
+}
+
+void PhysicsWorld::setDeactivation(bool enabled)
+{
+    std::lock_guard lock(m_mutex);
+
+    m_deactivation = enabled;
+    for (const auto &scene : m_scenes)
+        for (const auto &entry : scene->models)
         {
-            body.rigidBody->setCollisionFlags(
-                body.rigidBody->getCollisionFlags() |
-                btCollisionObject::CF_KINEMATIC_OBJECT);
-            body.rigidBody->setActivationState(DISABLE_DEACTIVATION);
+            applySleepingThresholds(*entry.model);
+            wakeUp(*entry.model);
         }
-        else
+}
+
+bool PhysicsWorld::isSleeping(const Model &model) const
+{
+    std::lock_guard lock(m_mutex);
+    return m_deactivation && findScene(model) && sleeping(model);
+}
+
+void PhysicsWorld::applySleepingThresholds(Model &model) const
+{
+    for (const auto &body : model.physics().rigidBodies)
+        if (!body.rigidBody->isStaticOrKinematicObject())
         {
-            body.rigidBody->setActivationState(ACTIVE_TAG);
+            if (m_deactivation)
+                body.rigidBody->setSleepingThresholds(SLEEP_LINEAR_SPEED,
+                                                      SLEEP_ANGULAR_SPEED);
+            else
+                body.rigidBody->setSleepingThresholds(0.f, 0.f);
         }
+}
 
-        m_world->addRigidBody(body.rigidBody.get(), 1 << rigidBody.group,
-                              rigidBody.collisionGroupMask);
-    }
+void PhysicsWorld::setupModelPhysics(Model &model, bool applyCurrentTransforms,
+                                     bool collideWithOtherModels)
+{
+    std::lock_guard lock(m_mutex);
+    addModel(model, applyCurrentTransforms, collideWithOtherModels);
 }
 
-void PhysicsWorld::setupModelJoints(Model &model)
+void PhysicsWorld::clearModelPhysics(Model &model)
 {
-    model.physics().joints.clear();
-    model.physics().joints.reserve(model.data().joints.size());
-    for (const auto &joint : model.data().joints)
-    {
-        if (joint.rigidBodyIndexA < 0 || joint.rigidBodyIndexB < 0 ||
-            joint.rigidBodyIndexA == joint.rigidBodyIndexB)
-            continue;
+    std::lock_guard lock(m_mutex);
+    removeModel(model);
+}
 
-        const auto &a = model.physics().rigidBodies[joint.rigidBodyIndexA];
-        const auto &b = model.physics().rigidBodies[joint.rigidBodyIndexB];
+void PhysicsWorld::addModel(Model &model, bool applyCurrentTransforms,
+                            bool collideWithOtherModels)
+{
+    Scene *scene = m_scenes[0].get();
+    if (m_perModelWorlds && !collideWithOtherModels)
+        scene = m_scenes.emplace_back(createScene()).get();
 
-        if (a.rigidBody->getMass() == 0.f && b.rigidBody->getMass() == 0.f)
-            continue;
+    setupModelRigidBodies(*scene->world, model, applyCurrentTransforms);
+    setupModelJoints(*scene->world, model);
 
-        auto &constraint = model.physics().joints.emplace_back();
+    scene->models.push_back(
+        {&model, collideWithOtherModels,
+         std::make_unique<Exchange>(model.physics().bodyTransforms)});
+}
 
-        btTransform transform;
-        transform.setOrigin(glm2btVector3(joint.position));
-        transform.setBasis(eulerAnglesToMatrix(joint.rotation));
+std::shared_ptr<const PhysicsTemplate>
+PhysicsWorld::physicsTemplate(const ModelData &modelData)
+{
+    auto &cached = m_templates[&modelData];
+    if (auto t = cached.lock())
+        return t;
+
+    auto t = std::make_shared<const PhysicsTemplate>(modelData);
+    cached = t;
+    std::erase_if(m_templates,
+                  [](const auto &entry) { return entry.second.expired(); });
+    return t;
+}
 
-        auto invA = glm2btTransform(a.offset).inverseTimes(transform);
-        auto invB = glm2btTransform(b.offset).inverseTimes(transform);
+void PhysicsWorld::setupModelRigidBodies(btDiscreteDynamicsWorld &world,
+                                         Model                   &model,
+                                         bool applyCurrentTransforms)
+{
+    auto  physicsTemplate = this->physicsTemplate(model.data());
+    auto &physics         = model.physics();
 
-        constraint = std::make_unique<btGeneric6DofSpringConstraint>(
-            *a.rigidBody, *b.rigidBody, invA, invB, true);
+    const auto &bodies = physicsTemplate->bodies();
 
-        constraint->setLinearLowerLimit(glm2btVector3(joint.linearLowerLimit));
-        constraint->setLinearUpperLimit(glm2btVector3(joint.linearUpperLimit));
-        constraint->setAngularLowerLimit(
-            glm2btVector3(joint.angularLowerLimit));
-        constraint->setAngularUpperLimit(
-            glm2btVector3(joint.angularUpperLimit));
+    physics.bodyTransforms.clear();
+    physics.bodyTransforms.reserve(bodies.size());
+    for (size_t i = 0; i < bodies.size(); ++i)
+    {
+        Transform t = bodies[i].offset;
 
-        for (int i = 0; i < 3; ++i)
+        int32_t j = model.data().rigidBodies[i].boneIndex;
+        if (applyCurrentTransforms && j >= 0)
         {
-            constraint->setStiffness(i, joint.linearStiffness[i]);
-            constraint->enableSpring(i, !btFuzzyZero(joint.linearStiffness[i]));
-            constraint->setStiffness(i + 3, joint.angularStiffness[i]);
-            constraint->enableSpring(i + 3,
-                                     !btFuzzyZero(joint.angularStiffness[i]));
+            t.translation -= model.data().bones[j].position;
+            t *= model.pose().getGlobalBoneTransform(j);
         }
+        physics.bodyTransforms.push_back(t);
+    }
+
+    physics.instance = std::make_unique<PhysicsInstance>(
+        std::move(physicsTemplate), physics.bodyTransforms);
+
+    physics.rigidBodies.clear();
+    physics.rigidBodies.resize(bodies.size());
+    for (size_t i = 0; i < bodies.size(); ++i)
+    {
+        auto &body       = physics.rigidBodies[i];
+        body.offset      = bodies[i].offset;
+        body.shape       = bodies[i].shape;
+        body.motionState = &physics.instance->motionState(i);
+        body.rigidBody   = &physics.instance->rigidBody(i);
 
-        m_world->addConstraint(constraint.get());
+        world.addRigidBody(body.rigidBody, bodies[i].group, bodies[i].mask);
     }
+    applySleepingThresholds(model);
 }
 
-void PhysicsWorld::clearModelPhysics(Model &model)
+void PhysicsWorld::setupModelJoints(btDiscreteDynamicsWorld &world,
+                                    Model                   &model)
 {
-    for (const auto &j : model.physics().joints)
-        m_world->removeConstraint(j.get());
+    auto &physics = model.physics();
+
+    physics.joints.clear();
+    physics.joints.reserve(physics.instance->jointCount());
+    for (size_t i = 0; i < physics.instance->jointCount(); ++i)
+    {
+        auto *constraint = &physics.instance->joint(i);
+        physics.joints.push_back(constraint);
+        world.addConstraint(constraint);
+    }
+}
+
+void PhysicsWorld::removeModel(Model &model)
+{
+    size_t entryIndex;
+    Scene *scene = findScene(model, &entryIndex);
+    if (!scene)
+        return;
+
+    for (auto *j : model.physics().joints)
+        scene->world->removeConstraint(j);
     model.physics().joints.clear();
 
     for (const auto &r : model.physics().rigidBodies)
-        m_world->removeRigidBody(r.rigidBody.get());
+        scene->world->removeRigidBody(r.rigidBody);
     model.physics().rigidBodies.clear();
+    model.physics().bodyTransforms.clear();
+    model.physics().instance.reset();
+
+    scene->models.erase(scene->models.begin() + entryIndex);
+
+    if (scene != m_scenes[0].get() && scene->models.empty())
+    {
+        scene->world->removeRigidBody(scene->groundRigidBody.get());
+        std::erase_if(m_scenes,
+                      [scene](const auto &s) { return s.get() == scene; });
+    }
 }
 
 } // namespace glmmd
@@ -0,0 +1,223 @@
+#include <cassert>
+#include <thread>
+
+#ifdef GLMMD_USE_TBB
+#include <tbb/task_arena.h>
+#endif
+
+#include <glmmd/core/TaskGraph.h>
+
+namespace glmmd
+{
+
+#ifndef GLMMD_USE_TBB
+template <typename T, typename Done>
+void TaskGraph::helpPool(const std::atomic<T> &value, Done done)
+{
+    constexpr int spinCount = 64;
+
+    int idle = 0;
+    while (true)
+    {
+        T current = value.load(std::memory_order_acquire);
+        if (done(current))
+            return;
+
+        if (m_pool->tryRunOne())
+            idle = 0;
+        else if (++idle < spinCount)
+            std::this_thread::yield();
+        else
+        {
+            value.wait(current, std::memory_order_acquire);
+            idle = 0;
+        }
+    }
+}
+#endif
+
+TaskGraph::~TaskGraph()
+{
+#ifdef GLMMD_USE_TBB
+    m_group.wait();
+#else
+    if (m_job)
+        waitForTasks();
+#endif
+}
+
+TaskGraph::TaskId TaskGraph::addTask(std::function<void()> func)
+{
+    auto &task = m_tasks.emplace_back();
+    task.func  = std::move(func);
+    return static_cast<TaskId>(m_tasks.size() - 1);
+}
+
+void TaskGraph::precede(TaskId before, TaskId after)
+{
+    assert(before < m_tasks.size() && after < m_tasks.size());
+    m_tasks[before].successors.push_back(after);
+    ++m_tasks[after].dependencyCount;
+}
+
+void TaskGraph::clear()
+{
+#ifdef GLMMD_USE_TBB
+    if (m_started)
+        wait();
+    m_started = false;
+#else
+    if (m_job)
+        wait();
+    m_job.reset();
+#endif
+    m_tasks.clear();
+}
+
+#ifdef GLMMD_USE_TBB
+void TaskGraph::start()
+{
+    if (m_started)
+        wait();
+#else
+void TaskGraph::start(ThreadPool &pool)
+{
+    if (m_job)
+        wait();
+#endif
+
+    const size_t count = m_tasks.size();
+
+    m_pending = std::make_unique<std::atomic<uint32_t>[]>(count);
+    m_done    = std::make_unique<std::atomic<bool>[]>(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        m_pending[i].store(m_tasks[i].dependencyCount,
+                           std::memory_order_relaxed);
+        m_done[i].store(false, std::memory_order_relaxed);
+    }
+
+    m_failed.store(false, std::memory_order_relaxed);
+    m_exception = nullptr;
+
+#ifdef GLMMD_USE_TBB
+    m_started = true;
+#else
+    m_pool        = &pool;
+    m_job         = std::make_unique<ThreadPool::Job>();
+    m_job->invoke = [](const void *graph, size_t id, size_t)
+    {
+        static_cast<TaskGraph *>(const_cast<void *>(graph))
+            ->runTask(static_cast<TaskId>(id));
+    };
+    m_job->func  = this;
+    m_job->grain = 1;
+    m_job->remaining.store(count, std::memory_order_release);
+    m_unfinished.store(static_cast<uint32_t>(count),
+                       std::memory_order_release);
+#endif
+
+    for (size_t i = 0; i < count; ++i)
+        if (m_tasks[i].dependencyCount == 0)
+            schedule(static_cast<TaskId>(i));
+}
+
+void TaskGraph::schedule(TaskId id)
+{
+#ifdef GLMMD_USE_TBB
+    m_group.run([this, id] { runTask(id); });
+#else
+    m_pool->push({m_job.get(), id, id + 1});
+#endif
+}
+
+void TaskGraph::runTask(TaskId id)
+{
+    try
+    {
+        if (!m_failed.load(std::memory_order_relaxed))
+            m_tasks[id].func();
+    }
+    catch (...)
+    {
+        if (!m_failed.exchange(true))
+            m_exception = std::current_exception();
+    }
+
+    m_done[id].store(true, std::memory_order_release);
+    m_done[id].notify_all();
+
+    // Successors of a failed task are still released, but skipped, so that
+    // the graph always drains.
+    for (auto next : m_tasks[id].successors)
+        if (m_pending[next].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            schedule(next);
+
+#ifndef GLMMD_USE_TBB
+    if (m_unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        m_unfinished.notify_all();
+#endif
+}
+
+void TaskGraph::wait(TaskId id)
+{
+#ifdef GLMMD_USE_TBB
+    assert(m_started && id < m_tasks.size());
+
+    // A task group cannot run a chosen task on this thread, so without
+    // worker threads this waits for the whole graph instead
+    if (tbb::this_task_arena::max_concurrency() < 2)
+        wait();
+
+    while (!m_done[id].load(std::memory_order_acquire))
+        m_done[id].wait(false, std::memory_order_acquire);
+#else
+    assert(m_job && id < m_tasks.size());
+
+    helpPool(m_done[id], [](bool done) { return done; });
+#endif
+
+    if (m_failed.load())
+        wait();
+}
+
+void TaskGraph::wait()
+{
+#ifdef GLMMD_USE_TBB
+    if (!m_started)
+        return;
+
+    m_group.wait();
+#else
+    if (!m_job)
+        return;
+
+    waitForTasks();
+#endif
+
+    rethrow();
+}
+
+#ifndef GLMMD_USE_TBB
+void TaskGraph::waitForTasks()
+{
+    helpPool(m_unfinished,
+             [](uint32_t unfinished) { return unfinished == 0; });
+
+    // The last tasks are done, the pool only has to let go of the job
+    while (m_job->remaining.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+}
+#endif
+
+void TaskGraph::rethrow()
+{
+    if (m_exception)
+    {
+        auto e      = m_exception;
+        m_exception = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+} // namespace glmmd
@@ -0,0 +1,237 @@
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <glmmd/core/ThreadPool.h>
+#include <glmmd/core/Trace.h>
+
+namespace glmmd
+{
+
+static thread_local const ThreadPool *t_currentPool       = nullptr;
+static thread_local size_t            t_currentQueueIndex = 0;
+
+bool setCurrentThreadAffinity(uint32_t cpu)
+{
+#ifdef _WIN32
+    if (cpu >= 8 * sizeof(DWORD_PTR))
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+    if (cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+ThreadPool::ThreadPool(const ThreadPoolConfig &config)
+{
+    uint32_t threadCount = config.threadCount;
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    m_queues.resize(threadCount);
+    for (auto &queue : m_queues)
+        queue = std::make_unique<WorkQueue>();
+
+    m_workers.reserve(threadCount - 1);
+    for (uint32_t i = 1; i < threadCount; ++i)
+    {
+        int64_t cpu = i - 1 < config.workerAffinity.size()
+                          ? config.workerAffinity[i - 1]
+                          : -1;
+        m_workers.emplace_back(
+            [this, i, cpu]
+            {
+                if (cpu >= 0)
+                    setCurrentThreadAffinity(static_cast<uint32_t>(cpu));
+                workerLoop(i);
+            });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop.store(true);
+    }
+    m_sleepCondition.notify_all();
+    for (auto &worker : m_workers)
+        worker.join();
+}
+
+size_t ThreadPool::localQueueIndex() const
+{
+    return t_currentPool == this ? t_currentQueueIndex : 0;
+}
+
+void ThreadPool::run(Job &job, size_t first, size_t last)
+{
+    execute({&job, first, last});
+
+    while (job.remaining.load(std::memory_order_acquire) != 0)
+    {
+        if (!tryRunOne())
+            std::this_thread::yield();
+    }
+
+    if (job.exception)
+        std::rethrow_exception(job.exception);
+}
+
+void ThreadPool::execute(Task task)
+{
+    Job &job = *task.job;
+
+    // Split off the upper halves for other threads to steal, keep the
+    // lowest chunk for this thread.
+    while (task.end - task.begin > job.grain)
+    {
+        size_t mid = task.begin + (task.end - task.begin) / 2;
+        push({task.job, mid, task.end});
+        task.end = mid;
+    }
+
+    if (!job.failed.load(std::memory_order_relaxed))
+    {
+        try
+        {
+            job.invoke(job.func, task.begin, task.end);
+        }
+        catch (...)
+        {
+            if (!job.failed.exchange(true))
+                job.exception = std::current_exception();
+        }
+    }
+
+    job.remaining.fetch_sub(task.end - task.begin, std::memory_order_acq_rel);
+}
+
+void ThreadPool::push(const Task &task)
+{
+    auto &queue = *m_queues[localQueueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    m_queuedTasks.fetch_add(1);
+
+    if (m_sleepingWorkers.load() != 0)
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_sleepCondition.notify_one();
+    }
+}
+
+bool ThreadPool::tryRunOne()
+{
+    if (m_queuedTasks.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    const size_t local = localQueueIndex();
+    const size_t count = m_queues.size();
+
+    for (size_t k = 0; k < count; ++k)
+    {
+        size_t i     = (local + k) % count;
+        auto  &queue = *m_queues[i];
+
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+
+        Task task;
+        if (i == local) // own queue: newest first (LIFO)
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        else // steal: oldest, i.e. largest, first (FIFO)
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        lock.unlock();
+
+        m_queuedTasks.fetch_sub(1);
+        execute(task);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(uint32_t index)
+{
+    t_currentPool       = this;
+    t_currentQueueIndex = index;
+
+    GLMMD_TRACE_THREAD_NAME("glmmd worker");
+
+    constexpr int spinCount = 64;
+
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+        bool ran = false;
+        for (int i = 0; i < spinCount && !ran; ++i)
+        {
+            ran = tryRunOne();
+            if (!ran)
+                std::this_thread::yield();
+        }
+        if (ran)
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleepingWorkers.fetch_add(1);
+        m_sleepCondition.wait(lock, [this]
+                              { return m_stop.load() || m_queuedTasks.load(); });
+        m_sleepingWorkers.fetch_sub(1);
+    }
+}
+
+static std::mutex                  globalPoolMutex;
+static std::unique_ptr<ThreadPool> globalPool;
+static std::atomic<ThreadPool *>   globalPoolPtr{nullptr};
+
+ThreadPool &ThreadPool::global()
+{
+    if (auto pool = globalPoolPtr.load(std::memory_order_acquire))
+        return *pool;
+
+    std::lock_guard<std::mutex> lock(globalPoolMutex);
+    if (!globalPool)
+    {
+        ThreadPoolConfig config;
+#ifdef GLMMD_DONT_PARALLELIZE
+        config.threadCount = 1;
+#endif
+        globalPool = std::make_unique<ThreadPool>(config);
+        globalPoolPtr.store(globalPool.get(), std::memory_order_release);
+    }
+    return *globalPool;
+}
+
+void ThreadPool::configureGlobal(const ThreadPoolConfig &config)
+{
+    std::lock_guard<std::mutex> lock(globalPoolMutex);
+    globalPoolPtr.store(nullptr, std::memory_order_release);
+    globalPool.reset();
+    globalPool = std::make_unique<ThreadPool>(config);
+    globalPoolPtr.store(globalPool.get(), std::memory_order_release);
+}
+
+} // namespace glmmd
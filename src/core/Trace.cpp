@@ -0,0 +1,201 @@
+#ifdef GLMMD_ENABLE_TRACING
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <glmmd/core/Trace.h>
+
+namespace glmmd::trace
+{
+
+namespace
+{
+
+struct Event
+{
+    const char *name;
+    uint64_t    begin;
+    uint64_t    end;
+};
+
+constexpr size_t chunkSize = 4096;
+constexpr size_t maxChunks = 1024;
+
+// Written by its thread only. Chunks never move once published, so a reader
+// may walk the first `count` events at any time.
+struct ThreadBuffer
+{
+    uint32_t tid = 0;
+
+    std::atomic<const char *> name{nullptr};
+    std::atomic<size_t>       count{0};
+    std::atomic<Event *>      chunks[maxChunks]{};
+
+    ~ThreadBuffer()
+    {
+        for (auto &chunk : chunks)
+            delete[] chunk.load();
+    }
+};
+
+struct Registry
+{
+    std::mutex                                 mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+// Never destroyed, threads may still record during static destruction
+Registry &registry()
+{
+    static auto *r = new Registry;
+    return *r;
+}
+
+std::atomic<bool> g_enabled{false};
+
+ThreadBuffer &localBuffer()
+{
+    thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer)
+    {
+        auto                       &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        buffer      = r.buffers.emplace_back(std::make_unique<ThreadBuffer>())
+                          .get();
+        buffer->tid = static_cast<uint32_t>(r.buffers.size());
+    }
+    return *buffer;
+}
+
+void writeString(std::ostream &out, const char *str)
+{
+    out << '"';
+    for (; *str; ++str)
+    {
+        if (*str == '"' || *str == '\\')
+            out << '\\';
+        out << *str;
+    }
+    out << '"';
+}
+
+} // namespace
+
+uint64_t now()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+void setEnabled(bool enabled) { g_enabled.store(enabled); }
+
+bool enabled() { return g_enabled.load(std::memory_order_relaxed); }
+
+void record(const char *name, uint64_t begin, uint64_t end)
+{
+    auto &buffer = localBuffer();
+
+    size_t n     = buffer.count.load(std::memory_order_relaxed);
+    size_t chunk = n / chunkSize;
+    if (chunk >= maxChunks)
+        return;
+
+    auto *events = buffer.chunks[chunk].load(std::memory_order_relaxed);
+    if (!events)
+    {
+        events = new Event[chunkSize];
+        buffer.chunks[chunk].store(events, std::memory_order_release);
+    }
+
+    events[n % chunkSize] = {name, begin, end};
+    buffer.count.store(n + 1, std::memory_order_release);
+}
+
+void setThreadName(const char *name)
+{
+    localBuffer().name.store(name, std::memory_order_release);
+}
+
+void clear()
+{
+    auto                       &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto &buffer : r.buffers)
+        buffer->count.store(0, std::memory_order_release);
+}
+
+void dumpChromeTrace(const std::filesystem::path &path)
+{
+    std::ofstream fout(path);
+    if (!fout)
+        throw std::runtime_error("Failed to open file \"" + path.string() +
+                                 "\".");
+
+    auto                       &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    auto event = [](const ThreadBuffer &buffer, size_t i) -> const Event &
+    {
+        return buffer.chunks[i / chunkSize].load(
+            std::memory_order_acquire)[i % chunkSize];
+    };
+
+    // Zones are recorded when they end, so the first event of a buffer is not
+    // necessarily the earliest one.
+    uint64_t origin = UINT64_MAX;
+    for (const auto &buffer : r.buffers)
+    {
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i)
+            origin = std::min(origin, event(*buffer, i).begin);
+    }
+
+    fout << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    fout.setf(std::ios::fixed);
+    fout.precision(3);
+
+    bool first = true;
+    for (const auto &buffer : r.buffers)
+    {
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        if (count == 0)
+            continue;
+
+        if (!first)
+            fout << ",\n";
+        first = false;
+
+        fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+             << buffer->tid << ",\"args\":{\"name\":";
+        if (auto name = buffer->name.load(std::memory_order_acquire))
+            writeString(fout, name);
+        else
+            fout << "\"thread " << buffer->tid << '"';
+        fout << "}}";
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const auto &e = event(*buffer, i);
+
+            fout << ",\n{\"name\":";
+            writeString(fout, e.name);
+            fout << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                 << ",\"ts\":" << (e.begin - origin) * 1e-3
+                 << ",\"dur\":" << (e.end - e.begin) * 1e-3 << '}';
+        }
+    }
+
+    fout << "\n]}\n";
+}
+
+} // namespace glmmd::trace
+
+#endif
@@ -0,0 +1,128 @@
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <glmmd/files/PhysicsCacheFile.h>
+
+namespace glmmd
+{
+
+constexpr char     PHYSICS_CACHE_MAGIC[8]  = "GLMMDPC";
+constexpr uint32_t PHYSICS_CACHE_VERSION   = 1;
+constexpr uint32_t PHYSICS_CACHE_MAX_BONES = 1u << 16;
+
+template <typename T>
+static void writeValue(std::ofstream &fout, const T &val)
+{
+    fout.write(reinterpret_cast<const char *>(&val), sizeof(T));
+}
+
+template <typename T>
+static void readValue(std::ifstream &fin, T &val)
+{
+    fin.read(reinterpret_cast<char *>(&val), sizeof(T));
+    if (!fin)
+        throw std::runtime_error("Unexpected end of physics cache file.");
+}
+
+std::shared_ptr<PhysicsCache>
+loadPhysicsCacheFile(const std::filesystem::path &path)
+{
+    std::ifstream fin(path, std::ios::binary);
+    if (!fin)
+        throw std::runtime_error("Failed to open file \"" + path.string() +
+                                 "\".");
+
+    char magic[8];
+    fin.read(magic, sizeof(magic));
+    if (!fin || std::memcmp(magic, PHYSICS_CACHE_MAGIC, sizeof(magic)) != 0)
+        throw std::runtime_error("Invalid physics cache file.");
+
+    uint32_t version;
+    readValue(fin, version);
+    if (version != PHYSICS_CACHE_VERSION)
+        throw std::runtime_error("Unsupported physics cache version " +
+                                 std::to_string(version) + ".");
+
+    float    frameRate;
+    uint32_t frameCount;
+    uint32_t boneCount;
+    readValue(fin, frameRate);
+    readValue(fin, frameCount);
+    readValue(fin, boneCount);
+    if (!std::isfinite(frameRate) || frameRate <= 0.f ||
+        boneCount > PHYSICS_CACHE_MAX_BONES)
+        throw std::runtime_error("Invalid physics cache file.");
+
+    std::vector<uint32_t>                bones(boneCount);
+    std::vector<std::string>             boneNames(boneCount);
+    std::vector<PhysicsCache::BoneRange> ranges(boneCount);
+    for (uint32_t i = 0; i < boneCount; ++i)
+    {
+        readValue(fin, bones[i]);
+
+        uint32_t nameLength;
+        readValue(fin, nameLength);
+        if (nameLength > 1024)
+            throw std::runtime_error("Invalid physics cache file.");
+        boneNames[i].resize(nameLength);
+        fin.read(boneNames[i].data(), nameLength);
+
+        readValue(fin, ranges[i].origin);
+        readValue(fin, ranges[i].scale);
+    }
+
+    // Samples take the rest of the file
+    auto samplesBegin = fin.tellg();
+    fin.seekg(0, std::ios::end);
+    auto fileEnd = fin.tellg();
+    fin.seekg(samplesBegin);
+    if (!fin || static_cast<uint64_t>(fileEnd - samplesBegin) <
+                    static_cast<uint64_t>(frameCount) * boneCount *
+                        sizeof(PhysicsCache::Sample))
+        throw std::runtime_error("Unexpected end of physics cache file.");
+
+    std::vector<PhysicsCache::Sample> samples(static_cast<size_t>(frameCount) *
+                                              boneCount);
+    fin.read(reinterpret_cast<char *>(samples.data()),
+             static_cast<std::streamsize>(samples.size() *
+                                          sizeof(PhysicsCache::Sample)));
+    if (!fin)
+        throw std::runtime_error("Unexpected end of physics cache file.");
+
+    return std::make_shared<PhysicsCache>(
+        frameRate, std::move(bones), std::move(boneNames), std::move(ranges),
+        std::move(samples));
+}
+
+void dumpPhysicsCacheFile(const std::filesystem::path &path,
+                          const PhysicsCache          &cache)
+{
+    std::ofstream fout(path, std::ios::binary);
+    if (!fout)
+        throw std::runtime_error("Failed to open file \"" + path.string() +
+                                 "\".");
+
+    fout.write(PHYSICS_CACHE_MAGIC, sizeof(PHYSICS_CACHE_MAGIC));
+    writeValue(fout, PHYSICS_CACHE_VERSION);
+    writeValue(fout, cache.frameRate());
+    writeValue(fout, cache.frameCount());
+    writeValue(fout, static_cast<uint32_t>(cache.bones().size()));
+
+    for (size_t i = 0; i < cache.bones().size(); ++i)
+    {
+        const auto &name = cache.boneNames()[i];
+        writeValue(fout, cache.bones()[i]);
+        writeValue(fout, static_cast<uint32_t>(name.size()));
+        fout.write(name.data(), static_cast<std::streamsize>(name.size()));
+        writeValue(fout, cache.ranges()[i].origin);
+        writeValue(fout, cache.ranges()[i].scale);
+    }
+
+    fout.write(reinterpret_cast<const char *>(cache.samples().data()),
+               static_cast<std::streamsize>(cache.samples().size() *
+                                            sizeof(PhysicsCache::Sample)));
+}
+
+} // namespace glmmd
@@ -231,9 +231,7 @@ void PmxFileDumper::dumpMorphs(const ModelData &data)
         case MorphType::UV2:
         case MorphType::UV3:
         case MorphType::UV4:
-            dumpUVMorph(data, m,
-                        static_cast<uint8_t>(m.type) -
-                            static_cast<uint8_t>(MorphType::UV));
+            dumpUVMorph(data, m);
             break;
         case MorphType::Material:
             dumpMaterialMorph(data, m);
@@ -244,9 +242,8 @@ void PmxFileDumper::dumpMorphs(const ModelData &data)
 
 void PmxFileDumper::dumpGroupMorph(const ModelData &data, const Morph &morph)
 {
-    for (int32_t i = 0; i < morph.count; ++i)
+    for (const auto &m : data.groupMorphs(morph))
     {
-        const auto &m = morph.group[i];
         writeInt(m.index, data.info.morphIndexSize);
         writeFloat(m.ratio);
     }
@@ -254,9 +251,8 @@ void PmxFileDumper::dumpGroupMorph(const ModelData &data, const Morph &morph)
 
 void PmxFileDumper::dumpVertexMorph(const ModelData &data, const Morph &morph)
 {
-    for (int32_t i = 0; i < morph.count; ++i)
+    for (const auto &m : data.vertexMorphs(morph))
     {
-        const auto &m = morph.vertex[i];
         writeInt(m.index, data.info.vertexIndexSize);
         writeFloat<3>(m.offset.x);
     }
@@ -264,31 +260,27 @@ void PmxFileDumper::dumpVertexMorph(const ModelData &data, const Morph &morph)
 
 void PmxFileDumper::dumpBoneMorph(const ModelData &data, const Morph &morph)
 {
-    for (int32_t i = 0; i < morph.count; ++i)
+    for (const auto &m : data.boneMorphs(morph))
     {
-        const auto &m = morph.bone[i];
         writeInt(m.index, data.info.boneIndexSize);
         writeFloat<3>(m.translation.x);
         writeFloat<4>(m.rotation[0]);
     }
 }
 
-void PmxFileDumper::dumpUVMorph(const ModelData &data, const Morph &morph,
-                                uint8_t num)
+void PmxFileDumper::dumpUVMorph(const ModelData &data, const Morph &morph)
 {
-    for (int32_t i = 0; i < morph.count; ++i)
+    for (const auto &m : data.uvMorphs(morph))
     {
-        const auto &m = morph.uv[i];
         writeInt(m.index, data.info.vertexIndexSize);
-        writeFloat<4>(m.offset[num].x);
+        writeFloat<4>(m.offset.x);
     }
 }
 
 void PmxFileDumper::dumpMaterialMorph(const ModelData &data, const Morph &morph)
 {
-    for (int32_t i = 0; i < morph.count; ++i)
+    for (const auto &m : data.materialMorphs(morph))
     {
-        const auto &m = morph.material[i];
         writeInt(m.index, data.info.materialIndexSize);
         writeUInt(m.operation);
         writeFloat<4>(m.diffuse.x);
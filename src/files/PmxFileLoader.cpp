@@ -2,6 +2,7 @@
 #include <fstream>
 #include <stdexcept>
 
+#include <glmmd/core/Trace.h>
 #include <glmmd/files/CodeConverter.h>
 #include <glmmd/files/PmxFileLoader.h>
 
@@ -11,6 +12,8 @@ namespace glmmd
 std::shared_ptr<ModelData> PmxFileLoader::load(
     const std::filesystem::path &path)
 {
+    GLMMD_TRACE_SCOPE("loadPmxFile");
+
     m_fin.open(path, std::ios::binary);
     if (!m_fin)
         throw std::runtime_error("Failed to open file \"" + path.string() +
@@ -31,11 +34,28 @@ std::shared_ptr<ModelData> PmxFileLoader::load(
     loadRigidBodies(*data);
     loadJoints(*data);
 
+    data->updateSkinningData();
+    data->updateNameIndices();
+
     return data;
 }
 
+void PmxFileLoader::readText(const ModelData &data, std::pmr::string &str)
+{
+    readTextBuffer(m_textBuffer);
+    if (data.info.encodingMethod == EncodingMethod::UTF16_LE)
+    {
+        codeCvt<UTF16_LE, UTF8>(m_textBuffer, m_utf8Buffer);
+        str = m_utf8Buffer;
+    }
+    else
+        str = m_textBuffer;
+}
+
 void PmxFileLoader::loadInfo(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadInfo");
+
     ModelInfo &info = data.info;
 
     char header[4];
@@ -78,6 +98,8 @@ void PmxFileLoader::loadInfo(ModelData &data)
 
 void PmxFileLoader::loadVertices(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadVertices");
+
     int32_t count;
     readInt(count);
     data.vertices.resize(count);
@@ -139,6 +161,8 @@ void PmxFileLoader::loadVertices(ModelData &data)
 
 void PmxFileLoader::loadIndices(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadIndices");
+
     int32_t count;
     readInt(count);
     data.indices.resize(count);
@@ -149,6 +173,8 @@ void PmxFileLoader::loadIndices(ModelData &data)
 
 void PmxFileLoader::loadTextures(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadTextures");
+
     int32_t count;
     readInt(count);
     data.textures.resize(count);
@@ -175,19 +201,17 @@ void PmxFileLoader::loadTextures(ModelData &data)
 
 void PmxFileLoader::loadMaterials(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadMaterials");
+
     int32_t count;
     readInt(count);
-    data.materials.resize(count);
+    data.materials.reserve(count);
 
-    for (auto &mat : data.materials)
+    for (int32_t i = 0; i < count; ++i)
     {
-        readTextBuffer(mat.name);
-        readTextBuffer(mat.nameEN);
-        if (data.info.encodingMethod == EncodingMethod::UTF16_LE)
-        {
-            mat.name   = codeCvt<UTF16_LE, UTF8>(mat.name);
-            mat.nameEN = codeCvt<UTF16_LE, UTF8>(mat.nameEN);
-        }
+        auto &mat = data.addMaterial();
+        readText(data, mat.name);
+        readText(data, mat.nameEN);
 
         readFloat<4>(mat.diffuse.x);
         readFloat<3>(mat.specular.x);
@@ -205,29 +229,24 @@ void PmxFileLoader::loadMaterials(ModelData &data)
             readInt(mat.toonTextureIndex, data.info.textureIndexSize);
         else
             readInt(mat.toonTextureIndex, 1);
-        readTextBuffer(mat.memo);
-        if (data.info.encodingMethod == EncodingMethod::UTF16_LE)
-            mat.memo = codeCvt<UTF16_LE, UTF8>(mat.memo);
+        readText(data, mat.memo);
         readInt(mat.indicesCount);
     }
 }
 
 void PmxFileLoader::loadBones(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadBones");
+
     int32_t count;
     readInt(count);
-    data.bones.resize(count);
+    data.bones.reserve(count);
 
-    int32_t i = 0;
-    for (auto &bone : data.bones)
+    for (int32_t i = 0; i < count; ++i)
     {
-        readTextBuffer(bone.name);
-        readTextBuffer(bone.nameEN);
-        if (data.info.encodingMethod == EncodingMethod::UTF16_LE)
-        {
-            bone.name   = codeCvt<UTF16_LE, UTF8>(bone.name);
-            bone.nameEN = codeCvt<UTF16_LE, UTF8>(bone.nameEN);
-        }
+        auto &bone = data.addBone();
+        readText(data, bone.name);
+        readText(data, bone.nameEN);
         readFloat<3>(bone.position.x);
         readInt(bone.parentIndex, data.info.boneIndexSize);
         readInt(bone.deformLayer);
@@ -260,8 +279,7 @@ void PmxFileLoader::loadBones(ModelData &data)
         if (bone.bitFlag & 0x0020)
         {
             bone.ikDataIndex = static_cast<int32_t>(data.ikData.size());
-            data.ikData.emplace_back();
-            auto &ik = data.ikData.back();
+            auto &ik         = data.addIKData();
 
             ik.targetBoneIndex = i;
             readInt(ik.endEffector, data.info.boneIndexSize);
@@ -282,29 +300,26 @@ void PmxFileLoader::loadBones(ModelData &data)
                 }
             }
         }
-        ++i;
     }
 }
 
 void PmxFileLoader::loadMorphs(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadMorphs");
+
     int32_t count;
     readInt(count);
-    data.morphs.resize(count);
+    data.morphs.reserve(count);
 
-    for (auto &morph : data.morphs)
+    for (int32_t i = 0; i < count; ++i)
     {
-        readTextBuffer(morph.name);
-        readTextBuffer(morph.nameEN);
-        if (data.info.encodingMethod == EncodingMethod::UTF16_LE)
-        {
-            morph.name   = codeCvt<UTF16_LE, UTF8>(morph.name);
-            morph.nameEN = codeCvt<UTF16_LE, UTF8>(morph.nameEN);
-        }
+        auto &morph = data.addMorph();
+        readText(data, morph.name);
+        readText(data, morph.nameEN);
         readUInt(morph.panel);
         readUInt(morph.type);
         readInt(morph.count);
-        morph.init();
+        data.allocateMorphElements(morph);
         switch (morph.type)
         {
         case MorphType::Group:
@@ -321,9 +336,7 @@ void PmxFileLoader::loadMorphs(ModelData &data)
         case MorphType::UV2:
         case MorphType::UV3:
         case MorphType::UV4:
-            loadUVMorph(data, morph,
-                        static_cast<uint8_t>(morph.type) -
-                            static_cast<uint8_t>(MorphType::UV));
+            loadUVMorph(data, morph);
             break;
         case MorphType::Material:
             loadMaterialMorph(data, morph);
@@ -332,31 +345,31 @@ void PmxFileLoader::loadMorphs(ModelData &data)
     }
 }
 
-void PmxFileLoader::loadGroupMorph(const ModelData &modelData, Morph &morph)
+void PmxFileLoader::loadGroupMorph(ModelData &modelData, Morph &morph)
 {
     for (int32_t i = 0; i < morph.count; ++i)
     {
-        auto &group = morph.group[i];
+        auto &group = modelData.morphPools.group[morph.offset + i];
         readUInt(group.index, modelData.info.morphIndexSize);
         readFloat(group.ratio);
     }
 }
 
-void PmxFileLoader::loadVertexMorph(const ModelData &data, Morph &morph)
+void PmxFileLoader::loadVertexMorph(ModelData &data, Morph &morph)
 {
     for (int32_t i = 0; i < morph.count; ++i)
     {
-        auto &vertex = morph.vertex[i];
+        auto &vertex = data.morphPools.vertex[morph.offset + i];
         readUInt(vertex.index, data.info.vertexIndexSize);
         readFloat<3>(vertex.offset.x);
     }
 }
 
-void PmxFileLoader::loadBoneMorph(const ModelData &data, Morph &morph)
+void PmxFileLoader::loadBoneMorph(ModelData &data, Morph &morph)
 {
     for (int32_t i = 0; i < morph.count; ++i)
     {
-        auto &bone = morph.bone[i];
+        auto &bone = data.morphPools.bone[morph.offset + i];
         readUInt(bone.index, data.info.boneIndexSize);
         readFloat<3>(bone.translation.x);
         glm::vec4 q;
@@ -365,25 +378,21 @@ void PmxFileLoader::loadBoneMorph(const ModelData &data, Morph &morph)
     }
 }
 
-void PmxFileLoader::loadUVMorph(const ModelData &data, Morph &morph,
-                                uint8_t num)
+void PmxFileLoader::loadUVMorph(ModelData &data, Morph &morph)
 {
     for (int32_t i = 0; i < morph.count; ++i)
     {
-        auto &uv = morph.uv[i];
-        for (uint8_t j = 0; j < 5; ++j)
-            if (j != num)
-                uv.offset[num] = glm::vec4(0.f);
+        auto &uv = data.morphPools.uv[morph.offset + i];
         readUInt(uv.index, data.info.vertexIndexSize);
-        readFloat<4>(uv.offset[num].x);
+        readFloat<4>(uv.offset.x);
     }
 }
 
-void PmxFileLoader::loadMaterialMorph(const ModelData &data, Morph &morph)
+void PmxFileLoader::loadMaterialMorph(ModelData &data, Morph &morph)
 {
     for (int32_t i = 0; i < morph.count; ++i)
     {
-        auto &mat = morph.material[i];
+        auto &mat = data.morphPools.material[morph.offset + i];
         readInt(mat.index, data.info.materialIndexSize);
         readUInt(mat.operation);
         readFloat<4>(mat.diffuse.x);
@@ -400,19 +409,17 @@ void PmxFileLoader::loadMaterialMorph(const ModelData &data, Morph &morph)
 
 void PmxFileLoader::loadDisplayFrames(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadDisplayFrames");
+
     int32_t count;
     readInt(count);
-    data.displayFrames.resize(count);
+    data.displayFrames.reserve(count);
 
-    for (auto &frame : data.displayFrames)
+    for (int32_t i = 0; i < count; ++i)
     {
-        readTextBuffer(frame.name);
-        readTextBuffer(frame.nameEN);
-        if (data.info.encodingMethod == EncodingMethod::UTF16_LE)
-        {
-            frame.name   = codeCvt<UTF16_LE, UTF8>(frame.name);
-            frame.nameEN = codeCvt<UTF16_LE, UTF8>(frame.nameEN);
-        }
+        auto &frame = data.addDisplayFrame();
+        readText(data, frame.name);
+        readText(data, frame.nameEN);
 
         readUInt(frame.specialFlag);
 
@@ -431,19 +438,17 @@ void PmxFileLoader::loadDisplayFrames(ModelData &data)
 
 void PmxFileLoader::loadRigidBodies(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadRigidBodies");
+
     int32_t count;
     readInt(count);
-    data.rigidBodies.resize(count);
+    data.rigidBodies.reserve(count);
 
-    for (auto &rigidBody : data.rigidBodies)
+    for (int32_t i = 0; i < count; ++i)
     {
-        readTextBuffer(rigidBody.name);
-        readTextBuffer(rigidBody.nameEN);
-        if (data.info.encodingMethod == EncodingMethod::UTF16_LE)
-        {
-            rigidBody.name   = codeCvt<UTF16_LE, UTF8>(rigidBody.name);
-            rigidBody.nameEN = codeCvt<UTF16_LE, UTF8>(rigidBody.nameEN);
-        }
+        auto &rigidBody = data.addRigidBody();
+        readText(data, rigidBody.name);
+        readText(data, rigidBody.nameEN);
 
         readInt(rigidBody.boneIndex, data.info.boneIndexSize);
 
@@ -464,19 +469,17 @@ void PmxFileLoader::loadRigidBodies(ModelData &data)
 
 void PmxFileLoader::loadJoints(ModelData &data)
 {
+    GLMMD_TRACE_SCOPE("PmxFileLoader::loadJoints");
+
     int32_t count;
     readInt(count);
-    data.joints.resize(count);
+    data.joints.reserve(count);
 
-    for (auto &joint : data.joints)
+    for (int32_t i = 0; i < count; ++i)
     {
-        readTextBuffer(joint.name);
-        readTextBuffer(joint.nameEN);
-        if (data.info.encodingMethod == EncodingMethod::UTF16_LE)
-        {
-            joint.name   = codeCvt<UTF16_LE, UTF8>(joint.name);
-            joint.nameEN = codeCvt<UTF16_LE, UTF8>(joint.nameEN);
-        }
+        auto &joint = data.addJoint();
+        readText(data, joint.name);
+        readText(data, joint.nameEN);
 
         readUInt(joint.type);
         readInt(joint.rigidBodyIndexA, data.info.rigidBodyIndexSize);
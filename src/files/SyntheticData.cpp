@@ -0,0 +1,670 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include <glm/gtc/constants.hpp>
+
+#include <glmmd/files/SyntheticData.h>
+
+namespace glmmd
+{
+
+namespace
+{
+
+// splitmix64, so that the output does not depend on the standard library
+class Random
+{
+public:
+    explicit Random(uint64_t seed)
+        : m_state(seed)
+    {
+    }
+
+    uint64_t next()
+    {
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+        z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z          = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // [0, 1)
+    float uniform() { return (next() >> 40) * (1.f / 16777216.f); }
+
+    float uniform(float a, float b) { return a + (b - a) * uniform(); }
+
+    uint32_t index(uint32_t n) { return static_cast<uint32_t>(next() % n); }
+
+    glm::vec3 vec3(float r)
+    {
+        return {uniform(-r, r), uniform(-r, r), uniform(-r, r)};
+    }
+
+private:
+    uint64_t m_state;
+};
+
+struct Skeleton
+{
+    std::vector<std::vector<int32_t>> chains;
+    std::vector<int32_t>              chainBones;
+};
+
+} // namespace
+
+SyntheticModelConfig syntheticModelPreset(std::string_view name)
+{
+    SyntheticModelConfig config;
+
+    if (name == "tiny")
+    {
+        config.vertexCount        = 1000;
+        config.materialCount      = 2;
+        config.boneCount          = 32;
+        config.chainLength        = 4;
+        config.ikChainCount       = 1;
+        config.vertexMorphCount   = 4;
+        config.vertexMorphSize    = 100;
+        config.uvMorphCount       = 1;
+        config.boneMorphCount     = 1;
+        config.materialMorphCount = 1;
+        config.groupMorphCount    = 1;
+        config.rigidBodyCount     = 8;
+        config.jointCount         = 6;
+    }
+    else if (name == "small")
+    {
+        config.vertexCount      = 10000;
+        config.materialCount    = 4;
+        config.boneCount        = 128;
+        config.vertexMorphCount = 16;
+        config.vertexMorphSize  = 300;
+        config.rigidBodyCount   = 48;
+        config.jointCount       = 40;
+    }
+    else if (name == "medium")
+    {
+        config.vertexCount      = 50000;
+        config.materialCount    = 16;
+        config.boneCount        = 400;
+        config.vertexMorphCount = 64;
+        config.vertexMorphSize  = 1000;
+        config.rigidBodyCount   = 128;
+        config.jointCount       = 112;
+    }
+    else if (name == "large")
+    {
+        config.vertexCount      = 150000;
+        config.materialCount    = 32;
+        config.boneCount        = 800;
+        config.ikChainCount     = 8;
+        config.vertexMorphCount = 128;
+        config.vertexMorphSize  = 3000;
+        config.uvMorphCount     = 8;
+        config.boneMorphCount   = 8;
+        config.rigidBodyCount   = 256;
+        config.jointCount       = 224;
+    }
+    else if (name == "extreme")
+    {
+        config.vertexCount        = 500000;
+        config.materialCount      = 64;
+        config.additionalUVNum    = 1;
+        config.boneCount          = 2000;
+        config.ikChainCount       = 16;
+        config.vertexMorphCount   = 256;
+        config.vertexMorphSize    = 10000;
+        config.uvMorphCount       = 16;
+        config.boneMorphCount     = 16;
+        config.materialMorphCount = 16;
+        config.groupMorphCount    = 16;
+        config.rigidBodyCount     = 1024;
+        config.jointCount         = 896;
+    }
+    else
+        throw std::runtime_error("Unknown synthetic model preset \"" +
+                                 std::string(name) + "\".");
+
+    return config;
+}
+
+static Bone &addBone(ModelData &data, const std::string &name,
+                     glm::vec3 position, int32_t parentIndex, uint16_t bitFlag)
+{
+    auto &bone              = data.addBone();
+    bone.name               = name;
+    bone.nameEN             = name;
+    bone.position           = position;
+    bone.parentIndex        = parentIndex;
+    bone.deformLayer        = 0;
+    bone.bitFlag            = bitFlag;
+    bone.endPosition        = glm::vec3(0.f);
+    bone.inheritParentIndex = -1;
+    bone.inheritWeight      = 0.f;
+    bone.axisDirection      = glm::vec3(0.f);
+    bone.localXVector       = glm::vec3(1.f, 0.f, 0.f);
+    bone.localZVector       = glm::vec3(0.f, 0.f, 1.f);
+    bone.externalParentKey  = 0;
+    bone.ikDataIndex        = -1;
+    return bone;
+}
+
+static Skeleton generateBones(ModelData                  &data,
+                              const SyntheticModelConfig &config)
+{
+    // rotate | translate | display | operable
+    constexpr uint16_t baseFlag = 0x0002 | 0x0008 | 0x0010;
+
+    const uint32_t boneCount   = std::max(config.boneCount, 2u);
+    const uint32_t chainLength = std::max(config.chainLength, 1u);
+
+    uint32_t ikCount        = std::min(config.ikChainCount, boneCount - 2);
+    uint32_t chainBoneCount = boneCount - 1 - ikCount;
+    uint32_t chainCount     = (chainBoneCount + chainLength - 1) / chainLength;
+    ikCount                 = std::min(ikCount, chainCount);
+    chainBoneCount          = boneCount - 1 - ikCount;
+    chainCount              = (chainBoneCount + chainLength - 1) / chainLength;
+
+    Skeleton skeleton;
+    skeleton.chains.resize(chainCount);
+
+    data.bones.reserve(boneCount);
+    addBone(data, "root", glm::vec3(0.f), -1, baseFlag | 0x0004);
+
+    for (uint32_t i = 0; i < chainBoneCount; ++i)
+    {
+        uint32_t c = i / chainLength;
+        uint32_t d = i % chainLength;
+
+        float angle  = glm::two_pi<float>() * c / chainCount;
+        float radius = 2.f + 0.5f * (c % 4);
+
+        glm::vec3 position(radius * std::cos(angle), 15.f - d,
+                           radius * std::sin(angle));
+
+        auto index  = static_cast<int32_t>(data.bones.size());
+        auto parent = d == 0 ? 0 : index - 1;
+
+        addBone(data, "bone_" + std::to_string(i), position, parent,
+                baseFlag | 0x0001)
+            .endIndex = -1;
+        if (d != 0)
+            data.bones[parent].endIndex = index;
+
+        skeleton.chains[c].push_back(index);
+        skeleton.chainBones.push_back(index);
+    }
+
+    for (uint32_t k = 0; k < ikCount; ++k)
+    {
+        const auto &chain = skeleton.chains[k];
+        auto        tip   = chain.back();
+
+        auto index = static_cast<int32_t>(data.bones.size());
+        addBone(data, "ik_" + std::to_string(k), data.bones[tip].position, 0,
+                baseFlag | 0x0004 | 0x0020)
+            .ikDataIndex = static_cast<int32_t>(data.ikData.size());
+
+        auto &ik           = data.addIKData();
+        ik.targetBoneIndex = index;
+        ik.endEffector     = tip;
+        ik.loopCount       = 20;
+        ik.limitAngle      = 0.5f;
+
+        auto linkCount = std::min<size_t>(config.ikChainLength,
+                                          chain.size() - 1);
+        for (size_t l = 0; l < linkCount; ++l)
+        {
+            auto &link          = ik.links.emplace_back();
+            link.boneIndex      = chain[chain.size() - 2 - l];
+            link.angleLimitFlag = (k % 2 == 1 && l == 0) ? 1 : 0;
+            link.lowerLimit     = glm::vec3(-glm::pi<float>(), 0.f, 0.f);
+            link.upperLimit     = glm::vec3(-0.01f, 0.f, 0.f);
+        }
+    }
+
+    return skeleton;
+}
+
+static VertexSkinningType sampleSkinningType(const SyntheticModelConfig &config,
+                                             Random                     &rng)
+{
+    const float weights[]{config.bdef1Weight, config.bdef2Weight,
+                          config.bdef4Weight, config.sdefWeight,
+                          config.qdefWeight};
+
+    float total = 0.f;
+    for (auto w : weights)
+        total += std::max(w, 0.f);
+    if (total <= 0.f)
+        return VertexSkinningType::BDEF1;
+
+    float x = rng.uniform() * total;
+    for (uint8_t i = 0; i < 5; ++i)
+    {
+        x -= std::max(weights[i], 0.f);
+        if (x < 0.f)
+            return static_cast<VertexSkinningType>(i);
+    }
+    return VertexSkinningType::BDEF1;
+}
+
+static void generateVertices(ModelData &data, const SyntheticModelConfig &config,
+                             const Skeleton &skeleton, Random &rng)
+{
+    const uint32_t vertexCount = std::max(config.vertexCount, 3u);
+    const size_t   boneCount   = skeleton.chainBones.size();
+
+    auto parentOf = [&](int32_t bone)
+    { return std::max(data.bones[bone].parentIndex, 0); };
+
+    data.vertices.resize(vertexCount);
+    for (uint32_t i = 0; i < vertexCount; ++i)
+    {
+        auto &v = data.vertices[i];
+
+        // Consecutive vertices share bones, like in real models
+        int32_t b0 = skeleton.chainBones[static_cast<uint64_t>(i) * boneCount /
+                                         vertexCount];
+        int32_t b1 = parentOf(b0);
+
+        glm::vec3 offset(rng.uniform(-0.3f, 0.3f), rng.uniform(-1.f, 0.f),
+                         rng.uniform(-0.3f, 0.3f));
+
+        v.position = data.bones[b0].position + offset;
+        v.normal   = glm::length(glm::vec2(offset.x, offset.z)) > 1e-4f
+                         ? glm::normalize(glm::vec3(offset.x, 0.f, offset.z))
+                         : glm::vec3(0.f, 0.f, 1.f);
+        v.uv       = glm::vec2(rng.uniform(), rng.uniform());
+
+        v.skinningType = sampleSkinningType(config, rng);
+        v.boneIndices  = {b0, 0, 0, 0};
+        v.boneWeights  = glm::vec4(1.f, 0.f, 0.f, 0.f);
+        v.sdefC        = glm::vec3(0.f);
+        v.sdefR0       = glm::vec3(0.f);
+        v.sdefR1       = glm::vec3(0.f);
+        v.edgeScale    = 1.f;
+
+        switch (v.skinningType)
+        {
+        case VertexSkinningType::BDEF1:
+            break;
+        case VertexSkinningType::BDEF2:
+        case VertexSkinningType::SDEF:
+        {
+            float w        = rng.uniform();
+            v.boneIndices  = {b0, b1, 0, 0};
+            v.boneWeights  = glm::vec4(w, 1.f - w, 0.f, 0.f);
+            if (v.skinningType == VertexSkinningType::SDEF)
+            {
+                v.sdefR0 = data.bones[b0].position;
+                v.sdefR1 = data.bones[b1].position;
+                v.sdefC  = 0.5f * (v.sdefR0 + v.sdefR1);
+            }
+            break;
+        }
+        case VertexSkinningType::BDEF4:
+        case VertexSkinningType::QDEF:
+        {
+            glm::vec4 w(rng.uniform(0.1f, 1.f), rng.uniform(0.1f, 1.f),
+                        rng.uniform(0.1f, 1.f), rng.uniform(0.1f, 1.f));
+            v.boneIndices = {
+                b0, b1, parentOf(b1),
+                skeleton.chainBones[rng.index(static_cast<uint32_t>(
+                    boneCount))]};
+            v.boneWeights = w / (w.x + w.y + w.z + w.w);
+            break;
+        }
+        }
+    }
+
+    data.info.additionalUVNum = std::min<uint8_t>(config.additionalUVNum, 4);
+    if (data.info.additionalUVNum > 0)
+    {
+        data.additionalUVs.resize(vertexCount);
+        for (auto &uvs : data.additionalUVs)
+            for (auto &uv : uvs)
+                uv = glm::vec4(rng.uniform(), rng.uniform(), rng.uniform(),
+                               rng.uniform());
+    }
+
+    const uint32_t triangleCount = vertexCount - 2;
+    data.indices.reserve(3 * triangleCount);
+    for (uint32_t i = 0; i < triangleCount; ++i)
+    {
+        data.indices.push_back(i);
+        data.indices.push_back(i % 2 == 0 ? i + 1 : i + 2);
+        data.indices.push_back(i % 2 == 0 ? i + 2 : i + 1);
+    }
+
+    const uint32_t materialCount =
+        std::clamp(config.materialCount, 1u, triangleCount);
+    data.materials.reserve(materialCount);
+    for (uint32_t i = 0; i < materialCount; ++i)
+    {
+        auto &m = data.addMaterial();
+
+        m.name   = "material_" + std::to_string(i);
+        m.nameEN = m.name;
+
+        m.diffuse = glm::vec4(rng.uniform(0.2f, 1.f), rng.uniform(0.2f, 1.f),
+                              rng.uniform(0.2f, 1.f), 1.f);
+        m.specular      = glm::vec3(0.2f);
+        m.specularPower = 10.f;
+        m.ambient       = 0.5f * glm::vec3(m.diffuse);
+
+        m.bitFlag = 0x01 | 0x02 | 0x04 | 0x08 | 0x10;
+
+        m.edgeColor = glm::vec4(0.f, 0.f, 0.f, 1.f);
+        m.edgeSize  = 1.f;
+
+        m.textureIndex       = -1;
+        m.sphereTextureIndex = -1;
+        m.sphereMode         = 0;
+        m.sharedToonFlag     = 1;
+        m.toonTextureIndex   = static_cast<int32_t>(i % 10);
+
+        uint32_t triangles = triangleCount / materialCount;
+        if (i + 1 == materialCount)
+            triangles += triangleCount % materialCount;
+        m.indicesCount = static_cast<int32_t>(3 * triangles);
+    }
+}
+
+static void generateMorphs(ModelData &data, const SyntheticModelConfig &config,
+                           const Skeleton &skeleton, Random &rng)
+{
+    const uint32_t vertexCount = static_cast<uint32_t>(data.vertices.size());
+    const uint32_t morphSize   = std::min(config.vertexMorphSize, vertexCount);
+    const uint32_t nonGroupCount = config.vertexMorphCount +
+                                   config.uvMorphCount + config.boneMorphCount +
+                                   config.materialMorphCount;
+
+    data.morphs.reserve(nonGroupCount + config.groupMorphCount);
+
+    uint32_t index = 0;
+    auto     next  = [&](MorphType type, int32_t count) -> Morph &
+    {
+        auto &morph  = data.addMorph();
+        morph.name   = "morph_" + std::to_string(index);
+        morph.nameEN = morph.name;
+        morph.panel  = static_cast<uint8_t>(index % 4 + 1);
+        morph.type   = type;
+        morph.count  = count;
+        data.allocateMorphElements(morph);
+        ++index;
+        return morph;
+    };
+
+    for (uint32_t k = 0; k < config.vertexMorphCount; ++k)
+    {
+        auto &morph  = next(MorphType::Vertex, morphSize);
+        auto *vertex = &data.morphPools.vertex[morph.offset];
+        auto  first  = rng.index(vertexCount - morphSize + 1);
+        for (uint32_t j = 0; j < morphSize; ++j)
+        {
+            vertex[j].index  = static_cast<int32_t>(first + j);
+            vertex[j].offset = rng.vec3(0.1f);
+        }
+    }
+
+    for (uint32_t k = 0; k < config.uvMorphCount; ++k)
+    {
+        auto &morph = next(MorphType::UV, morphSize);
+        auto  first = rng.index(vertexCount - morphSize + 1);
+        for (uint32_t j = 0; j < morphSize; ++j)
+        {
+            auto &m  = data.morphPools.uv[morph.offset + j];
+            m.index  = static_cast<int32_t>(first + j);
+            m.offset = glm::vec4(rng.uniform(-0.1f, 0.1f),
+                                 rng.uniform(-0.1f, 0.1f), 0.f, 0.f);
+        }
+    }
+
+    const auto chainBoneCount =
+        static_cast<uint32_t>(skeleton.chainBones.size());
+    for (uint32_t k = 0; k < config.boneMorphCount; ++k)
+    {
+        auto  count = std::min(4u, chainBoneCount);
+        auto &morph = next(MorphType::Bone, count);
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            auto &m       = data.morphPools.bone[morph.offset + j];
+            m.index       = skeleton.chainBones[rng.index(chainBoneCount)];
+            m.translation = rng.vec3(0.1f);
+            m.rotation    = glm::quat(rng.vec3(0.3f));
+        }
+    }
+
+    const auto materialCount = static_cast<uint32_t>(data.materials.size());
+    for (uint32_t k = 0; k < config.materialMorphCount; ++k)
+    {
+        auto &morph = next(MorphType::Material, 1);
+        auto &m     = data.morphPools.material[morph.offset];
+
+        m.index     = static_cast<int32_t>(k % materialCount);
+        m.operation = static_cast<uint8_t>(k % 2);
+
+        float base        = m.operation == 0 ? 1.f : 0.f;
+        m.diffuse         = glm::vec4(base);
+        m.diffuse.x       = rng.uniform(0.f, 1.f);
+        m.specular        = glm::vec3(base);
+        m.specularPower   = base;
+        m.ambient         = glm::vec3(base);
+        m.edgeColor       = glm::vec4(base);
+        m.edgeSize        = base;
+        m.texture         = glm::vec4(base);
+        m.sphereTexture   = glm::vec4(base);
+        m.toonTexture     = glm::vec4(base);
+    }
+
+    for (uint32_t k = 0; k < config.groupMorphCount; ++k)
+    {
+        auto  count = std::min(4u, nonGroupCount);
+        auto &morph = next(MorphType::Group, count);
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            auto &m = data.morphPools.group[morph.offset + j];
+            m.index = static_cast<int32_t>(rng.index(nonGroupCount));
+            m.ratio = rng.uniform(0.5f, 1.f);
+        }
+    }
+}
+
+static void generateDisplayFrames(ModelData &data)
+{
+    auto &root       = data.addDisplayFrame();
+    root.name        = "Root";
+    root.nameEN      = "Root";
+    root.specialFlag = 1;
+    root.elements.push_back({0, 0});
+
+    auto &exp       = data.addDisplayFrame();
+    exp.name        = "Exp";
+    exp.nameEN      = "Exp";
+    exp.specialFlag = 1;
+    for (size_t i = 0; i < data.morphs.size(); ++i)
+        exp.elements.push_back({1, static_cast<int32_t>(i)});
+
+    auto &bones       = data.addDisplayFrame();
+    bones.name        = "Bones";
+    bones.nameEN      = "Bones";
+    bones.specialFlag = 0;
+    for (size_t i = 1; i < data.bones.size(); ++i)
+        bones.elements.push_back({0, static_cast<int32_t>(i)});
+}
+
+static void generatePhysics(ModelData &data, const SyntheticModelConfig &config,
+                            const Skeleton &skeleton)
+{
+    const auto &chains = skeleton.chains;
+
+    // Whole chains get bodies one after another, like hair strands
+    std::vector<std::vector<int32_t>> chainBodies(chains.size());
+    for (size_t c = 0; c < chains.size(); ++c)
+    {
+        for (size_t d = 0; d < chains[c].size(); ++d)
+        {
+            if (data.rigidBodies.size() >= config.rigidBodyCount)
+                break;
+
+            auto bone = chains[c][d];
+            auto &r   = data.addRigidBody();
+
+            r.name   = "body_" + std::to_string(data.rigidBodies.size() - 1);
+            r.nameEN = r.name;
+
+            r.boneIndex          = bone;
+            r.group              = static_cast<uint8_t>(c % 15);
+            r.collisionGroupMask = static_cast<uint16_t>(~(1u << r.group));
+
+            r.shape    = RigidBodyShape::Capsule;
+            r.size     = glm::vec3(0.2f, 0.6f, 0.f);
+            r.position = data.bones[bone].position - glm::vec3(0.f, 0.5f, 0.f);
+            r.rotation = glm::vec3(0.f);
+
+            r.mass           = 1.f;
+            r.linearDamping  = 0.5f;
+            r.angularDamping = 0.5f;
+            r.restitution    = 0.f;
+            r.friction       = 0.5f;
+
+            if (d == 0)
+                r.physicsCalcType = PhysicsCalcType::Static;
+            else
+                r.physicsCalcType = c % 2 == 0 ? PhysicsCalcType::Dynamic
+                                               : PhysicsCalcType::Mixed;
+
+            chainBodies[c].push_back(
+                static_cast<int32_t>(data.rigidBodies.size() - 1));
+        }
+    }
+
+    for (size_t c = 0; c < chainBodies.size(); ++c)
+    {
+        for (size_t d = 1; d < chainBodies[c].size(); ++d)
+        {
+            if (data.joints.size() >= config.jointCount)
+                break;
+
+            auto &j = data.addJoint();
+
+            j.name   = "joint_" + std::to_string(data.joints.size() - 1);
+            j.nameEN = j.name;
+
+            j.type            = JointType::Spring6DOF;
+            j.rigidBodyIndexA = chainBodies[c][d - 1];
+            j.rigidBodyIndexB = chainBodies[c][d];
+
+            j.position =
+                data.bones[data.rigidBodies[j.rigidBodyIndexB].boneIndex]
+                    .position;
+            j.rotation          = glm::vec3(0.f);
+            j.linearLowerLimit  = glm::vec3(0.f);
+            j.linearUpperLimit  = glm::vec3(0.f);
+            j.angularLowerLimit = glm::vec3(-0.3f);
+            j.angularUpperLimit = glm::vec3(0.3f);
+            j.linearStiffness   = glm::vec3(0.f);
+            j.angularStiffness  = glm::vec3(10.f);
+        }
+    }
+}
+
+ModelData generateSyntheticModel(const SyntheticModelConfig &config)
+{
+    Random rng(config.seed);
+
+    ModelData data;
+
+    auto &info          = data.info;
+    info.version        = 2.0f;
+    info.encodingMethod = EncodingMethod::UTF8;
+    info.modelName      = "synthetic_" + std::to_string(config.seed);
+    info.modelNameEN    = info.modelName;
+    info.comment        = "Procedurally generated by glmmd";
+    info.commentEN      = info.comment;
+
+    auto skeleton = generateBones(data, config);
+    generateVertices(data, config, skeleton, rng);
+    generateMorphs(data, config, skeleton, rng);
+    generateDisplayFrames(data);
+    generatePhysics(data, config, skeleton);
+
+    data.validateIndexByteSizes();
+    data.updateSkinningData();
+    data.updateNameIndices();
+
+    return data;
+}
+
+static void randomInterpolation(uint8_t (&interpolation)[64], Random &rng)
+{
+    // Rows are the X, Y, Z and rotation control points x1, y1, x2, y2 in the
+    // layout of VMD files, each following row shifted by one byte.
+    uint8_t base[16];
+    for (int k = 0; k < 4; ++k)
+    {
+        base[0 + k]  = static_cast<uint8_t>(rng.index(128));
+        base[4 + k]  = static_cast<uint8_t>(rng.index(128));
+        base[8 + k]  = static_cast<uint8_t>(rng.index(128));
+        base[12 + k] = static_cast<uint8_t>(rng.index(128));
+    }
+
+    for (int r = 0; r < 4; ++r)
+        for (int m = 0; m < 16; ++m)
+            interpolation[r * 16 + m] = m + r < 16 ? base[m + r] : 0;
+}
+
+VmdData generateSyntheticMotion(const ModelData             &modelData,
+                                const SyntheticMotionConfig &config)
+{
+    Random rng(config.seed);
+
+    const uint32_t interval = std::max(config.keyFrameInterval, 1u);
+
+    // Names are not converted, VMD files store Shift-JIS and synthetic
+    // models only use ASCII names.
+    VmdData vmd;
+    vmd.version   = 2;
+    vmd.modelName = modelData.info.modelName.substr(0, 20);
+
+    for (const auto &bone : modelData.bones)
+    {
+        if (rng.uniform() >= config.boneRatio)
+            continue;
+
+        for (uint32_t frame = 0; frame <= config.frameCount; frame += interval)
+        {
+            auto &key       = vmd.boneFrames.emplace_back();
+            key.boneName    = bone.name;
+            key.frameNumber = frame;
+            key.translation = bone.allowTranslation()
+                                  ? rng.vec3(config.translationAmplitude)
+                                  : glm::vec3(0.f);
+            key.rotation    = bone.allowRotation()
+                                  ? glm::quat(rng.vec3(config.rotationAmplitude))
+                                  : glm::quat(1.f, 0.f, 0.f, 0.f);
+            randomInterpolation(key.interpolation, rng);
+        }
+    }
+
+    for (const auto &morph : modelData.morphs)
+    {
+        if (rng.uniform() >= config.morphRatio)
+            continue;
+
+        for (uint32_t frame = 0; frame <= config.frameCount; frame += interval)
+        {
+            auto &key       = vmd.morphFrames.emplace_back();
+            key.morphName   = morph.name;
+            key.frameNumber = frame;
+            key.ratio       = rng.uniform();
+        }
+    }
+
+    return vmd;
+}
+
+} // namespace glmmd
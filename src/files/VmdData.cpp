@@ -1,23 +1,52 @@
-#include <unordered_map>
-
 #include <glm/gtx/euler_angles.hpp>
 
+#include <glmmd/core/Trace.h>
 #include <glmmd/files/CodeConverter.h>
 #include <glmmd/files/VmdData.h>
 
 namespace glmmd
 {
 
+namespace
+{
+
+// Converts Shift-JIS names in a reused buffer. Key frames of one bone or
+// morph are mostly stored together, a run of equal names is looked up once.
+class KeyFrameNameLookup
+{
+public:
+    template <typename Find>
+    uint32_t find(std::string_view name, Find &&findUtf8)
+    {
+        if (!m_valid || name != m_last)
+        {
+            codeCvt<ShiftJIS, UTF8>(name, m_utf8);
+            m_index = findUtf8(std::string_view(m_utf8));
+            m_last  = name;
+            m_valid = true;
+        }
+        return m_index;
+    }
+
+private:
+    std::string      m_utf8;
+    std::string_view m_last;
+    uint32_t         m_index = NameIndex::NOT_FOUND;
+    bool             m_valid = false;
+};
+
+} // namespace
+
 FixedMotionClip VmdData::toFixedMotionClip(const ModelData &modelData,
                                            bool loop, float frameRate) const
 {
+    GLMMD_TRACE_SCOPE("VmdData::toFixedMotionClip");
+
     FixedMotionClip clip(loop, frameRate);
 
     clip.frameCount = 0;
 
-    std::unordered_map<std::string, uint32_t> boneNameToIndex;
-    for (uint32_t i = 0; i < modelData.bones.size(); ++i)
-        boneNameToIndex.emplace(modelData.bones[i].name, i);
+    KeyFrameNameLookup lookup;
 
     clip.boneFrames.reserve(boneFrames.size());
     clip.boneFrameIndex.resize(modelData.bones.size());
@@ -25,10 +54,10 @@ FixedMotionClip VmdData::toFixedMotionClip(const ModelData &modelData,
     {
         clip.frameCount = std::max(clip.frameCount, vbf.frameNumber);
 
-        auto it = boneNameToIndex.find(codeCvt<ShiftJIS, UTF8>(vbf.boneName));
-        if (it == boneNameToIndex.end())
+        auto boneIndex = lookup.find(vbf.boneName, [&](std::string_view name)
+                                     { return modelData.findBone(name); });
+        if (boneIndex == NameIndex::NOT_FOUND)
             continue;
-        auto boneIndex = it->second;
 
         auto &mbf     = clip.boneFrames.emplace_back();
         mbf.transform = {vbf.translation, vbf.rotation};
@@ -46,9 +75,7 @@ FixedMotionClip VmdData::toFixedMotionClip(const ModelData &modelData,
             static_cast<uint32_t>(clip.boneFrames.size() - 1);
     }
 
-    std::unordered_map<std::string, uint32_t> morphNameToIndex;
-    for (uint32_t i = 0; i < modelData.morphs.size(); ++i)
-        morphNameToIndex.emplace(modelData.morphs[i].name, i);
+    lookup = {};
 
     clip.morphFrames.reserve(morphFrames.size());
     clip.morphFrameIndex.resize(modelData.morphs.size());
@@ -56,10 +83,10 @@ FixedMotionClip VmdData::toFixedMotionClip(const ModelData &modelData,
     {
         clip.frameCount = std::max(clip.frameCount, vmf.frameNumber);
 
-        auto it = morphNameToIndex.find(codeCvt<ShiftJIS, UTF8>(vmf.morphName));
-        if (it == morphNameToIndex.end())
+        auto morphIndex = lookup.find(vmf.morphName, [&](std::string_view name)
+                                      { return modelData.findMorph(name); });
+        if (morphIndex == NameIndex::NOT_FOUND)
             continue;
-        auto morphIndex = it->second;
 
         auto &mmf = clip.morphFrames.emplace_back();
         mmf.ratio = vmf.ratio;
@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include <glmmd/files/VmdFileDumper.h>
+
+namespace glmmd
+{
+
+VmdFileDumper::VmdFileDumper(const std::filesystem::path &path)
+{
+    m_fout.open(path, std::ios::binary);
+    if (!m_fout)
+        throw std::runtime_error("Failed to open file \"" + path.string() +
+                                 "\".");
+}
+
+void VmdFileDumper::dump(const VmdData &data)
+{
+    dumpHeader(data);
+    dumpBoneFrames(data);
+    dumpMorphFrames(data);
+    dumpCameraFrames(data);
+
+    writeUInt(uint32_t{0}); // light
+    writeUInt(uint32_t{0}); // self shadow
+}
+
+void VmdFileDumper::writeName(const std::string &name, size_t size)
+{
+    char buf[32]{};
+    std::copy_n(name.data(), std::min(name.size(), size), buf);
+    m_fout.write(buf, size);
+}
+
+void VmdFileDumper::dumpHeader(const VmdData &data)
+{
+    writeName(data.version == 1 ? "Vocaloid Motion Data file"
+                                : "Vocaloid Motion Data 0002",
+              30);
+    writeName(data.modelName, data.version == 1 ? 10 : 20);
+}
+
+void VmdFileDumper::dumpBoneFrames(const VmdData &data)
+{
+    writeUInt(static_cast<uint32_t>(data.boneFrames.size()));
+    for (const auto &f : data.boneFrames)
+    {
+        writeName(f.boneName, 15);
+        writeUInt(f.frameNumber);
+        writeFloat<3>(f.translation.x);
+
+        glm::vec4 q(f.rotation.x, f.rotation.y, f.rotation.z, f.rotation.w);
+        writeFloat<4>(q.x);
+
+        m_fout.write(reinterpret_cast<const char *>(f.interpolation), 64);
+    }
+}
+
+void VmdFileDumper::dumpMorphFrames(const VmdData &data)
+{
+    writeUInt(static_cast<uint32_t>(data.morphFrames.size()));
+    for (const auto &f : data.morphFrames)
+    {
+        writeName(f.morphName, 15);
+        writeUInt(f.frameNumber);
+        writeFloat(f.ratio);
+    }
+}
+
+void VmdFileDumper::dumpCameraFrames(const VmdData &data)
+{
+    writeUInt(static_cast<uint32_t>(data.cameraFrames.size()));
+    for (const auto &f : data.cameraFrames)
+    {
+        writeUInt(f.frameNumber);
+        writeFloat(f.distance);
+        writeFloat<3>(f.target.x);
+        writeFloat<3>(f.rotation.x);
+        m_fout.write(reinterpret_cast<const char *>(f.interpolation), 24);
+        writeUInt(f.fov);
+        writeUInt(f.perspective);
+    }
+}
+
+} // namespace glmmd
@@ -1,5 +1,3 @@
-#include <unordered_map>
-
 #include <glmmd/files/CodeConverter.h>
 #include <glmmd/files/VpdData.h>
 
@@ -11,16 +9,13 @@ ModelPose VpdData::toModelPose(
 {
     ModelPose pose(modelData);
 
-    std::unordered_map<std::string, uint32_t> boneNameToIndex;
-    for (uint32_t i = 0; i < modelData->bones.size(); ++i)
-        boneNameToIndex.emplace(modelData->bones[i].name, i);
-
+    std::string name;
     for (const auto &b : bones)
     {
-        auto it = boneNameToIndex.find(codeCvt<ShiftJIS, UTF8>(b.name));
-        if (it == boneNameToIndex.end())
+        codeCvt<ShiftJIS, UTF8>(b.name, name);
+        auto boneIndex = modelData->findBone(name);
+        if (boneIndex == NameIndex::NOT_FOUND)
             continue;
-        auto boneIndex = it->second;
 
         pose.setLocalBoneTransform(boneIndex, {b.translation, b.rotation});
     }